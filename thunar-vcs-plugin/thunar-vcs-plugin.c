@@ -23,6 +23,7 @@
 #include <exo/exo.h>
 
 #include <thunar-vcs-plugin/tvp-provider.h>
+#include <thunar-vcs-plugin/tvp-status-page.h>
 
 #ifdef HAVE_SUBVERSION
 #include <thunar-vcs-plugin/tvp-svn-action.h>
@@ -74,6 +75,9 @@ thunar_extension_initialize (ThunarxProviderPlugin *plugin)
 #ifdef HAVE_GIT
   tvp_git_action_register_type (plugin);
 #endif
+#if defined(HAVE_SUBVERSION) || defined(HAVE_GIT)
+  tvp_status_page_register_type (plugin);
+#endif
 
   /* setup the plugin provider type list */
   type_list[0] = TVP_TYPE_PROVIDER;
@@ -51,10 +51,14 @@ struct _TvpGitAction
         unsigned is_parent : 1;
         unsigned is_directory : 1;
         unsigned is_file : 1;
+        unsigned is_repository : 1;
     } property;
 
     GList *files;
     GtkWidget *window;
+
+    /* the items of a menu built before the status was known, by name */
+    GHashTable *subitems;
 };
 
 
@@ -62,7 +66,8 @@ struct _TvpGitAction
 enum {
     PROPERTY_IS_PARENT = 1,
     PROPERTY_IS_DIRECTORY,
-    PROPERTY_IS_FILE
+    PROPERTY_IS_FILE,
+    PROPERTY_IS_REPOSITORY
 };
 
 
@@ -79,6 +84,7 @@ static guint action_signal[SIGNAL_COUNT];
 
 
 static void tvp_git_action_create_menu_item (ThunarxMenuItem *item);
+static void tvp_git_action_add_subactions (ThunarxMenuItem *item, ThunarxMenu *menu);
 
 static void tvp_git_action_finalize (GObject*);
 
@@ -116,6 +122,9 @@ tvp_git_action_class_init (TvpGitActionClass *klass)
     g_object_class_install_property (gobject_class, PROPERTY_IS_FILE,
             g_param_spec_boolean ("is-file", "", "", FALSE, G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE));
 
+    g_object_class_install_property (gobject_class, PROPERTY_IS_REPOSITORY,
+            g_param_spec_boolean ("is-repository", "", "", TRUE, G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE));
+
     action_signal[SIGNAL_NEW_PROCESS] = g_signal_new("new-process", G_OBJECT_CLASS_TYPE(gobject_class), G_SIGNAL_RUN_FIRST,
             0, NULL, NULL, tsh_cclosure_marshal_VOID__POINTER_STRING, G_TYPE_NONE, 2, G_TYPE_POINTER, G_TYPE_STRING);
 
@@ -130,6 +139,7 @@ tvp_git_action_init (TvpGitAction *self)
     self->property.is_parent = 0;
     self->files = NULL;
     self->window = NULL;
+    self->subitems = NULL;
 }
 
 
@@ -141,7 +151,8 @@ tvp_git_action_new (const gchar *name,
         GtkWidget *window,
         gboolean is_parent,
         gboolean is_direcotry,
-        gboolean is_file)
+        gboolean is_file,
+        gboolean is_repository)
 {
     ThunarxMenuItem *item;
 
@@ -154,10 +165,47 @@ tvp_git_action_new (const gchar *name,
             "is-parent", is_parent,
             "is-directory", is_direcotry,
             "is-file", is_file,
+            "is-repository", is_repository,
+            "icon", "git",
+            NULL);
+    TVP_GIT_ACTION (item)->files = thunarx_file_info_list_copy (files);
+    TVP_GIT_ACTION (item)->window = window;
+
+    tvp_git_action_create_menu_item (item);
+
+    return item;
+}
+
+
+
+/* A menu for files whose status is still being looked up, it offers every
+ * item which might apply until tvp_git_action_set_status is called. */
+ThunarxMenuItem *
+tvp_git_action_new_pending (const gchar *name,
+        const gchar *label,
+        GList *files,
+        GtkWidget *window,
+        gboolean is_parent,
+        gboolean is_direcotry,
+        gboolean has_files)
+{
+    ThunarxMenuItem *item;
+
+    g_return_val_if_fail(name, NULL);
+    g_return_val_if_fail(label, NULL);
+
+    item = g_object_new (TVP_TYPE_GIT_ACTION,
+            "name", name,
+            "label", label,
+            "is-parent", is_parent,
+            "is-directory", is_direcotry,
+            "is-file", has_files,
+            "is-repository", TRUE,
             "icon", "git",
             NULL);
     TVP_GIT_ACTION (item)->files = thunarx_file_info_list_copy (files);
     TVP_GIT_ACTION (item)->window = window;
+    TVP_GIT_ACTION (item)->subitems = g_hash_table_new (g_str_hash, g_str_equal);
 
     tvp_git_action_create_menu_item (item);
 
@@ -166,9 +214,36 @@ tvp_git_action_new (const gchar *name,
 
 
 
+void
+tvp_git_action_set_status (TvpGitAction *tvp_action,
+        gboolean is_file,
+        gboolean is_repository)
+{
+    GHashTableIter iter;
+    gpointer subitem;
+
+    g_return_if_fail (TVP_IS_GIT_ACTION (tvp_action));
+    g_return_if_fail (tvp_action->subitems != NULL);
+
+    tvp_action->property.is_file = is_file?1:0;
+    tvp_action->property.is_repository = is_repository?1:0;
+
+    /* only the items which apply stay sensitive */
+    g_hash_table_iter_init (&iter, tvp_action->subitems);
+    while (g_hash_table_iter_next (&iter, NULL, &subitem))
+        thunarx_menu_item_set_sensitive (subitem, FALSE);
+
+    tvp_git_action_add_subactions (THUNARX_MENU_ITEM (tvp_action), NULL);
+}
+
+
+
 static void
 tvp_git_action_finalize (GObject *object)
 {
+    if (TVP_GIT_ACTION (object)->subitems)
+        g_hash_table_destroy (TVP_GIT_ACTION (object)->subitems);
+    TVP_GIT_ACTION (object)->subitems = NULL;
     thunarx_file_info_list_free (TVP_GIT_ACTION (object)->files);
     TVP_GIT_ACTION (object)->files = NULL;
     TVP_GIT_ACTION (object)->window = NULL;
@@ -192,6 +267,9 @@ tvp_git_action_set_property (GObject *object, guint property_id, const GValue *v
         case PROPERTY_IS_FILE:
             TVP_GIT_ACTION (object)->property.is_file = g_value_get_boolean (value)?1:0;
             break;
+        case PROPERTY_IS_REPOSITORY:
+            TVP_GIT_ACTION (object)->property.is_repository = g_value_get_boolean (value)?1:0;
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -202,8 +280,21 @@ tvp_git_action_set_property (GObject *object, guint property_id, const GValue *v
 static void
 add_subaction(ThunarxMenuItem *item, ThunarxMenu *menu, const gchar *name, const gchar *text, const gchar *tooltip, const gchar *icon, gchar *arg)
 {
+    TvpGitAction *tvp_action = TVP_GIT_ACTION (item);
     ThunarxMenuItem *subitem;
+
+    /* updating a pending menu */
+    if (!menu)
+    {
+        subitem = g_hash_table_lookup (tvp_action->subitems, name);
+        if (subitem)
+            thunarx_menu_item_set_sensitive (subitem, TRUE);
+        return;
+    }
+
     subitem = thunarx_menu_item_new (name, text, tooltip, icon);
+    if (tvp_action->subitems)
+        g_hash_table_insert (tvp_action->subitems, (gpointer) name, subitem);
     thunarx_menu_append_item (menu, subitem);
     g_object_set_qdata (G_OBJECT (subitem), tvp_action_arg_quark, arg);
     g_signal_connect_after (subitem, "activate", G_CALLBACK (tvp_action_exec), item);
@@ -215,11 +306,29 @@ static void
 tvp_git_action_create_menu_item (ThunarxMenuItem *item)
 {
     ThunarxMenu *menu;
-    TvpGitAction *tvp_action = TVP_GIT_ACTION (item);
 
     menu = thunarx_menu_new ();
     thunarx_menu_item_set_menu (item, menu);
 
+    tvp_git_action_add_subactions (item, menu);
+}
+
+
+
+/* With menu NULL the items of a pending menu which apply are made sensitive */
+static void
+tvp_git_action_add_subactions (ThunarxMenuItem *item, ThunarxMenu *menu)
+{
+    TvpGitAction *tvp_action = TVP_GIT_ACTION (item);
+
+    /* outside a repository there is nothing but cloning one */
+    if (!tvp_action->property.is_repository)
+    {
+        if (tvp_action->property.is_parent)
+            add_subaction (item, menu, "tvp::git::clone", _("Clone"), _("Clone a repository into a new directory"), "edit-copy", "--clone");
+        return;
+    }
+
     add_subaction (item, menu, "tvp::git::add", _("Add"), _("Add file contents to the index"), "list-add", "--add");
     /* unimplemented: add_subaction(item, menu, "tvp::git::bisect", _("Bisect"), _("Bisect"), NULL, _("Bisect"));*/
     if (tvp_action->property.is_file)
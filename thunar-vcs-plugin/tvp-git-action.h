@@ -43,8 +43,21 @@ ThunarxMenuItem *tvp_git_action_new     (const gchar*,
                                          GtkWidget *,
                                          gboolean,
                                          gboolean,
+                                         gboolean,
                                          gboolean) G_GNUC_MALLOC G_GNUC_INTERNAL;
 
+ThunarxMenuItem *tvp_git_action_new_pending (const gchar*,
+                                             const gchar*,
+                                             GList *,
+                                             GtkWidget *,
+                                             gboolean,
+                                             gboolean,
+                                             gboolean) G_GNUC_MALLOC G_GNUC_INTERNAL;
+
+void             tvp_git_action_set_status  (TvpGitAction *,
+                                             gboolean,
+                                             gboolean) G_GNUC_INTERNAL;
+
 G_END_DECLS;
 
 #endif /* !__TVP_GIT_ACTION_H__ */
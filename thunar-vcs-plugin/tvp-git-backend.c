@@ -0,0 +1,1497 @@
+/*-
+ * Copyright (C) 2007-2011  Peter de Ridder <peter@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include <thunar-vcs-plugin/tvp-git-backend.h>
+
+
+/* seconds before the repository of a directory is looked up again */
+#define TVP_GIT_DISCOVERY_TIMEOUT    5
+#define TVP_GIT_DISCOVERY_CACHE_SIZE 1024
+
+/* number of repositories for which the index is kept */
+#define TVP_GIT_INDEX_CACHE_SIZE     4
+
+/* the mode of a submodule entry */
+#define TVP_GIT_MODE_GITLINK         0160000
+#define TVP_GIT_MODE_SYMLINK         0120000
+
+
+
+typedef struct
+{
+  const gchar *path;        /* relative to the work tree */
+  guint32      mode;
+  guint32      mtime;
+  guint32      mtime_nsec;
+  guint32      size;
+  guint        stage;
+  guchar       oid[20];     /* of the blob, sha1 repositories only */
+} TvpGitIndexEntry;
+
+typedef struct
+{
+  const guchar *shared;     /* object id of the shared index, NULL if none */
+  const guchar *bitmaps;    /* the deleted and replaced entries */
+  const guchar *bitmaps_end;
+} TvpGitIndexLink;
+
+typedef struct
+{
+  gchar            *index_path;
+  gint64            checked;  /* when the stat data was last compared */
+  guint64           ino;
+  time_t            mtime;
+  glong             mtime_nsec;
+  goffset           size;
+  gboolean          unsupported; /* not a sha1 repository */
+  GStringChunk     *strings;
+  TvpGitIndexEntry *entries;
+  guint             n_entries;
+  GHashTable       *files;  /* path -> TvpGitIndexEntry */
+  GHashTable       *dirs;   /* the directories holding tracked files */
+  GList             lru;    /* link in index_lru */
+} TvpGitIndex;
+
+typedef struct
+{
+  gchar   *base;            /* folder of the ignore file, relative to the work tree */
+  gchar   *pattern;
+  gboolean negate;          /* a "!" rule includes the files again */
+  gboolean dir_only;
+  gboolean anchored;        /* matched against the path below base, not the name */
+} TvpGitIgnoreRule;
+
+typedef struct
+{
+  gchar  *path;             /* a directory */
+  gchar  *root;             /* NULL outside a work tree */
+  gchar  *index_path;
+  gint64  checked;
+  GList   lru;              /* link in discovery_lru */
+} TvpGitDiscovery;
+
+
+
+static GMutex      backend_lock;
+static GHashTable *discoveries = NULL;
+static GQueue      discovery_lru = G_QUEUE_INIT;  /* most recently used first */
+static GHashTable *indexes = NULL;
+static GQueue      index_lru = G_QUEUE_INIT;      /* most recently used first */
+
+
+
+static void
+tvp_git_discovery_free (TvpGitDiscovery *discovery)
+{
+  g_free (discovery->path);
+  g_free (discovery->root);
+  g_free (discovery->index_path);
+  g_free (discovery);
+}
+
+
+
+static void
+tvp_git_index_free (TvpGitIndex *index)
+{
+  g_hash_table_destroy (index->files);
+  g_hash_table_destroy (index->dirs);
+  g_string_chunk_free (index->strings);
+  g_free (index->entries);
+  g_free (index->index_path);
+  g_free (index);
+}
+
+
+
+gboolean
+tvp_git_backend_init (void)
+{
+  g_mutex_lock (&backend_lock);
+  if (!discoveries)
+  {
+    discoveries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)tvp_git_discovery_free);
+    indexes = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)tvp_git_index_free);
+  }
+  g_mutex_unlock (&backend_lock);
+
+  return TRUE;
+}
+
+
+
+void
+tvp_git_backend_free (void)
+{
+  g_mutex_lock (&backend_lock);
+  if (discoveries)
+  {
+    g_hash_table_destroy (discoveries);
+    g_hash_table_destroy (indexes);
+    g_queue_init (&discovery_lru);
+    g_queue_init (&index_lru);
+    discoveries = NULL;
+    indexes = NULL;
+  }
+  g_mutex_unlock (&backend_lock);
+}
+
+
+
+static gchar *
+tvp_git_normalize_path (const gchar *uri)
+{
+  gchar *path;
+
+  /* strip the "file://" part of the uri */
+  if (strncmp (uri, "file://", 7) == 0)
+  {
+    uri += 7;
+  }
+
+  path = g_strdup (uri);
+
+  /* remove trailing '/' */
+  if (strlen (path) > 1 && path[strlen (path) - 1] == '/')
+  {
+    path[strlen (path) - 1] = '\0';
+  }
+
+  return path;
+}
+
+
+
+static gchar *
+tvp_git_find_git_dir (const gchar *dir)
+{
+  gchar *dot_git;
+  gchar *contents;
+  gchar *target;
+  gchar *git_dir = NULL;
+
+  dot_git = g_build_filename (dir, ".git", NULL);
+
+  if (g_file_test (dot_git, G_FILE_TEST_IS_DIR))
+    return dot_git;
+
+  /* linked work trees and submodules point to their git dir */
+  if (g_file_test (dot_git, G_FILE_TEST_IS_REGULAR) &&
+      g_file_get_contents (dot_git, &contents, NULL, NULL))
+  {
+    if (g_str_has_prefix (contents, "gitdir: "))
+    {
+      target = g_strstrip (contents + 8);
+      if (g_path_is_absolute (target))
+        git_dir = g_strdup (target);
+      else
+        git_dir = g_build_filename (dir, target, NULL);
+    }
+    g_free (contents);
+  }
+
+  g_free (dot_git);
+
+  return git_dir;
+}
+
+
+
+static gboolean
+tvp_git_discovery_fresh (TvpGitDiscovery *discovery, gint64 now)
+{
+  return discovery && now - discovery->checked < TVP_GIT_DISCOVERY_TIMEOUT * G_USEC_PER_SEC;
+}
+
+
+
+static TvpGitDiscovery *
+tvp_git_discovery_lookup (const gchar *dir)
+{
+  TvpGitDiscovery *discovery;
+
+  discovery = g_hash_table_lookup (discoveries, dir);
+  if (discovery)
+  {
+    g_queue_unlink (&discovery_lru, &discovery->lru);
+    g_queue_push_head_link (&discovery_lru, &discovery->lru);
+  }
+
+  return discovery;
+}
+
+
+
+static TvpGitDiscovery *
+tvp_git_discovery_store (const gchar *dir, const gchar *root, const gchar *index_path, gint64 now)
+{
+  TvpGitDiscovery *discovery;
+  GList           *link;
+
+  discovery = tvp_git_discovery_lookup (dir);
+  if (!discovery)
+  {
+    /* forget the directory used longest ago */
+    if (g_queue_get_length (&discovery_lru) >= TVP_GIT_DISCOVERY_CACHE_SIZE)
+    {
+      link = g_queue_pop_tail_link (&discovery_lru);
+      g_hash_table_remove (discoveries, ((TvpGitDiscovery *) link->data)->path);
+    }
+
+    discovery = g_new0 (TvpGitDiscovery, 1);
+    discovery->path = g_strdup (dir);
+    discovery->lru.data = discovery;
+    g_hash_table_insert (discoveries, discovery->path, discovery);
+    g_queue_push_head_link (&discovery_lru, &discovery->lru);
+  }
+
+  g_free (discovery->root);
+  g_free (discovery->index_path);
+  discovery->root = g_strdup (root);
+  discovery->index_path = g_strdup (index_path);
+  discovery->checked = now;
+
+  return discovery;
+}
+
+
+
+/* Looks up the repository of a directory, walking up the tree. Every
+ * directory passed on the way shares the answer, so the siblings and
+ * children of a folder are found without a walk of their own. */
+static TvpGitDiscovery *
+tvp_git_discover_dir (const gchar *dir)
+{
+  TvpGitDiscovery *discovery;
+  GPtrArray       *visited;
+  gint64           now;
+  gchar           *walk, *parent, *git_dir;
+  gchar           *root = NULL;
+  gchar           *index_path = NULL;
+  guint            i;
+
+  now = g_get_monotonic_time ();
+
+  discovery = tvp_git_discovery_lookup (dir);
+  if (tvp_git_discovery_fresh (discovery, now))
+    return discovery;
+
+  /* the git dir itself is no work tree */
+  if (strstr (dir, "/.git/") || g_str_has_suffix (dir, "/.git"))
+    return tvp_git_discovery_store (dir, NULL, NULL, now);
+
+  visited = g_ptr_array_new_with_free_func (g_free);
+
+  walk = g_strdup (dir);
+  for (;;)
+  {
+    /* an ancestor looked up recently knows the answer */
+    if (visited->len)
+    {
+      discovery = g_hash_table_lookup (discoveries, walk);
+      if (tvp_git_discovery_fresh (discovery, now))
+      {
+        root = g_strdup (discovery->root);
+        index_path = g_strdup (discovery->index_path);
+        g_free (walk);
+        break;
+      }
+    }
+
+    git_dir = tvp_git_find_git_dir (walk);
+    if (git_dir)
+    {
+      root = walk;
+      index_path = g_build_filename (git_dir, "index", NULL);
+      g_free (git_dir);
+      break;
+    }
+
+    g_ptr_array_add (visited, walk);
+
+    parent = g_path_get_dirname (walk);
+    if (!strcmp (parent, walk))
+    {
+      g_free (parent);
+      break;
+    }
+    walk = parent;
+  }
+
+  if (root)
+    discovery = tvp_git_discovery_store (root, root, index_path, now);
+  for (i = visited->len; i > 0; i--)
+    discovery = tvp_git_discovery_store (g_ptr_array_index (visited, i - 1), root, index_path, now);
+
+  g_ptr_array_free (visited, TRUE);
+  g_free (index_path);
+  g_free (root);
+
+  /* dir is stored last */
+  return discovery;
+}
+
+
+
+static TvpGitDiscovery *
+tvp_git_discover (const gchar *path)
+{
+  TvpGitDiscovery *discovery;
+  gchar           *dir;
+
+  /* only directories are cached, a file shares the repository of its folder */
+  discovery = g_hash_table_lookup (discoveries, path);
+  if (discovery || g_file_test (path, G_FILE_TEST_IS_DIR))
+    return tvp_git_discover_dir (path);
+
+  dir = g_path_get_dirname (path);
+  discovery = tvp_git_discover_dir (dir);
+  g_free (dir);
+
+  return discovery;
+}
+
+
+
+static inline guint32
+tvp_git_read_be32 (const guchar *p)
+{
+  return ((guint32) p[0] << 24) | ((guint32) p[1] << 16) | ((guint32) p[2] << 8) | (guint32) p[3];
+}
+
+
+
+static inline guint64
+tvp_git_read_be64 (const guchar *p)
+{
+  return ((guint64) tvp_git_read_be32 (p) << 32) | (guint64) tvp_git_read_be32 (p + 4);
+}
+
+
+
+static inline guint16
+tvp_git_read_be16 (const guchar *p)
+{
+  return ((guint16) p[0] << 8) | (guint16) p[1];
+}
+
+
+
+static void
+tvp_git_index_add_dirs (TvpGitIndex *index, const gchar *path)
+{
+  const gchar *slash;
+  gchar       *dir;
+
+  /* the index is sorted, so most parents are known already */
+  for (slash = strrchr (path, '/'); slash; slash = g_strrstr_len (path, slash - path, "/"))
+  {
+    dir = g_strndup (path, slash - path);
+    if (g_hash_table_contains (index->dirs, dir))
+    {
+      g_free (dir);
+      break;
+    }
+    g_hash_table_add (index->dirs, g_string_chunk_insert (index->strings, dir));
+    g_free (dir);
+  }
+}
+
+
+
+/* Reads the entries of an index file into entries, the paths are stored in
+ * the strings of index. The shared index of a split index is returned in
+ * link, which points into data. */
+static gboolean
+tvp_git_index_read (TvpGitIndex *index, const guchar *data, gsize length, GArray *entries, TvpGitIndexLink *link)
+{
+  TvpGitIndexEntry  entry;
+  const guchar     *p, *end, *start, *nul;
+  guint32           version, count, size, i;
+  guint16           flags;
+  gsize             header;
+  guint64           strip;
+  guchar            c;
+  GString          *name;
+  gboolean          result = FALSE;
+
+  /* header and trailing checksum */
+  if (length < 12 + 20 || memcmp (data, "DIRC", 4))
+    return FALSE;
+
+  version = tvp_git_read_be32 (data + 4);
+  if (version < 2 || version > 4)
+    return FALSE;
+
+  count = tvp_git_read_be32 (data + 8);
+  end = data + length - 20;
+  p = data + 12;
+
+  /* every entry takes at least 62 bytes */
+  if (count > (end - p) / 62)
+    return FALSE;
+
+  g_array_set_size (entries, 0);
+  name = g_string_new (NULL);
+  memset (&entry, 0, sizeof (entry));
+
+  for (i = 0; i < count; i++)
+  {
+    start = p;
+
+    header = 62;
+    if (p + header > end)
+      goto out;
+    flags = tvp_git_read_be16 (p + 60);
+    if (version >= 3 && (flags & 0x4000))
+      header += 2;
+    if (p + header > end)
+      goto out;
+
+    entry.mtime = tvp_git_read_be32 (p + 8);
+    entry.mtime_nsec = tvp_git_read_be32 (p + 12);
+    entry.mode = tvp_git_read_be32 (p + 24);
+    entry.size = tvp_git_read_be32 (p + 36);
+    memcpy (entry.oid, p + 40, sizeof (entry.oid));
+    entry.stage = (flags >> 12) & 0x3;
+    p += header;
+
+    if (version == 4)
+    {
+      /* the path is prefix compressed against the previous one */
+      if (p >= end)
+        goto out;
+      c = *p++;
+      strip = c & 0x7f;
+      while (c & 0x80)
+      {
+        if (p >= end)
+          goto out;
+        c = *p++;
+        strip = ((strip + 1) << 7) | (c & 0x7f);
+      }
+      if (strip > name->len)
+        goto out;
+      g_string_truncate (name, name->len - strip);
+
+      nul = memchr (p, '\0', end - p);
+      if (!nul)
+        goto out;
+      g_string_append_len (name, (const gchar *) p, nul - p);
+      p = nul + 1;
+    }
+    else
+    {
+      nul = memchr (p, '\0', end - p);
+      if (!nul)
+        goto out;
+      g_string_truncate (name, 0);
+      g_string_append_len (name, (const gchar *) p, nul - p);
+
+      /* entries are padded with NULs to a multiple of eight bytes */
+      p = start + ((nul - start + 8) & ~7);
+    }
+
+    /* the entries replacing those of a shared index have no name */
+    entry.path = g_string_chunk_insert_len (index->strings, name->str, name->len);
+    g_array_append_val (entries, entry);
+  }
+
+  /* the extensions follow the entries */
+  if (link)
+    link->shared = NULL;
+  while (link && p + 8 <= end)
+  {
+    size = tvp_git_read_be32 (p + 4);
+    if (size > (gsize) (end - p - 8))
+      goto out;
+
+    if (!memcmp (p, "link", 4))
+    {
+      if (size < 20)
+        goto out;
+      link->shared = p + 8;
+      link->bitmaps = p + 8 + 20;
+      link->bitmaps_end = p + 8 + size;
+    }
+
+    p += 8 + size;
+  }
+
+  result = TRUE;
+
+out:
+  g_string_free (name, TRUE);
+
+  return result;
+}
+
+
+
+/* Marks the bits set in an ewah compressed bitmap, as git stores the
+ * deleted and replaced entries of a split index */
+static const guchar *
+tvp_git_ewah_read (const guchar *p, const guchar *end, guint8 *marks, guint n_marks, guint8 mark)
+{
+  guint32 n_words, i, k;
+  guint64 word, run, literals, pos = 0;
+  guint   bit;
+
+  /* the size in bits, the number of words, the words and the position of
+   * the last run length word */
+  if (end - p < 8)
+    return NULL;
+  n_words = tvp_git_read_be32 (p + 4);
+  p += 8;
+  if ((guint64) (end - p) < (guint64) n_words * 8 + 4)
+    return NULL;
+
+  for (i = 0; i < n_words; )
+  {
+    /* a run of equal words followed by literal words */
+    word = tvp_git_read_be64 (p + 8 * i++);
+    run = (word >> 1) & G_GUINT64_CONSTANT (0xffffffff);
+    literals = word >> 33;
+
+    if (word & 1)
+    {
+      for (k = 0; k < run * 64; k++)
+      {
+        if (pos + k >= n_marks)
+          return NULL;
+        marks[pos + k] |= mark;
+      }
+    }
+    pos += run * 64;
+
+    for (k = 0; k < literals && i < n_words; k++, i++)
+    {
+      word = tvp_git_read_be64 (p + 8 * i);
+      for (bit = 0; bit < 64; bit++)
+      {
+        if (!(word & (G_GUINT64_CONSTANT (1) << bit)))
+          continue;
+        if (pos + bit >= n_marks)
+          return NULL;
+        marks[pos + bit] |= mark;
+      }
+      pos += 64;
+    }
+  }
+
+  return p + (gsize) n_words * 8 + 4;
+}
+
+
+
+#define TVP_GIT_ENTRY_DELETED  1
+#define TVP_GIT_ENTRY_REPLACED 2
+
+/* Applies a split index to the entries of its shared index, like git the
+ * first entries without a name replace the marked shared ones and the
+ * others are added */
+static gboolean
+tvp_git_index_merge (const gchar *index_path, TvpGitIndex *index, TvpGitIndexLink *link, GArray **entries)
+{
+  GMappedFile      *mapped;
+  GArray           *shared, *merged;
+  TvpGitIndexEntry *entry, *replacement;
+  const guchar     *p;
+  gchar             hex[41];
+  gchar            *dir, *shared_path;
+  guint8           *marks;
+  guint             i, next = 0;
+  gboolean          result = FALSE;
+
+  for (i = 0; i < 20; i++)
+    g_snprintf (hex + 2 * i, 3, "%02x", link->shared[i]);
+
+  dir = g_path_get_dirname (index_path);
+  shared_path = g_strconcat (dir, G_DIR_SEPARATOR_S, "sharedindex.", hex, NULL);
+  mapped = g_mapped_file_new (shared_path, FALSE, NULL);
+  g_free (shared_path);
+  g_free (dir);
+  if (!mapped)
+    return FALSE;
+
+  shared = g_array_new (FALSE, TRUE, sizeof (TvpGitIndexEntry));
+  marks = NULL;
+
+  if (!tvp_git_index_read (index, (const guchar *) g_mapped_file_get_contents (mapped),
+                           g_mapped_file_get_length (mapped), shared, NULL))
+    goto out;
+
+  marks = g_new0 (guint8, shared->len + 1);
+  p = link->bitmaps;
+  if (p < link->bitmaps_end)
+  {
+    p = tvp_git_ewah_read (p, link->bitmaps_end, marks, shared->len, TVP_GIT_ENTRY_DELETED);
+    if (!p || !tvp_git_ewah_read (p, link->bitmaps_end, marks, shared->len, TVP_GIT_ENTRY_REPLACED))
+      goto out;
+  }
+
+  merged = g_array_sized_new (FALSE, TRUE, sizeof (TvpGitIndexEntry), shared->len + (*entries)->len);
+
+  for (i = 0; i < shared->len; i++)
+  {
+    entry = &g_array_index (shared, TvpGitIndexEntry, i);
+
+    if (marks[i] & TVP_GIT_ENTRY_REPLACED)
+    {
+      if (next >= (*entries)->len)
+      {
+        g_array_free (merged, TRUE);
+        goto out;
+      }
+      replacement = &g_array_index (*entries, TvpGitIndexEntry, next++);
+      replacement->path = entry->path;
+      entry = replacement;
+    }
+
+    if (!(marks[i] & TVP_GIT_ENTRY_DELETED))
+      g_array_append_vals (merged, entry, 1);
+  }
+
+  for (; next < (*entries)->len; next++)
+    g_array_append_vals (merged, &g_array_index (*entries, TvpGitIndexEntry, next), 1);
+
+  g_array_free (*entries, TRUE);
+  *entries = merged;
+  result = TRUE;
+
+out:
+  g_free (marks);
+  g_array_free (shared, TRUE);
+  g_mapped_file_unref (mapped);
+
+  return result;
+}
+
+
+
+static gboolean
+tvp_git_index_parse (TvpGitIndex *index, const guchar *data, gsize length)
+{
+  TvpGitIndexEntry *entry, *existing;
+  TvpGitIndexLink   link;
+  GArray           *entries;
+  guint             i;
+
+  entries = g_array_new (FALSE, TRUE, sizeof (TvpGitIndexEntry));
+
+  if (!tvp_git_index_read (index, data, length, entries, &link) ||
+      (link.shared && !tvp_git_index_merge (index->index_path, index, &link, &entries)))
+  {
+    g_array_free (entries, TRUE);
+    return FALSE;
+  }
+
+  index->n_entries = entries->len;
+  index->entries = (TvpGitIndexEntry *) g_array_free (entries, FALSE);
+
+  for (i = 0; i < index->n_entries; i++)
+  {
+    entry = index->entries + i;
+
+    /* a conflict has an entry per stage */
+    existing = g_hash_table_lookup (index->files, entry->path);
+    if (existing)
+    {
+      existing->stage = MAX (existing->stage, entry->stage);
+      continue;
+    }
+
+    g_hash_table_insert (index->files, (gpointer) entry->path, entry);
+    tvp_git_index_add_dirs (index, entry->path);
+  }
+
+  return TRUE;
+}
+
+
+
+static glong
+tvp_git_stat_mtime_nsec (const GStatBuf *st)
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  return st->st_mtim.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+
+
+/* Whether the objects of the repository owning the git dir are named by
+ * sha1, the only format the index reader knows. */
+static gboolean
+tvp_git_object_format_is_sha1 (const gchar *git_dir)
+{
+  gchar     *filename;
+  gchar     *contents;
+  gchar     *common_dir = NULL;
+  gchar    **lines;
+  gchar     *line, *value;
+  gboolean   in_extensions = FALSE;
+  gboolean   result = TRUE;
+  guint      i;
+
+  /* a linked work tree shares the configuration of the main one */
+  filename = g_build_filename (git_dir, "commondir", NULL);
+  if (g_file_get_contents (filename, &contents, NULL, NULL))
+  {
+    g_strstrip (contents);
+    if (g_path_is_absolute (contents))
+      common_dir = g_strdup (contents);
+    else
+      common_dir = g_build_filename (git_dir, contents, NULL);
+    g_free (contents);
+  }
+  g_free (filename);
+
+  filename = g_build_filename (common_dir ? common_dir : git_dir, "config", NULL);
+  g_free (common_dir);
+
+  if (!g_file_get_contents (filename, &contents, NULL, NULL))
+  {
+    g_free (filename);
+    return TRUE;
+  }
+  g_free (filename);
+
+  /* only extensions.objectFormat matters, a full parser is not needed */
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] && result; i++)
+  {
+    line = g_strstrip (lines[i]);
+    if (*line == '[')
+    {
+      in_extensions = (g_ascii_strncasecmp (line, "[extensions]", 12) == 0);
+      continue;
+    }
+
+    if (!in_extensions || g_ascii_strncasecmp (line, "objectformat", 12))
+      continue;
+
+    value = line + 12;
+    while (*value == ' ' || *value == '\t')
+      value++;
+    if (*value == '=' && g_ascii_strcasecmp (g_strstrip (value + 1), "sha1"))
+      result = FALSE;
+  }
+  g_strfreev (lines);
+  g_free (contents);
+
+  return result;
+}
+
+
+
+static TvpGitIndex *
+tvp_git_index_load (const gchar *index_path, GStatBuf *st)
+{
+  TvpGitIndex *index;
+  GMappedFile *mapped;
+  gchar       *git_dir;
+
+  index = g_new0 (TvpGitIndex, 1);
+  index->index_path = g_strdup (index_path);
+  index->strings = g_string_chunk_new (4096);
+  index->files = g_hash_table_new (g_str_hash, g_str_equal);
+  index->dirs = g_hash_table_new (g_str_hash, g_str_equal);
+  index->lru.data = index;
+
+  if (st)
+  {
+    index->ino = st->st_ino;
+    index->mtime = st->st_mtime;
+    index->mtime_nsec = tvp_git_stat_mtime_nsec (st);
+    index->size = st->st_size;
+  }
+
+  /* the entries of a sha256 index have a different layout */
+  git_dir = g_path_get_dirname (index_path);
+  index->unsupported = !tvp_git_object_format_is_sha1 (git_dir);
+  g_free (git_dir);
+
+  /* a repository without commits might not have an index yet */
+  if (!st || index->unsupported)
+    return index;
+
+  mapped = g_mapped_file_new (index_path, FALSE, NULL);
+  if (mapped)
+  {
+    if (!tvp_git_index_parse (index, (const guchar *) g_mapped_file_get_contents (mapped),
+                              g_mapped_file_get_length (mapped)))
+    {
+      /* unknown format, treat everything as untracked */
+      g_hash_table_remove_all (index->files);
+      g_hash_table_remove_all (index->dirs);
+    }
+    g_mapped_file_unref (mapped);
+  }
+
+  return index;
+}
+
+
+
+static TvpGitIndex *
+tvp_git_get_index (TvpGitDiscovery *discovery)
+{
+  TvpGitIndex *index;
+  GStatBuf     st;
+  GList       *link;
+  gboolean     exists;
+
+  gint64       now;
+
+  now = g_get_monotonic_time ();
+  exists = (g_stat (discovery->index_path, &st) == 0);
+
+  /* git replaces the index as a whole by renaming a new file over it, so
+   * the inode tells it changed even within the same second */
+  index = g_hash_table_lookup (indexes, discovery->index_path);
+  if (index)
+  {
+    g_queue_unlink (&index_lru, &index->lru);
+
+    if ((exists && index->ino == (guint64) st.st_ino &&
+         index->mtime == st.st_mtime && index->mtime_nsec == tvp_git_stat_mtime_nsec (&st) &&
+         index->size == st.st_size) ||
+        (!exists && index->size == 0))
+    {
+      index->checked = now;
+      g_queue_push_head_link (&index_lru, &index->lru);
+      return index;
+    }
+    g_hash_table_remove (indexes, discovery->index_path);
+  }
+
+  /* forget the index used longest ago */
+  if (g_queue_get_length (&index_lru) >= TVP_GIT_INDEX_CACHE_SIZE)
+  {
+    link = g_queue_pop_tail_link (&index_lru);
+    g_hash_table_remove (indexes, ((TvpGitIndex *) link->data)->index_path);
+  }
+
+  index = tvp_git_index_load (discovery->index_path, exists ? &st : NULL);
+  index->checked = now;
+  g_hash_table_insert (indexes, index->index_path, index);
+  g_queue_push_head_link (&index_lru, &index->lru);
+
+  return index;
+}
+
+
+
+/* Returns the root of the work tree holding uri, or NULL. */
+gchar *
+tvp_git_backend_get_repository (const gchar *uri)
+{
+  TvpGitDiscovery *discovery;
+  gchar           *path;
+  gchar           *root = NULL;
+
+  path = tvp_git_normalize_path (uri);
+
+  g_mutex_lock (&backend_lock);
+  if (discoveries)
+  {
+    discovery = tvp_git_discover (path);
+    root = g_strdup (discovery->root);
+  }
+  g_mutex_unlock (&backend_lock);
+
+  g_free (path);
+
+  return root;
+}
+
+
+
+gboolean
+tvp_git_backend_is_working_copy (const gchar *uri)
+{
+  gchar *root;
+
+  root = tvp_git_backend_get_repository (uri);
+  g_free (root);
+
+  return root != NULL;
+}
+
+
+
+static const gchar *
+tvp_git_relative_path (TvpGitDiscovery *discovery, const gchar *path)
+{
+  const gchar *relative;
+
+  relative = path + strlen (discovery->root);
+  while (*relative == '/')
+    relative++;
+
+  return relative;
+}
+
+
+
+static gboolean
+tvp_git_index_tracks (TvpGitIndex *index, const gchar *relative)
+{
+  return (*relative == '\0' ||
+          g_hash_table_contains (index->files, relative) ||
+          g_hash_table_contains (index->dirs, relative));
+}
+
+
+
+/* Whether uri is a file in the index or a directory holding such files. */
+gboolean
+tvp_git_backend_is_tracked (const gchar *uri)
+{
+  TvpGitDiscovery *discovery;
+  TvpGitIndex     *index;
+  const gchar     *relative;
+  gchar           *path;
+  gboolean         result = FALSE;
+
+  path = tvp_git_normalize_path (uri);
+
+  g_mutex_lock (&backend_lock);
+  if (discoveries)
+  {
+    discovery = tvp_git_discover (path);
+    if (discovery->root)
+    {
+      index = tvp_git_get_index (discovery);
+      relative = tvp_git_relative_path (discovery, path);
+      result = tvp_git_index_tracks (index, relative);
+    }
+  }
+  g_mutex_unlock (&backend_lock);
+
+  g_free (path);
+
+  return result;
+}
+
+
+
+/* Answers tvp_git_backend_is_working_copy and tvp_git_backend_is_tracked
+ * from memory. Returns FALSE when that needs the disk, or when a worker
+ * holds the backend, it never blocks. */
+gboolean
+tvp_git_backend_get_cached (const gchar *uri,
+                            gboolean     is_directory,
+                            gboolean    *is_working_copy,
+                            gboolean    *is_tracked)
+{
+  TvpGitDiscovery *discovery;
+  TvpGitIndex     *index;
+  gint64           now;
+  gchar           *path;
+  gchar           *dir;
+  gboolean         known = FALSE;
+
+  path = tvp_git_normalize_path (uri);
+
+  if (!g_mutex_trylock (&backend_lock))
+  {
+    g_free (path);
+    return FALSE;
+  }
+
+  if (discoveries)
+  {
+    now = g_get_monotonic_time ();
+
+    if (is_directory)
+    {
+      discovery = g_hash_table_lookup (discoveries, path);
+    }
+    else
+    {
+      dir = g_path_get_dirname (path);
+      discovery = g_hash_table_lookup (discoveries, dir);
+      g_free (dir);
+    }
+
+    if (tvp_git_discovery_fresh (discovery, now))
+    {
+      *is_working_copy = (discovery->root != NULL);
+      *is_tracked = FALSE;
+
+      if (!discovery->root)
+      {
+        known = TRUE;
+      }
+      else
+      {
+        index = g_hash_table_lookup (indexes, discovery->index_path);
+        if (index && now - index->checked < TVP_GIT_DISCOVERY_TIMEOUT * G_USEC_PER_SEC)
+        {
+          *is_tracked = tvp_git_index_tracks (index, tvp_git_relative_path (discovery, path));
+          known = TRUE;
+        }
+      }
+    }
+  }
+
+  g_mutex_unlock (&backend_lock);
+
+  g_free (path);
+
+  return known;
+}
+
+
+
+static void
+tvp_git_file_status_free (TvpGitFileStatus *status)
+{
+  g_free (status->path);
+  g_free (status);
+}
+
+
+
+/* Whether the content of path hashes to the blob in the index. Content
+ * filters, like line ending conversion, are not applied. */
+static gboolean
+tvp_git_entry_same_content (TvpGitIndexEntry *entry, const gchar *path, GStatBuf *st)
+{
+  GChecksum *checksum;
+  guint8     digest[20];
+  gsize      digest_len = sizeof (digest);
+  gchar      buffer[8192];
+  gchar     *header;
+  gchar     *target;
+  gssize     n = 0;
+  gint       fd;
+  gboolean   result = FALSE;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+  if (S_ISLNK (st->st_mode))
+  {
+    /* a symlink is stored as its target */
+    target = g_file_read_link (path, NULL);
+    if (!target)
+      goto out;
+    header = g_strdup_printf ("blob %" G_GSIZE_FORMAT, strlen (target));
+    g_checksum_update (checksum, (const guchar *) header, strlen (header) + 1);
+    g_checksum_update (checksum, (const guchar *) target, strlen (target));
+    g_free (header);
+    g_free (target);
+  }
+  else
+  {
+    fd = g_open (path, O_RDONLY, 0);
+    if (fd < 0)
+      goto out;
+    header = g_strdup_printf ("blob %" G_GINT64_FORMAT, (gint64) st->st_size);
+    g_checksum_update (checksum, (const guchar *) header, strlen (header) + 1);
+    g_free (header);
+    while ((n = read (fd, buffer, sizeof (buffer))) > 0)
+      g_checksum_update (checksum, (const guchar *) buffer, n);
+    close (fd);
+    if (n < 0)
+      goto out;
+  }
+
+  g_checksum_get_digest (checksum, digest, &digest_len);
+  result = (memcmp (digest, entry->oid, sizeof (entry->oid)) == 0);
+
+out:
+  g_checksum_free (checksum);
+
+  return result;
+}
+
+
+
+/* Whether the file of entry might have changed within the same second
+ * after git recorded its stat data, git calls such an entry racily clean. */
+static gboolean
+tvp_git_entry_racy (TvpGitIndex *index, TvpGitIndexEntry *entry)
+{
+  if (entry->mtime != (guint32) index->mtime)
+    return entry->mtime > (guint32) index->mtime;
+
+  return index->mtime_nsec <= (glong) entry->mtime_nsec;
+}
+
+
+
+static TvpVcsStatus
+tvp_git_entry_state (TvpGitIndex *index, TvpGitIndexEntry *entry, const gchar *path)
+{
+  GStatBuf st;
+
+  if (entry->stage)
+    return TVP_VCS_STATUS_CONFLICTED;
+
+  /* the content of a submodule is not ours to check */
+  if ((entry->mode & 0170000) == TVP_GIT_MODE_GITLINK)
+    return TVP_VCS_STATUS_NORMAL;
+
+  if (g_lstat (path, &st) != 0)
+    return TVP_VCS_STATUS_MODIFIED;
+
+  /* a changed file type or executable bit */
+  if ((entry->mode & 0170000) == TVP_GIT_MODE_SYMLINK)
+  {
+    if (!S_ISLNK (st.st_mode))
+      return TVP_VCS_STATUS_MODIFIED;
+  }
+  else if (!S_ISREG (st.st_mode) || !(st.st_mode & S_IXUSR) != !(entry->mode & 0100))
+  {
+    return TVP_VCS_STATUS_MODIFIED;
+  }
+
+  if ((guint32) st.st_size != entry->size)
+    return TVP_VCS_STATUS_MODIFIED;
+
+  /* like git, unchanged stat data is trusted and otherwise the content
+   * decides, so a touched file is not modified. A file written in the
+   * second the index was, can have been changed after git looked. */
+  if ((guint32) st.st_mtime == entry->mtime && !tvp_git_entry_racy (index, entry))
+    return TVP_VCS_STATUS_NORMAL;
+
+  return tvp_git_entry_same_content (entry, path, &st) ? TVP_VCS_STATUS_NORMAL : TVP_VCS_STATUS_MODIFIED;
+}
+
+
+static void
+tvp_git_ignore_rule_free (TvpGitIgnoreRule *rule)
+{
+  g_free (rule->base);
+  g_free (rule->pattern);
+  g_free (rule);
+}
+
+
+
+static void
+tvp_git_ignore_load (GPtrArray *rules, const gchar *filename, const gchar *base)
+{
+  TvpGitIgnoreRule *rule;
+  gchar           **lines, **iter;
+  gchar            *contents;
+  gchar            *line;
+  gsize             len;
+
+  if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    return;
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  for (iter = lines; *iter; iter++)
+  {
+    line = g_strchomp (*iter);
+    if (!*line || *line == '#')
+      continue;
+
+    rule = g_new0 (TvpGitIgnoreRule, 1);
+
+    if (*line == '!')
+    {
+      rule->negate = TRUE;
+      line++;
+    }
+    else if (*line == '\\' && (line[1] == '!' || line[1] == '#'))
+      line++;
+
+    len = strlen (line);
+    if (len && line[len - 1] == '/')
+    {
+      rule->dir_only = TRUE;
+      line[--len] = '\0';
+    }
+
+    /* a slash anywhere but at the end ties the pattern to base */
+    if (*line == '/')
+    {
+      rule->anchored = TRUE;
+      line++;
+    }
+    else if (strchr (line, '/'))
+      rule->anchored = TRUE;
+
+    if (!*line)
+    {
+      g_free (rule);
+      continue;
+    }
+
+    rule->base = g_strdup (base);
+    rule->pattern = g_strdup (line);
+    g_ptr_array_add (rules, rule);
+  }
+
+  g_strfreev (lines);
+}
+
+
+
+/* The rules that apply to the files in the folder at relative, the
+ * later ones take precedence like in git. core.excludesFile is not read
+ * from the configuration, only its default location. */
+static GPtrArray *
+tvp_git_ignore_rules (TvpGitDiscovery *discovery, const gchar *relative)
+{
+  GPtrArray *rules;
+  gchar     *git_dir;
+  gchar     *filename;
+  gchar     *base;
+  gchar    **parts;
+  guint      i;
+
+  rules = g_ptr_array_new_with_free_func ((GDestroyNotify) tvp_git_ignore_rule_free);
+
+  filename = g_build_filename (g_get_user_config_dir (), "git", "ignore", NULL);
+  tvp_git_ignore_load (rules, filename, "");
+  g_free (filename);
+
+  git_dir = g_path_get_dirname (discovery->index_path);
+  filename = g_build_filename (git_dir, "info", "exclude", NULL);
+  tvp_git_ignore_load (rules, filename, "");
+  g_free (filename);
+  g_free (git_dir);
+
+  filename = g_build_filename (discovery->root, ".gitignore", NULL);
+  tvp_git_ignore_load (rules, filename, "");
+  g_free (filename);
+
+  /* the .gitignore of every folder on the way down */
+  parts = g_strsplit (relative, "/", -1);
+  base = g_strdup ("");
+  for (i = 0; parts[i] && *parts[i]; i++)
+  {
+    gchar *next = *base ? g_strconcat (base, "/", parts[i], NULL) : g_strdup (parts[i]);
+    g_free (base);
+    base = next;
+
+    filename = g_build_filename (discovery->root, base, ".gitignore", NULL);
+    tvp_git_ignore_load (rules, filename, base);
+    g_free (filename);
+  }
+  g_free (base);
+  g_strfreev (parts);
+
+  return rules;
+}
+
+
+
+static gboolean
+tvp_git_ignore_match (GPtrArray *rules, const gchar *relative, gboolean is_dir)
+{
+  TvpGitIgnoreRule *rule;
+  const gchar      *sub;
+  const gchar      *name;
+  gsize             len;
+  guint             i;
+
+  /* the last matching rule decides */
+  for (i = rules->len; i-- > 0;)
+  {
+    rule = g_ptr_array_index (rules, i);
+
+    if (rule->dir_only && !is_dir)
+      continue;
+
+    sub = relative;
+    if (*rule->base)
+    {
+      len = strlen (rule->base);
+      if (strncmp (relative, rule->base, len) != 0 || relative[len] != '/')
+        continue;
+      sub = relative + len + 1;
+    }
+
+    if (rule->anchored)
+    {
+      /* "**" crosses directories */
+      if (fnmatch (rule->pattern, sub, strstr (rule->pattern, "**") ? 0 : FNM_PATHNAME) != 0)
+        continue;
+    }
+    else
+    {
+      name = strrchr (sub, '/');
+      if (fnmatch (rule->pattern, name ? name + 1 : sub, 0) != 0)
+        continue;
+    }
+
+    return !rule->negate;
+  }
+
+  return FALSE;
+}
+
+
+
+/* A file in an ignored folder is ignored, whatever its own rules say */
+static gboolean
+tvp_git_is_ignored (GPtrArray *rules, const gchar *relative, gboolean is_dir)
+{
+  gchar       *parent;
+  const gchar *slash;
+
+  for (slash = strchr (relative, '/'); slash; slash = strchr (slash + 1, '/'))
+  {
+    parent = g_strndup (relative, slash - relative);
+    if (tvp_git_ignore_match (rules, parent, TRUE))
+    {
+      g_free (parent);
+      return TRUE;
+    }
+    g_free (parent);
+  }
+
+  return tvp_git_ignore_match (rules, relative, is_dir);
+}
+
+
+
+/* Returns a table of TvpGitFileStatus for the folder and the files in it,
+ * keyed by the absolute path, or NULL outside a work tree. The caller frees
+ * it with g_hash_table_destroy. */
+GHashTable *
+tvp_git_backend_get_status (const gchar *uri)
+{
+  TvpGitDiscovery  *discovery;
+  TvpGitIndex      *index;
+  TvpGitIndexEntry *entry;
+  TvpGitFileStatus *status;
+  GHashTable       *table = NULL;
+  const gchar      *relative;
+  const gchar      *name;
+  gchar            *path;
+  gchar            *child;
+  GPtrArray        *rules = NULL;
+  GDir             *dir;
+
+  path = tvp_git_normalize_path (uri);
+
+  g_mutex_lock (&backend_lock);
+
+  if (!discoveries)
+    goto out;
+
+  discovery = tvp_git_discover (path);
+  if (!discovery->root)
+    goto out;
+
+  /* nothing is known about the files of a sha256 repository */
+  index = tvp_git_get_index (discovery);
+  if (index->unsupported)
+    goto out;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (!dir)
+    goto out;
+
+  relative = tvp_git_relative_path (discovery, path);
+
+  table = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)tvp_git_file_status_free);
+
+  /* the folder itself */
+  status = g_new0 (TvpGitFileStatus, 1);
+  status->path = g_strdup (path);
+  if (*relative == '\0' || g_hash_table_contains (index->dirs, relative))
+  {
+    status->flag.version_control = 1;
+    status->state = TVP_VCS_STATUS_NORMAL;
+  }
+  else
+  {
+    /* read once per folder, and only when something is untracked */
+    rules = tvp_git_ignore_rules (discovery, relative);
+    status->state = tvp_git_is_ignored (rules, relative, TRUE) ? TVP_VCS_STATUS_IGNORED : TVP_VCS_STATUS_UNVERSIONED;
+  }
+  g_hash_table_replace (table, status->path, status);
+
+  /* a single pass over the folder, no process is spawned */
+  while ((name = g_dir_read_name (dir)) != NULL)
+  {
+    if (*relative == '\0' && !strcmp (name, ".git"))
+      continue;
+
+    if (*relative == '\0')
+      child = g_strdup (name);
+    else
+      child = g_strconcat (relative, "/", name, NULL);
+
+    status = g_new0 (TvpGitFileStatus, 1);
+    status->path = g_build_filename (path, name, NULL);
+
+    entry = g_hash_table_lookup (index->files, child);
+    if (entry)
+    {
+      status->flag.version_control = 1;
+      status->state = tvp_git_entry_state (index, entry, status->path);
+    }
+    else if (g_hash_table_contains (index->dirs, child))
+    {
+      status->flag.version_control = 1;
+      status->state = TVP_VCS_STATUS_NORMAL;
+    }
+    else
+    {
+      if (!rules)
+        rules = tvp_git_ignore_rules (discovery, relative);
+      if (tvp_git_is_ignored (rules, child, g_file_test (status->path, G_FILE_TEST_IS_DIR)))
+        status->state = TVP_VCS_STATUS_IGNORED;
+      else
+        status->state = TVP_VCS_STATUS_UNVERSIONED;
+    }
+
+    g_hash_table_replace (table, status->path, status);
+    g_free (child);
+  }
+
+  g_dir_close (dir);
+  if (rules)
+    g_ptr_array_free (rules, TRUE);
+
+out:
+  g_mutex_unlock (&backend_lock);
+
+  g_free (path);
+
+  return table;
+}
@@ -0,0 +1,57 @@
+/*-
+ * Copyright (C) 2007-2011  Peter de Ridder <peter@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __TVP_GIT_BACKEND_H__
+#define __TVP_GIT_BACKEND_H__
+
+#include <glib.h>
+
+#include <thunar-vcs-plugin/tvp-vcs-status.h>
+
+G_BEGIN_DECLS;
+
+typedef struct
+{
+  gchar *path;
+  TvpVcsStatus state;
+  struct {
+    unsigned version_control : 1;
+  } flag;
+} TvpGitFileStatus;
+
+#define TVP_GIT_FILE_STATUS(p) ((TvpGitFileStatus*)p)
+
+gboolean    tvp_git_backend_init (void);
+void        tvp_git_backend_free (void);
+
+gchar      *tvp_git_backend_get_repository (const gchar *uri);
+
+gboolean    tvp_git_backend_is_working_copy (const gchar *uri);
+
+gboolean    tvp_git_backend_is_tracked (const gchar *uri);
+
+gboolean    tvp_git_backend_get_cached (const gchar *uri,
+                                        gboolean     is_directory,
+                                        gboolean    *is_working_copy,
+                                        gboolean    *is_tracked);
+
+GHashTable *tvp_git_backend_get_status (const gchar *uri);
+
+G_END_DECLS;
+
+#endif /* !__TVP_GIT_BACKEND_H__ */
@@ -38,9 +38,11 @@
 #endif
 
 #ifdef HAVE_GIT
+#include <thunar-vcs-plugin/tvp-git-backend.h>
 #include <thunar-vcs-plugin/tvp-git-action.h>
 #endif
 
+#include <thunar-vcs-plugin/tvp-status-page.h>
 #include <thunar-vcs-plugin/tvp-provider.h>
 
 /* use g_access() on win32 */
@@ -53,6 +55,10 @@
 
 #define TVP_SVN_WORKING_COPY "tvp-svn-working-copy"
 
+/* the status queries all end up at the backend locks, a couple of
+ * workers is plenty */
+#define TVP_STATUS_THREADS 2
+
 
 
 static void   tvp_provider_menu_provider_init          (ThunarxMenuProviderIface *iface);
@@ -81,6 +87,60 @@ typedef struct
   TvpProvider *provider;
 } TvpChildWatch;
 
+/* The head of a status job handed to the worker pool */
+typedef struct
+{
+  gchar        *folder;     /* a newer task for the folder supersedes this one */
+  guint         serial;
+  void        (*run)  (gpointer task);
+  GSourceFunc   done;       /* called on the main loop after run */
+  void        (*free) (gpointer task);
+} TvpStatusTask;
+
+#ifdef HAVE_SUBVERSION
+typedef struct
+{
+  TvpStatusTask task;
+  gchar     *parent;        /* local path of the (parent) folder */
+  gchar    **paths;         /* local paths of the selected files */
+  gboolean  *is_directory;
+  guint      n_files;
+  gboolean   is_parent;
+  gboolean   parent_wc;
+  gboolean   directory_is_wc;
+  gboolean   directory_is_not_wc;
+  gboolean   file_is_vc;
+  gboolean   file_is_not_vc;
+  GWeakRef   action;
+  GWeakRef   page;          /* hidden when the file turns out unversioned */
+} TvpSvnStatusJob;
+#endif
+
+#ifdef HAVE_GIT
+typedef struct
+{
+  TvpStatusTask task;
+  gchar    **paths;         /* local paths of the selected files */
+  gboolean  *is_directory;
+  guint      n_files;
+  gboolean   repository;
+  gboolean   file;
+  GWeakRef   action;
+} TvpGitStatusJob;
+#endif
+
+#if defined(HAVE_SUBVERSION) || defined(HAVE_GIT)
+typedef struct
+{
+  TvpStatusTask task;
+  gchar        *path;
+  gboolean      is_directory;
+  const gchar  *system;     /* NULL outside a working copy */
+  TvpVcsStatus  state;
+  GWeakRef      page;
+} TvpStatusPageJob;
+#endif
+
 struct _TvpProviderClass
 {
   GObjectClass __parent__;
@@ -135,9 +195,17 @@ tvp_provider_property_page_provider_init (ThunarxPropertyPageProviderIface *ifac
 static void
 tvp_provider_init (TvpProvider *tvp_provider)
 {
+  gint64 start = g_get_monotonic_time ();
+
 #ifdef HAVE_SUBVERSION
   tvp_svn_backend_init();
 #endif
+#ifdef HAVE_GIT
+  tvp_git_backend_init();
+#endif
+
+  /* shown with G_MESSAGES_DEBUG=thunar-vcs-plugin */
+  g_debug ("provider initialized in %.1f ms", (g_get_monotonic_time () - start) / 1000.0);
 }
 
 
@@ -156,6 +224,9 @@ static void
 tvp_provider_finalize (GObject *object)
 {
   TvpProvider *tvp_provider = TVP_PROVIDER (object);
+#if defined(HAVE_SUBVERSION) || defined(HAVE_GIT)
+  GThreadPool *pool;
+#endif
 
   if (tvp_provider->child_watch)
   {
@@ -163,22 +234,43 @@ tvp_provider_finalize (GObject *object)
     g_source_set_callback (source, tvp_spawn_close_pid, NULL, NULL);
   }
 
+#if defined(HAVE_SUBVERSION) || defined(HAVE_GIT)
+  /* wait for the running queries, the queued ones are dropped */
+  g_mutex_lock (&status_lock);
+  pool = status_pool;
+  status_pool = NULL;
+  g_mutex_unlock (&status_lock);
+
+  if (pool)
+  {
+    g_thread_pool_free (pool, TRUE, TRUE);
+
+    g_mutex_lock (&status_lock);
+    g_hash_table_destroy (status_serials);
+    status_serials = NULL;
+    g_mutex_unlock (&status_lock);
+  }
+#endif
+
 #ifdef HAVE_SUBVERSION
   tvp_svn_backend_free();
 #endif
+#ifdef HAVE_GIT
+  tvp_git_backend_free();
+#endif
 
   (*G_OBJECT_CLASS (tvp_provider_parent_class)->finalize) (object);
 }
 
 
 
-#ifdef HAVE_SUBVERSION
-static gboolean
-tvp_is_working_copy (ThunarxFileInfo *file_info)
+#if defined(HAVE_SUBVERSION) || defined(HAVE_GIT)
+static gchar *
+tvp_get_filename (ThunarxFileInfo *file_info)
 {
-  gboolean result = FALSE;
-  gchar   *filename;
-  gchar   *uri;
+  gchar *filename = NULL;
+  gchar *uri;
+  gsize  len;
 
   /* determine the URI for the file info */
   uri = thunarx_file_info_get_uri (file_info);
@@ -186,164 +278,648 @@ tvp_is_working_copy (ThunarxFileInfo *file_info)
     {
       /* determine the local filename for the URI */
       filename = g_filename_from_uri (uri, NULL, NULL);
+
+      /* remove trailing '/', the status is keyed by the plain path */
       if (G_LIKELY (filename != NULL))
         {
-          /* check if the folder is a working copy */
-          result = tvp_svn_backend_is_working_copy (filename);
-
-          /* release the filename */
-          g_free (filename);
+          len = strlen (filename);
+          if (len > 1 && filename[len - 1] == '/')
+            filename[len - 1] = '\0';
         }
 
       /* release the URI */
       g_free (uri);
     }
 
-  return result;
+  return filename;
 }
 #endif
 
 
 
-#ifdef HAVE_SUBVERSION
-static gboolean
-tvp_is_parent_working_copy (ThunarxFileInfo *file_info)
+#if defined(HAVE_SUBVERSION) || defined(HAVE_GIT)
+static GMutex       status_lock;
+static GThreadPool *status_pool = NULL;
+static GHashTable  *status_serials = NULL;  /* folder -> serial of its newest task */
+static guint        status_serial = 0;
+
+
+
+static void
+tvp_status_task_thread (gpointer data, gpointer user_data)
 {
-  gboolean result = FALSE;
-  gchar   *filename;
-  gchar   *uri;
+  TvpStatusTask *task = data;
+  gboolean       superseded;
 
-  /* determine the parent URI for the file info */
-  uri = thunarx_file_info_get_parent_uri (file_info);
-  if (G_LIKELY (uri != NULL))
-    {
-      /* determine the local filename for the URI */
-      filename = g_filename_from_uri (uri, NULL, NULL);
-      if (G_LIKELY (filename != NULL))
-        {
-          /* check if the folder is a working copy */
-          result = tvp_svn_backend_is_working_copy (filename);
+  g_mutex_lock (&status_lock);
+  superseded = GPOINTER_TO_UINT (g_hash_table_lookup (status_serials, task->folder)) != task->serial;
+  g_mutex_unlock (&status_lock);
 
-          /* release the filename */
-          g_free (filename);
-        }
+  /* the menu it was for has been replaced by one for the same folder,
+   * whose task is queued already */
+  if (superseded)
+  {
+    task->free (task);
+    return;
+  }
 
-      /* release the URI */
-      g_free (uri);
-    }
+  task->run (task);
+
+  g_idle_add (task->done, task);
+}
+
+
+
+/* Queue the task on the worker pool, an older task for the same folder
+ * that did not start yet is dropped */
+static void
+tvp_status_task_push (TvpStatusTask *task)
+{
+  g_mutex_lock (&status_lock);
+
+  if (!status_pool)
+  {
+    status_pool = g_thread_pool_new (tvp_status_task_thread, NULL, TVP_STATUS_THREADS, FALSE, NULL);
+    status_serials = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  }
+
+  /* 0 is never used, it marks a task that was not queued */
+  if (!++status_serial)
+    ++status_serial;
+  task->serial = status_serial;
+  g_hash_table_insert (status_serials, g_strdup (task->folder), GUINT_TO_POINTER (task->serial));
+
+  g_thread_pool_push (status_pool, task, NULL);
 
-  return result;
+  g_mutex_unlock (&status_lock);
+}
+
+
+
+/* Called from the free function of every task */
+static void
+tvp_status_task_clear (TvpStatusTask *task)
+{
+  if (task->serial)
+  {
+    g_mutex_lock (&status_lock);
+    if (status_serials && GPOINTER_TO_UINT (g_hash_table_lookup (status_serials, task->folder)) == task->serial)
+      g_hash_table_remove (status_serials, task->folder);
+    g_mutex_unlock (&status_lock);
+  }
+
+  g_free (task->folder);
 }
 #endif
 
 
 
 #ifdef HAVE_SUBVERSION
-static GSList *
-tvp_get_parent_status (ThunarxFileInfo *file_info)
+static TvpSvnStatusJob *
+tvp_svn_status_job_new (GList *files, gboolean is_parent)
 {
-  GSList *result = NULL;
-  gchar  *filename;
-  gchar  *uri;
-
-  /* determine the parent URI for the file info */
-  uri = thunarx_file_info_get_parent_uri (file_info);
+  TvpSvnStatusJob *job;
+  GList           *lp;
+  gchar           *uri;
+  gchar           *filename;
+
+  job = g_new0 (TvpSvnStatusJob, 1);
+  job->is_parent = is_parent;
+  g_weak_ref_init (&job->action, NULL);
+  g_weak_ref_init (&job->page, NULL);
+
+  /* determine the (parent) folder of the files */
+  if (is_parent)
+    uri = thunarx_file_info_get_uri (files->data);
+  else
+    uri = thunarx_file_info_get_parent_uri (files->data);
   if (G_LIKELY (uri != NULL))
     {
-      /* determine the local filename for the URI */
-      filename = g_filename_from_uri (uri, NULL, NULL);
+      job->parent = g_filename_from_uri (uri, NULL, NULL);
+      g_free (uri);
+    }
+
+  if (is_parent)
+    return job;
+
+  /* the file infos can not be used from the worker thread */
+  job->paths = g_new0 (gchar *, g_list_length (files) + 1);
+  job->is_directory = g_new0 (gboolean, g_list_length (files));
+  for (lp = files; lp != NULL; lp = lp->next)
+    {
+      filename = tvp_get_filename (lp->data);
       if (G_LIKELY (filename != NULL))
         {
-          /* check if the folder is a working copy */
-          result = tvp_svn_backend_get_status (filename);
-
-          /* release the filename */
-          g_free (filename);
+          job->paths[job->n_files] = filename;
+          job->is_directory[job->n_files] = thunarx_file_info_is_directory (lp->data);
+          job->n_files++;
         }
+    }
 
-      /* release the URI */
-      g_free (uri);
+  return job;
+}
+
+
+
+static void
+tvp_svn_status_job_free (TvpSvnStatusJob *job)
+{
+  tvp_status_task_clear (&job->task);
+  g_weak_ref_clear (&job->action);
+  g_weak_ref_clear (&job->page);
+  g_free (job->parent);
+  g_strfreev (job->paths);
+  g_free (job->is_directory);
+  g_free (job);
+}
+
+
+
+static TvpSvnFileStatus *
+tvp_svn_status_find (GHashTable *file_status, const gchar *filename)
+{
+  if (!file_status)
+    return NULL;
+
+  return g_hash_table_lookup (file_status, filename);
+}
+
+
+
+/* Must be called with the backend lock held. With cached_only it never
+ * touches the working copy and returns FALSE when that would be needed. */
+static gboolean
+tvp_svn_status_job_run (TvpSvnStatusJob *job, gboolean cached_only)
+{
+  TvpSvnFileStatus *entry;
+  GHashTable       *file_status = NULL;
+  guint             i;
+
+  job->parent_wc = FALSE;
+  job->directory_is_wc = FALSE;
+  job->directory_is_not_wc = FALSE;
+  job->file_is_vc = FALSE;
+  job->file_is_not_vc = FALSE;
+
+  if (job->parent)
+  {
+    if (cached_only)
+    {
+      if (!tvp_svn_backend_get_cached_status (job->parent, &file_status))
+        return FALSE;
+
+      /* the status of a working copy contains at least the folder itself */
+      job->parent_wc = (file_status != NULL);
+    }
+    else
+    {
+      if (job->n_files)
+        file_status = tvp_svn_backend_get_status (job->parent);
+
+      job->parent_wc = tvp_svn_backend_is_working_copy (job->parent);
+    }
+  }
+
+  for (i = 0; i < job->n_files; i++)
+  {
+    if (job->is_directory[i])
+    {
+      if (cached_only)
+      {
+        /* only a versioned directory is known to be a working copy */
+        entry = tvp_svn_status_find (file_status, job->paths[i]);
+        if (!entry || !entry->flag.version_control)
+          return FALSE;
+        job->directory_is_wc = TRUE;
+      }
+      else if (tvp_svn_backend_is_working_copy (job->paths[i]))
+      {
+        job->directory_is_wc = TRUE;
+      }
+      else
+      {
+        job->directory_is_not_wc = TRUE;
+      }
+    }
+    else
+    {
+      entry = tvp_svn_status_find (file_status, job->paths[i]);
+      if (entry && entry->flag.version_control)
+      {
+        job->file_is_vc = TRUE;
+      }
+      else
+      {
+        job->file_is_not_vc = TRUE;
+      }
     }
+  }
 
-  return result;
+  return TRUE;
 }
-#endif
 
 
 
-#ifdef HAVE_SUBVERSION
-static gint
-tvp_compare_filename (const gchar *uri1, const gchar *uri2)
+static gboolean
+tvp_svn_status_job_done (gpointer data)
 {
-  gchar *path1, *path2;
-  gint result;
+  TvpSvnStatusJob *job = data;
+  TvpSvnAction    *action;
+  GtkWidget       *page;
 
-  /* strip the "file://" part of the uri */
-  if (strncmp (uri1, "file://", 7) == 0)
+  /* the properties dialog might be gone already */
+  page = g_weak_ref_get (&job->page);
+  if (page)
   {
-    uri1 += 7;
+    if (!job->directory_is_wc && !job->file_is_vc)
+      gtk_widget_hide (page);
+    g_object_unref (page);
   }
 
-  /* strip the "file://" part of the uri */
-  if (strncmp (uri2, "file://", 7) == 0)
+  /* the menu might be gone already */
+  action = g_weak_ref_get (&job->action);
+  if (action)
   {
-    uri2 += 7;
+    tvp_svn_action_set_status (action, job->parent_wc,
+                               job->directory_is_wc, job->directory_is_not_wc,
+                               job->file_is_vc, job->file_is_not_vc);
+    g_object_unref (action);
   }
 
-  path1 = g_strdup (uri1);
-  path2 = g_strdup (uri2);
+  tvp_svn_status_job_free (job);
+
+  return FALSE;
+}
+
+
+
+static void
+tvp_svn_status_job_thread (gpointer data)
+{
+  TvpSvnStatusJob *job = data;
+
+  tvp_svn_backend_lock ();
+  tvp_svn_status_job_run (job, FALSE);
+  tvp_svn_backend_unlock ();
+}
+
+
+
+/* Leave the query to the worker pool, done updates the menu or page */
+static void
+tvp_svn_status_job_push (TvpSvnStatusJob *job)
+{
+  job->task.folder = g_strdup (job->parent ? job->parent : "");
+  job->task.run = tvp_svn_status_job_thread;
+  job->task.done = tvp_svn_status_job_done;
+  job->task.free = (void (*) (gpointer)) tvp_svn_status_job_free;
+
+  tvp_status_task_push (&job->task);
+}
+
 
-  /* remove trailing '/' */
-  if (strlen (path1) > 1 && path1[strlen (path1) - 1] == '/')
+
+static ThunarxMenuItem *
+tvp_svn_menu_item_new (const gchar *name,
+                       GList       *files,
+                       GtkWidget   *window,
+                       gboolean     is_parent)
+{
+  ThunarxMenuItem *item;
+  TvpSvnStatusJob *job;
+  gboolean         known = FALSE;
+  gboolean         has_directories = FALSE;
+  gboolean         has_files = FALSE;
+  guint            i;
+
+  job = tvp_svn_status_job_new (files, is_parent);
+
+  /* use the cached status when it is available, but never wait for a
+   * worker to release the backend */
+  if (tvp_svn_backend_trylock ())
   {
-    path1[strlen (path1) - 1] = '\0';
+    known = tvp_svn_status_job_run (job, TRUE);
+    tvp_svn_backend_unlock ();
   }
 
-  /* remove trailing '/'*/
-  if (strlen (path2) > 1 && path2[strlen (path2) - 1] == '/')
+  if (known)
   {
-    path2[strlen (path2) - 1] = '\0';
+    item = tvp_svn_action_new (name, _("SVN"), files, window, is_parent, job->parent_wc,
+                               job->directory_is_wc, job->directory_is_not_wc,
+                               job->file_is_vc, job->file_is_not_vc);
+    tvp_svn_status_job_free (job);
+    return item;
   }
-  
-  result = strcmp (path1, path2);
 
-  g_free (path1);
-  g_free (path2);
+  for (i = 0; i < job->n_files; i++)
+  {
+    if (job->is_directory[i])
+      has_directories = TRUE;
+    else
+      has_files = TRUE;
+  }
+
+  /* return the menu right away and update it once the worker is done */
+  item = tvp_svn_action_new_pending (name, _("SVN"), files, window, is_parent, has_directories, has_files);
+  g_weak_ref_set (&job->action, item);
+  tvp_svn_status_job_push (job);
 
-  return result;
+  return item;
 }
 #endif
 
 
 
-#ifdef HAVE_SUBVERSION
-static gint
-tvp_compare_path (TvpSvnFileStatus *file_status, ThunarxFileInfo *file_info)
+#ifdef HAVE_GIT
+static TvpGitStatusJob *
+tvp_git_status_job_new (GList *files)
 {
-  gint   result = 1;
-  gchar *filename;
-  gchar *uri;
+  TvpGitStatusJob *job;
+  GList           *lp;
+  gchar           *filename;
 
-  /* determine the parent URI for the file info */
-  uri = thunarx_file_info_get_uri (file_info);
-  if (G_LIKELY (uri != NULL))
+  job = g_new0 (TvpGitStatusJob, 1);
+  g_weak_ref_init (&job->action, NULL);
+
+  /* the file infos can not be used from the worker thread */
+  job->paths = g_new0 (gchar *, g_list_length (files) + 1);
+  job->is_directory = g_new0 (gboolean, g_list_length (files));
+  for (lp = files; lp != NULL; lp = lp->next)
     {
-      /* determine the local filename for the URI */
-      filename = g_filename_from_uri (uri, NULL, NULL);
+      filename = tvp_get_filename (lp->data);
       if (G_LIKELY (filename != NULL))
         {
-          /* check if the folder is a working copy */
-          result = tvp_compare_filename (file_status->path, filename);
-
-          /* release the filename */
-          g_free (filename);
+          job->paths[job->n_files] = filename;
+          job->is_directory[job->n_files] = thunarx_file_info_is_directory (lp->data);
+          job->n_files++;
         }
+    }
 
-      /* release the URI */
-      g_free (uri);
+  return job;
+}
+
+
+
+static void
+tvp_git_status_job_free (TvpGitStatusJob *job)
+{
+  tvp_status_task_clear (&job->task);
+  g_weak_ref_clear (&job->action);
+  g_strfreev (job->paths);
+  g_free (job->is_directory);
+  g_free (job);
+}
+
+
+
+/* With cached_only it never touches the disk and returns FALSE when that
+ * would be needed. */
+static gboolean
+tvp_git_status_job_run (TvpGitStatusJob *job, gboolean cached_only)
+{
+  gboolean is_working_copy;
+  gboolean is_tracked;
+  guint    i;
+
+  job->repository = FALSE;
+  job->file = FALSE;
+
+  for (i = 0; i < job->n_files; i++)
+  {
+    if (cached_only)
+    {
+      if (!tvp_git_backend_get_cached (job->paths[i], job->is_directory[i], &is_working_copy, &is_tracked))
+        return FALSE;
+    }
+    else
+    {
+      is_working_copy = tvp_git_backend_is_working_copy (job->paths[i]);
+      is_tracked = is_working_copy && !job->is_directory[i] && tvp_git_backend_is_tracked (job->paths[i]);
+    }
+
+    if (is_working_copy)
+      job->repository = TRUE;
+
+    /* only tracked files have a history to blame */
+    if (!job->is_directory[i] && is_tracked)
+      job->file = TRUE;
+  }
+
+  return TRUE;
+}
+
+
+
+static gboolean
+tvp_git_status_job_done (gpointer data)
+{
+  TvpGitStatusJob *job = data;
+  TvpGitAction    *action;
+
+  /* the menu might be gone already */
+  action = g_weak_ref_get (&job->action);
+  if (action)
+  {
+    tvp_git_action_set_status (action, job->file, job->repository);
+    g_object_unref (action);
+  }
+
+  tvp_git_status_job_free (job);
+
+  return FALSE;
+}
+
+
+
+static void
+tvp_git_status_job_thread (gpointer data)
+{
+  tvp_git_status_job_run (data, FALSE);
+}
+
+
+
+/* Leave the query to the worker pool, done updates the menu */
+static void
+tvp_git_status_job_push (TvpGitStatusJob *job, gboolean is_parent)
+{
+  if (job->n_files == 0)
+    job->task.folder = g_strdup ("");
+  else if (is_parent)
+    job->task.folder = g_strdup (job->paths[0]);
+  else
+    job->task.folder = g_path_get_dirname (job->paths[0]);
+  job->task.run = tvp_git_status_job_thread;
+  job->task.done = tvp_git_status_job_done;
+  job->task.free = (void (*) (gpointer)) tvp_git_status_job_free;
+
+  tvp_status_task_push (&job->task);
+}
+
+
+
+/* Returns NULL for files outside a repository once that is known */
+static ThunarxMenuItem *
+tvp_git_menu_item_new (const gchar *name,
+                       GList       *files,
+                       GtkWidget   *window,
+                       gboolean     is_parent)
+{
+  ThunarxMenuItem *item = NULL;
+  TvpGitStatusJob *job;
+  gboolean         has_directories = FALSE;
+  gboolean         has_files = FALSE;
+  guint            i;
+
+  job = tvp_git_status_job_new (files);
+
+  for (i = 0; i < job->n_files; i++)
+  {
+    if (job->is_directory[i])
+      has_directories = TRUE;
+    else
+      has_files = TRUE;
+  }
+
+  /* the repository walk and the index are left to a worker unless they
+   * are known already */
+  if (tvp_git_status_job_run (job, TRUE))
+  {
+    if (is_parent || job->repository)
+      item = tvp_git_action_new (name, _("GIT"), files, window, is_parent, has_directories, job->file, job->repository);
+    tvp_git_status_job_free (job);
+    return item;
+  }
+
+  /* return the menu right away and update it once the worker is done */
+  item = tvp_git_action_new_pending (name, _("GIT"), files, window, is_parent, has_directories, has_files);
+  g_weak_ref_set (&job->action, item);
+  tvp_git_status_job_push (job, is_parent);
+
+  return item;
+}
+#endif
+
+
+
+#if defined(HAVE_SUBVERSION) || defined(HAVE_GIT)
+static void
+tvp_status_page_job_free (TvpStatusPageJob *job)
+{
+  tvp_status_task_clear (&job->task);
+  g_weak_ref_clear (&job->page);
+  g_free (job->path);
+  g_free (job);
+}
+
+
+
+/* One status query of the folder holding the file, a folder that is not
+ * in the status of its parent, like the root of a working copy, is
+ * looked up in its own */
+static void
+tvp_status_page_job_run (gpointer data)
+{
+  TvpStatusPageJob *job = data;
+#ifdef HAVE_SUBVERSION
+  TvpSvnFileStatus *svn_entry;
+#endif
+#ifdef HAVE_GIT
+  TvpGitFileStatus *git_entry;
+  GHashTable       *git_status;
+#endif
+
+#ifdef HAVE_SUBVERSION
+  tvp_svn_backend_lock ();
+  svn_entry = tvp_svn_status_find (tvp_svn_backend_get_status (job->task.folder), job->path);
+  if (!svn_entry && job->is_directory)
+    svn_entry = tvp_svn_status_find (tvp_svn_backend_get_status (job->path), job->path);
+  if (svn_entry)
+  {
+    job->system = "Subversion";
+    job->state = svn_entry->state;
+  }
+  tvp_svn_backend_unlock ();
+#endif
+
+#ifdef HAVE_GIT
+  /* a nested svn working copy knows better */
+  if (!job->system)
+  {
+    git_status = tvp_git_backend_get_status (job->task.folder);
+    git_entry = git_status ? g_hash_table_lookup (git_status, job->path) : NULL;
+    if (!git_entry && job->is_directory)
+    {
+      if (git_status)
+        g_hash_table_destroy (git_status);
+      git_status = tvp_git_backend_get_status (job->path);
+      git_entry = git_status ? g_hash_table_lookup (git_status, job->path) : NULL;
     }
+    if (git_entry)
+    {
+      job->system = "Git";
+      job->state = git_entry->state;
+    }
+    if (git_status)
+      g_hash_table_destroy (git_status);
+  }
+#endif
+}
+
+
+
+static gboolean
+tvp_status_page_job_done (gpointer data)
+{
+  TvpStatusPageJob *job = data;
+  GtkWidget        *page;
+
+  /* the properties dialog might be gone already */
+  page = g_weak_ref_get (&job->page);
+  if (page)
+  {
+    if (job->system)
+      tvp_status_page_set_status (TVP_STATUS_PAGE (page), job->system, job->state);
+    else
+      gtk_widget_hide (page);
+    g_object_unref (page);
+  }
+
+  tvp_status_page_job_free (job);
+
+  return FALSE;
+}
+
+
+
+/* Returns a page showing the status of the file, filled in by a worker.
+ * The status is never stored with the file. */
+static GtkWidget *
+tvp_status_page_create (ThunarxFileInfo *file)
+{
+  TvpStatusPageJob *job;
+  GtkWidget        *page;
+  gchar            *filename;
 
-  return result;
+  filename = tvp_get_filename (file);
+  if (G_UNLIKELY (filename == NULL))
+    return NULL;
+
+  job = g_new0 (TvpStatusPageJob, 1);
+  job->path = filename;
+  job->is_directory = thunarx_file_info_is_directory (file);
+  g_weak_ref_init (&job->page, NULL);
+
+  job->task.folder = g_path_get_dirname (filename);
+  job->task.run = tvp_status_page_job_run;
+  job->task.done = tvp_status_page_job_done;
+  job->task.free = (void (*) (gpointer)) tvp_status_page_job_free;
+
+  page = tvp_status_page_new ();
+  g_weak_ref_set (&job->page, page);
+  tvp_status_task_push (&job->task);
+
+  return page;
 }
 #endif
 
@@ -359,23 +935,8 @@ tvp_provider_get_file_menu_items (ThunarxMenuProvider *menu_provider,
   GList              *lp;
   gint               n_files = 0;
   gchar              *scheme;
-#ifdef HAVE_SUBVERSION
-  gboolean            parent_wc = FALSE;
-  gboolean            directory_is_wc = FALSE;
-  gboolean            directory_is_not_wc = FALSE;
-  gboolean            file_is_vc = FALSE;
-  gboolean            file_is_not_vc = FALSE;
-  GSList             *file_status;
-  GSList             *iter;
-#endif
-#ifdef HAVE_GIT
-  gboolean            directory = FALSE;
-  gboolean            file = FALSE;
-#endif
 
 #ifdef HAVE_SUBVERSION
-  file_status = tvp_get_parent_status (files->data);
-
   /* check all supplied files */
   for (lp = files; lp != NULL; lp = lp->next, ++n_files)
   {
@@ -389,46 +950,10 @@ tvp_provider_get_file_menu_items (ThunarxMenuProvider *menu_provider,
       return NULL;
     }
     g_free (scheme);
-
-    /* check if the parent folder is a working copy */
-    if (!parent_wc && tvp_is_parent_working_copy (lp->data))
-      parent_wc = TRUE;
-
-    if (thunarx_file_info_is_directory (lp->data))
-    {
-      if (tvp_is_working_copy (lp->data))
-      {
-        directory_is_wc = TRUE;
-      }
-      else
-      {
-        directory_is_not_wc = TRUE;
-      }
-    }
-    else
-    {
-      for (iter = file_status; iter; iter = iter->next)
-      {
-        if (!tvp_compare_path (iter->data, lp->data))
-        {
-          if (TVP_SVN_FILE_STATUS (iter->data)->flag.version_control)
-          {
-            file_is_vc = TRUE;
-          }
-          else
-          {
-            file_is_not_vc = TRUE;
-          }
-          break;
-        }
-      }
-      if(!iter)
-        file_is_not_vc = TRUE;
-    }
   }
 
   /* append the svn submenu item */
-  item = tvp_svn_action_new ("Tvp::svn", _("SVN"), files, window, FALSE, parent_wc, directory_is_wc, directory_is_not_wc, file_is_vc, file_is_not_vc);
+  item = tvp_svn_menu_item_new ("Tvp::svn", files, window, FALSE);
   g_signal_connect(item, "new-process", G_CALLBACK(tvp_new_process), menu_provider);
   items = g_list_append (items, item);
 #endif
@@ -447,21 +972,15 @@ tvp_provider_get_file_menu_items (ThunarxMenuProvider *menu_provider,
       return NULL;
     }
     g_free (scheme);
-
-    if (thunarx_file_info_is_directory (lp->data))
-    {
-      directory = TRUE;
-    }
-    else
-    {
-      file = TRUE;
-    }
   }
 
   /* append the git submenu item */
-  item = tvp_git_action_new ("Tvp::git", _("GIT"), files, window, FALSE, directory, file);
-  g_signal_connect(item, "new-process", G_CALLBACK(tvp_new_process), menu_provider);
-  items = g_list_append (items, item);
+  item = tvp_git_menu_item_new ("Tvp::git", files, window, FALSE);
+  if (item)
+  {
+    g_signal_connect(item, "new-process", G_CALLBACK(tvp_new_process), menu_provider);
+    items = g_list_append (items, item);
+  }
 #endif
 
   return items;
@@ -494,14 +1013,14 @@ tvp_provider_get_folder_menu_items (ThunarxMenuProvider *menu_provider,
 
 #ifdef HAVE_SUBVERSION
   /* Lets see if we are dealing with a working copy */
-  item = tvp_svn_action_new ("Tvp::svn", _("SVN"), files, window, TRUE, tvp_is_working_copy (folder), FALSE, FALSE, FALSE, FALSE);
+  item = tvp_svn_menu_item_new ("Tvp::svn", files, window, TRUE);
   g_signal_connect(item, "new-process", G_CALLBACK(tvp_new_process), menu_provider);
   /* append the svn submenu item */
   items = g_list_append (items, item);
 #endif
 
 #ifdef HAVE_GIT
-  item = tvp_git_action_new ("Tvp::git-folder", _("GIT"), files, window, TRUE, TRUE, FALSE);
+  item = tvp_git_menu_item_new ("Tvp::git-folder", files, window, TRUE);
   g_signal_connect(item, "new-process", G_CALLBACK(tvp_new_process), menu_provider);
   /* append the git submenu item */
   items = g_list_append (items, item);
@@ -518,55 +1037,61 @@ static GList*
 tvp_provider_get_pages (ThunarxPropertyPageProvider *page_provider, GList *files)
 {
   GList *pages = NULL;
+#if defined(HAVE_SUBVERSION) || defined(HAVE_GIT)
+  GtkWidget *page;
+  gchar     *scheme;
+
+  if (g_list_length (files) != 1)
+    return NULL;
+
+  /* check if the file is a local file */
+  scheme = thunarx_file_info_get_uri_scheme (files->data);
+
+  /* unable to handle non-local files */
+  if (G_UNLIKELY (strcmp (scheme, "file")))
+  {
+    g_free (scheme);
+    return NULL;
+  }
+  g_free (scheme);
+#endif
 #ifdef HAVE_SUBVERSION
-  if (g_list_length (files) == 1)
   {
-    gboolean            is_vc = FALSE;
-    gchar              *scheme;
+    TvpSvnStatusJob    *job;
+    gboolean            known = FALSE;
 
-    /* check if the file is a local file */
-    scheme = thunarx_file_info_get_uri_scheme (files->data);
+    job = tvp_svn_status_job_new (files, FALSE);
 
-    /* unable to handle non-local files */
-    if (G_UNLIKELY (strcmp (scheme, "file")))
+    /* the properties dialog waits for the pages, so only use the cached
+     * status and never wait for a worker to release the backend */
+    if (tvp_svn_backend_trylock ())
     {
-      g_free (scheme);
-      return NULL;
+      known = tvp_svn_status_job_run (job, TRUE);
+      tvp_svn_backend_unlock ();
     }
-    g_free (scheme);
 
-    if (thunarx_file_info_is_directory (files->data))
+    if (known)
     {
-      /* Lets see if we are dealing with a working copy */
-      if (tvp_is_working_copy (files->data))
-      {
-        is_vc = TRUE;
-      }
+      if (job->directory_is_wc || job->file_is_vc)
+        pages = g_list_prepend (pages, tvp_svn_property_page_new (files->data));
+      tvp_svn_status_job_free (job);
     }
     else
     {
-      GSList             *file_status;
-      GSList             *iter;
-
-      file_status = tvp_get_parent_status (files->data);
-
-      for (iter = file_status; iter; iter = iter->next)
-      {
-        if (!tvp_compare_path (iter->data, files->data))
-        {
-          if (TVP_SVN_FILE_STATUS (iter->data)->flag.version_control)
-          {
-            is_vc = TRUE;
-          }
-          break;
-        }
-      }
-    }
-    if(is_vc)
-    {
-      pages = g_list_prepend (pages, tvp_svn_property_page_new (files->data));
+      /* add the page right away and hide it once the worker knows the
+       * file is not versioned */
+      page = GTK_WIDGET (tvp_svn_property_page_new (files->data));
+      pages = g_list_prepend (pages, page);
+      g_weak_ref_set (&job->page, page);
+      tvp_svn_status_job_push (job);
     }
   }
+#endif
+#if defined(HAVE_SUBVERSION) || defined(HAVE_GIT)
+  /* hidden again when the file turns out to be outside any working copy */
+  page = tvp_status_page_create (files->data);
+  if (page)
+    pages = g_list_append (pages, page);
 #endif
   return pages;
 }
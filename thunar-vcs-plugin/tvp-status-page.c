@@ -0,0 +1,156 @@
+/*-
+ * Copyright (C) 2007-2011  Peter de Ridder <peter@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <thunarx/thunarx.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <thunar-vcs-plugin/tvp-status-page.h>
+
+
+
+struct _TvpStatusPageClass
+{
+  ThunarxPropertyPageClass __parent__;
+};
+
+
+
+struct _TvpStatusPage
+{
+  ThunarxPropertyPage __parent__;
+
+  GtkWidget *system;
+  GtkWidget *status;
+};
+
+
+
+THUNARX_DEFINE_TYPE (TvpStatusPage, tvp_status_page, THUNARX_TYPE_PROPERTY_PAGE)
+
+
+
+static void
+tvp_status_page_class_init (TvpStatusPageClass *klass)
+{
+}
+
+
+
+static GtkWidget *
+tvp_status_page_add_row (GtkWidget *grid, const gchar *title, gint row, PangoAttrList *attr_list)
+{
+  GtkWidget *label;
+
+  label = gtk_label_new (title);
+  gtk_label_set_xalign (GTK_LABEL (label), 1.0);
+  gtk_label_set_yalign (GTK_LABEL (label), 0.5);
+  gtk_label_set_attributes (GTK_LABEL (label), attr_list);
+  gtk_grid_attach (GTK_GRID (grid), label, 0, row, 1, 1);
+  gtk_widget_show (label);
+
+  label = gtk_label_new (_("Unknown"));
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0);
+  gtk_label_set_yalign (GTK_LABEL (label), 0.5);
+  gtk_label_set_selectable (GTK_LABEL (label), TRUE);
+  gtk_widget_set_hexpand (label, TRUE);
+  gtk_grid_attach (GTK_GRID (grid), label, 1, row, 1, 1);
+  gtk_widget_show (label);
+
+  return label;
+}
+
+
+
+static void
+tvp_status_page_init (TvpStatusPage *self)
+{
+  GtkWidget *grid;
+  PangoAttrList *attr_list;
+
+  attr_list = pango_attr_list_new ();
+  pango_attr_list_insert (attr_list, pango_attr_weight_new (PANGO_WEIGHT_BOLD));
+
+  gtk_container_set_border_width (GTK_CONTAINER (self), 12);
+
+  grid = gtk_grid_new ();
+  gtk_grid_set_column_spacing (GTK_GRID (grid), 12);
+  gtk_grid_set_row_spacing (GTK_GRID (grid), 6);
+
+  self->system = tvp_status_page_add_row (grid, _("Version control:"), 0, attr_list);
+  self->status = tvp_status_page_add_row (grid, _("Status:"), 1, attr_list);
+
+  pango_attr_list_unref (attr_list);
+
+  gtk_container_add (GTK_CONTAINER (self), grid);
+  gtk_widget_show (grid);
+}
+
+
+
+/* The status is filled in by the provider once it is known, nothing is
+ * stored with the file */
+GtkWidget *
+tvp_status_page_new (void)
+{
+  return g_object_new (TVP_TYPE_STATUS_PAGE,
+                       "label", _("Version Control"),
+                       NULL);
+}
+
+
+
+void
+tvp_status_page_set_status (TvpStatusPage *page, const gchar *system, TvpVcsStatus status)
+{
+  const gchar *text;
+
+  g_return_if_fail (TVP_IS_STATUS_PAGE (page));
+
+  switch (status)
+  {
+    case TVP_VCS_STATUS_NORMAL:
+      text = _("Unchanged");
+      break;
+    case TVP_VCS_STATUS_ADDED:
+      text = _("Added");
+      break;
+    case TVP_VCS_STATUS_MODIFIED:
+      text = _("Modified");
+      break;
+    case TVP_VCS_STATUS_CONFLICTED:
+      text = _("Conflicted");
+      break;
+    case TVP_VCS_STATUS_UNVERSIONED:
+      text = _("Unversioned");
+      break;
+    case TVP_VCS_STATUS_IGNORED:
+      text = _("Ignored");
+      break;
+    default:
+      text = _("Unknown");
+      break;
+  }
+
+  gtk_label_set_text (GTK_LABEL (page->system), system);
+  gtk_label_set_text (GTK_LABEL (page->status), text);
+}
@@ -0,0 +1,47 @@
+/*-
+ * Copyright (C) 2007-2011  Peter de Ridder <peter@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __TVP_STATUS_PAGE_H__
+#define __TVP_STATUS_PAGE_H__
+
+#include <gtk/gtk.h>
+
+#include <thunar-vcs-plugin/tvp-vcs-status.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _TvpStatusPageClass TvpStatusPageClass;
+typedef struct _TvpStatusPage      TvpStatusPage;
+
+#define TVP_TYPE_STATUS_PAGE             (tvp_status_page_get_type ())
+#define TVP_STATUS_PAGE(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), TVP_TYPE_STATUS_PAGE, TvpStatusPage))
+#define TVP_STATUS_PAGE_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), TVP_TYPE_STATUS_PAGE, TvpStatusPageClass))
+#define TVP_IS_STATUS_PAGE(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), TVP_TYPE_STATUS_PAGE))
+#define TVP_IS_STATUS_PAGE_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), TVP_TYPE_STATUS_PAGE))
+#define TVP_STATUS_PAGE_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), TVP_TYPE_STATUS_PAGE, TvpStatusPageClass))
+
+GType      tvp_status_page_get_type      (void) G_GNUC_CONST G_GNUC_INTERNAL;
+void       tvp_status_page_register_type (ThunarxProviderPlugin *) G_GNUC_INTERNAL;
+
+GtkWidget *tvp_status_page_new           (void) G_GNUC_MALLOC G_GNUC_INTERNAL;
+
+void       tvp_status_page_set_status    (TvpStatusPage *, const gchar *, TvpVcsStatus) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TVP_STATUS_PAGE_H__ */
@@ -20,8 +20,19 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
 #include <string.h>
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+#include <sys/un.h>
+#endif
+#include <sys/time.h>
 #include <sys/wait.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #include <libxfce4util/libxfce4util.h>
 #include <thunar-vcs-plugin/tvp-svn-action.h>
 
@@ -43,6 +54,15 @@ struct _TvpSvnActionClass
 
 
 
+typedef enum {
+  TVP_SVN_ACTION_PASS_BUILD = 0,     /* add the items which apply */
+  TVP_SVN_ACTION_PASS_COLLECT,       /* remember the items which might apply */
+  TVP_SVN_ACTION_PASS_BUILD_PENDING, /* add the remembered items */
+  TVP_SVN_ACTION_PASS_UPDATE         /* update the sensitivity of the added items */
+} TvpSvnActionPass;
+
+
+
 struct _TvpSvnAction
 {
   ThunarxMenuItem __parent__;
@@ -58,6 +78,9 @@ struct _TvpSvnAction
 
   GList *files;
   GtkWidget *window;
+
+  TvpSvnActionPass pass;
+  GHashTable *subitems;
 };
 
 
@@ -86,6 +109,8 @@ static guint action_signal[SIGNAL_COUNT];
 
 static void tvp_svn_action_create_menu_item (ThunarxMenuItem *action);
 
+static void tvp_svn_action_add_subactions (ThunarxMenuItem *action, ThunarxMenu *menu);
+
 static void tvp_svn_action_finalize (GObject*);
 
 static void tvp_svn_action_set_property (GObject*, guint, const GValue*, GParamSpec*);
@@ -149,6 +174,8 @@ tvp_svn_action_init (TvpSvnAction *self)
   self->property.file_no_version_control = 0;
   self->files = NULL;
   self->window = NULL;
+  self->pass = TVP_SVN_ACTION_PASS_BUILD;
+  self->subitems = NULL;
 }
 
 
@@ -191,9 +218,94 @@ tvp_svn_action_new (const gchar *name,
 
 
 
+static void
+tvp_svn_action_set_flags (TvpSvnAction *tvp_action,
+                          gboolean parent_version_control,
+                          gboolean directory_version_control,
+                          gboolean directory_no_version_control,
+                          gboolean file_version_control,
+                          gboolean file_no_version_control)
+{
+  tvp_action->property.parent_version_control = parent_version_control?1:0;
+  tvp_action->property.directory_version_control = directory_version_control?1:0;
+  tvp_action->property.directory_no_version_control = directory_no_version_control?1:0;
+  tvp_action->property.file_version_control = file_version_control?1:0;
+  tvp_action->property.file_no_version_control = file_no_version_control?1:0;
+}
+
+
+
+ThunarxMenuItem *
+tvp_svn_action_new_pending (const gchar *name,
+                            const gchar *label,
+                            GList *files,
+                            GtkWidget *window,
+                            gboolean is_parent,
+                            gboolean has_directories,
+                            gboolean has_files)
+{
+  ThunarxMenuItem *item;
+  TvpSvnAction *tvp_action;
+
+  g_return_val_if_fail(name, NULL);
+  g_return_val_if_fail(label, NULL);
+
+  item = g_object_new (TVP_TYPE_SVN_ACTION,
+            "name", name,
+            "label", label,
+            "is-parent", is_parent,
+            "icon", "subversion",
+            NULL);
+  tvp_action = TVP_SVN_ACTION (item);
+  tvp_action->files = thunarx_file_info_list_copy (files);
+  tvp_action->window = window;
+  tvp_action->subitems = g_hash_table_new (g_str_hash, g_str_equal);
+
+  /* remember every item which might apply once the status is known,
+   * the conditions only negate the parent flag so two passes cover all */
+  tvp_action->pass = TVP_SVN_ACTION_PASS_COLLECT;
+  tvp_svn_action_set_flags (tvp_action, TRUE, has_directories, has_directories, has_files, has_files);
+  tvp_svn_action_add_subactions (item, NULL);
+  tvp_svn_action_set_flags (tvp_action, FALSE, has_directories, has_directories, has_files, has_files);
+  tvp_svn_action_add_subactions (item, NULL);
+
+  /* until then be optimistic and assume everything is under version control */
+  tvp_action->pass = TVP_SVN_ACTION_PASS_BUILD_PENDING;
+  tvp_svn_action_set_flags (tvp_action, TRUE, has_directories, FALSE, has_files, FALSE);
+  tvp_svn_action_create_menu_item (item);
+
+  return item;
+}
+
+
+
+void
+tvp_svn_action_set_status (TvpSvnAction *tvp_action,
+                           gboolean parent_version_control,
+                           gboolean directory_version_control,
+                           gboolean directory_no_version_control,
+                           gboolean file_version_control,
+                           gboolean file_no_version_control)
+{
+  g_return_if_fail (TVP_IS_SVN_ACTION (tvp_action));
+  g_return_if_fail (tvp_action->subitems != NULL);
+
+  tvp_svn_action_set_flags (tvp_action, parent_version_control,
+                            directory_version_control, directory_no_version_control,
+                            file_version_control, file_no_version_control);
+
+  tvp_action->pass = TVP_SVN_ACTION_PASS_UPDATE;
+  tvp_svn_action_add_subactions (THUNARX_MENU_ITEM (tvp_action), NULL);
+}
+
+
+
 static void
 tvp_svn_action_finalize (GObject *object)
 {
+  if (TVP_SVN_ACTION (object)->subitems)
+    g_hash_table_destroy (TVP_SVN_ACTION (object)->subitems);
+  TVP_SVN_ACTION (object)->subitems = NULL;
   thunarx_file_info_list_free (TVP_SVN_ACTION (object)->files);
   TVP_SVN_ACTION (object)->files = NULL;
   TVP_SVN_ACTION (object)->window = NULL;
@@ -234,13 +346,41 @@ tvp_svn_action_set_property (GObject *object, guint property_id, const GValue *v
 
 
 static void
-add_subaction(ThunarxMenuItem *item, ThunarxMenu *menu, const gchar *name, const gchar *text, const gchar *tooltip, const gchar *icon, gchar *arg)
+add_subaction(ThunarxMenuItem *item, ThunarxMenu *menu, gboolean condition, const gchar *name, const gchar *text, const gchar *tooltip, const gchar *icon, gchar *arg)
 {
+    TvpSvnAction *tvp_action = TVP_SVN_ACTION (item);
     ThunarxMenuItem *subitem;
+
+    switch (tvp_action->pass)
+    {
+      case TVP_SVN_ACTION_PASS_BUILD:
+        if (!condition)
+          return;
+        break;
+      case TVP_SVN_ACTION_PASS_COLLECT:
+        if (condition)
+          g_hash_table_insert (tvp_action->subitems, (gpointer) name, NULL);
+        return;
+      case TVP_SVN_ACTION_PASS_BUILD_PENDING:
+        if (!g_hash_table_contains (tvp_action->subitems, name))
+          return;
+        break;
+      case TVP_SVN_ACTION_PASS_UPDATE:
+        subitem = g_hash_table_lookup (tvp_action->subitems, name);
+        if (subitem)
+          thunarx_menu_item_set_sensitive (subitem, condition);
+        return;
+    }
+
     subitem = thunarx_menu_item_new (name, text, tooltip, icon);
     thunarx_menu_append_item (menu, subitem);
     g_object_set_qdata (G_OBJECT (subitem), tvp_action_arg_quark, arg);
     g_signal_connect_after (subitem, "activate", G_CALLBACK (tvp_action_exec), item);
+    if (tvp_action->pass == TVP_SVN_ACTION_PASS_BUILD_PENDING)
+    {
+      thunarx_menu_item_set_sensitive (subitem, condition);
+      g_hash_table_insert (tvp_action->subitems, (gpointer) name, subitem);
+    }
     g_object_unref (subitem);
 }
 
@@ -249,21 +389,25 @@ static void
 tvp_svn_action_create_menu_item (ThunarxMenuItem *item)
 {
   ThunarxMenu *menu;
-  TvpSvnAction *tvp_action = TVP_SVN_ACTION (item);
 
   menu = thunarx_menu_new ();
   thunarx_menu_item_set_menu (item, menu);
 
+  tvp_svn_action_add_subactions (item, menu);
+}
+
+
+static void
+tvp_svn_action_add_subactions (ThunarxMenuItem *item, ThunarxMenu *menu)
+{
+  TvpSvnAction *tvp_action = TVP_SVN_ACTION (item);
+
   /* No version control or version control (parent) */
-  if (tvp_action->property.parent_version_control && (tvp_action->property.is_parent || tvp_action->property.directory_no_version_control || tvp_action->property.file_no_version_control)) 
-  {
-    add_subaction (item, menu, "tvp::add", _("Add"), _("Add files, directories, or symbolic links"), "list-add", "--add");
-  }
+  add_subaction (item, menu, tvp_action->property.parent_version_control && (tvp_action->property.is_parent || tvp_action->property.directory_no_version_control || tvp_action->property.file_no_version_control),
+                 "tvp::add", _("Add"), _("Add files, directories, or symbolic links"), "list-add", "--add");
   /* Version control (file) */
-  if (tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::blame", _("Blame"), _("Show what revision and author last modified each line of a file"), "gtk-index", "--blame");
-  }
+  add_subaction (item, menu, tvp_action->property.file_version_control,
+                 "tvp::blame", _("Blame"), _("Show what revision and author last modified each line of a file"), "gtk-index", "--blame");
 /* No need
   subitem = gtk_menu_item_new_with_label (_("Cat"));
     g_signal_connect_after (subitem, "activate", G_CALLBACK (tvp_action_unimplemented), "Cat");
@@ -277,45 +421,29 @@ tvp_svn_action_create_menu_item (ThunarxMenuItem *item)
     /* unimplemented: add_subaction_u (menu, "tvp::changelist", _("Changelist"), _("Changelist"), "gtk-index", _("Changelist")); */
   }
   /* No version control (parent) */
-  if (tvp_action->property.is_parent && !tvp_action->property.parent_version_control)
-  {
-    add_subaction (item, menu, "tvp::checkout", _("Checkout"), _("Check out a working copy from a repository"), "gtk-connect", "--checkout");
-  }
+  add_subaction (item, menu, tvp_action->property.is_parent && !tvp_action->property.parent_version_control,
+                 "tvp::checkout", _("Checkout"), _("Check out a working copy from a repository"), "gtk-connect", "--checkout");
   /* Version control (parent) */
-  if (tvp_action->property.is_parent && tvp_action->property.parent_version_control)
-  {
-    add_subaction (item, menu, "tvp::cleanup", _("Cleanup"), _("Recursively clean up the working copy"), "edit-clear", "--cleanup");
-  }
+  add_subaction (item, menu, tvp_action->property.is_parent && tvp_action->property.parent_version_control,
+                 "tvp::cleanup", _("Cleanup"), _("Recursively clean up the working copy"), "edit-clear", "--cleanup");
   /* Version control (all) */
-  if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::commit", _("Commit"), _("Send changes from your working copy to the repository"), "gtk-apply", "--commit");
-  }
+  add_subaction (item, menu, (tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::commit", _("Commit"), _("Send changes from your working copy to the repository"), "gtk-apply", "--commit");
   /* Version control (no parent) */
-  if (!tvp_action->property.is_parent && tvp_action->property.parent_version_control && (tvp_action->property.directory_version_control || tvp_action->property.file_version_control))
-  {
-    add_subaction (item, menu, "tvp::copy", _("Copy"), _("Copy a file or directory in a working copy or in the repository"), "edit-copy", "--copy");
-  }
+  add_subaction (item, menu, !tvp_action->property.is_parent && tvp_action->property.parent_version_control && (tvp_action->property.directory_version_control || tvp_action->property.file_version_control),
+                 "tvp::copy", _("Copy"), _("Copy a file or directory in a working copy or in the repository"), "edit-copy", "--copy");
   /* Version control (no parent) */
-  if (!tvp_action->property.is_parent && tvp_action->property.parent_version_control && (tvp_action->property.directory_version_control || tvp_action->property.file_version_control))
-  {
-    add_subaction (item, menu, "tvp::delete", _("Delete"), _("Delete an item from a working copy or the repository"), "edit-delete", "--delete");
-  }
+  add_subaction (item, menu, !tvp_action->property.is_parent && tvp_action->property.parent_version_control && (tvp_action->property.directory_version_control || tvp_action->property.file_version_control),
+                 "tvp::delete", _("Delete"), _("Delete an item from a working copy or the repository"), "edit-delete", "--delete");
   /* Version control (all) */
-  if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::diff", _("Diff"), _("Display the differences between two revisions or paths"), "gtk-convert", "--diff");
-  }
+  add_subaction (item, menu, (tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::diff", _("Diff"), _("Display the differences between two revisions or paths"), "gtk-convert", "--diff");
   /* Version control and No version control (parent) */
-  if (tvp_action->property.is_parent || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::export", _("Export"), _("Export a clean directory tree"), "document-save", "--export");
-  }
+  add_subaction (item, menu, tvp_action->property.is_parent || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::export", _("Export"), _("Export a clean directory tree"), "document-save", "--export");
   /* No version control (all) */
-  if (!tvp_action->property.parent_version_control && (tvp_action->property.is_parent || tvp_action->property.directory_no_version_control || tvp_action->property.file_no_version_control))
-  {
-    add_subaction (item, menu, "tvp::import", _("Import"), _("Commit an unversioned file or tree into the repository"), "network-workgroup", "--import");
-  }
+  add_subaction (item, menu, !tvp_action->property.parent_version_control && (tvp_action->property.is_parent || tvp_action->property.directory_no_version_control || tvp_action->property.file_no_version_control),
+                 "tvp::import", _("Import"), _("Commit an unversioned file or tree into the repository"), "network-workgroup", "--import");
   /* Version control (all) */
   if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
   {
@@ -327,15 +455,11 @@ tvp_svn_action_create_menu_item (ThunarxMenuItem *item)
   gtk_menu_shell_append (menu, subitem);
   gtk_widget_show(subitem);
 *//* Version control (all) */
-  if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::lock", _("Lock"), _("Lock working copy paths in the repository so that no other user can commit changes to them"), "dialog-password", "--lock");
-  }
+  add_subaction (item, menu, (tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::lock", _("Lock"), _("Lock working copy paths in the repository so that no other user can commit changes to them"), "dialog-password", "--lock");
   /* Version control (all) */
-  if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::log", _("Log"), _("Show commit logs"), "gtk-index", "--log");
-  }
+  add_subaction (item, menu, (tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::log", _("Log"), _("Show commit logs"), "gtk-index", "--log");
 /* Ehmm ...
   subitem = gtk_menu_item_new_with_label (_("Merge"));
     g_signal_connect_after (subitem, "activate", G_CALLBACK (tvp_action_unimplemented), "Merge");
@@ -347,10 +471,8 @@ tvp_svn_action_create_menu_item (ThunarxMenuItem *item)
   gtk_menu_shell_append (menu, subitem);
   gtk_widget_show(subitem);
 *//* Version control (no parent) */
-  if (!tvp_action->property.is_parent && tvp_action->property.parent_version_control && (tvp_action->property.directory_version_control || tvp_action->property.file_version_control))
-  {
-    add_subaction (item, menu, "tvp::move", _("Move"), _("Move a file or directory"), "gtk-dnd-multiple", "--move");
-  }
+  add_subaction (item, menu, !tvp_action->property.is_parent && tvp_action->property.parent_version_control && (tvp_action->property.directory_version_control || tvp_action->property.file_version_control),
+                 "tvp::move", _("Move"), _("Move a file or directory"), "gtk-dnd-multiple", "--move");
 /* Merged
   subitem = gtk_menu_item_new_with_label (_("Delete Properties"));
   subitem = gtk_menu_item_new_with_label (_("Edit Properties"));
@@ -358,51 +480,36 @@ tvp_svn_action_create_menu_item (ThunarxMenuItem *item)
   subitem = gtk_menu_item_new_with_label (_("List Properties"));
   subitem = gtk_menu_item_new_with_label (_("Set Properties"));
 *//* Version control */
-  if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::properties", _("Edit Properties"), _("Edit the property of one or more items"), "gtk-edit", "--properties");
-  }
+  add_subaction (item, menu, (tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::properties", _("Edit Properties"), _("Edit the property of one or more items"), "gtk-edit", "--properties");
   /* Version control (parent) */
-  if (tvp_action->property.is_parent && tvp_action->property.parent_version_control)
-  {
-    add_subaction (item, menu, "tvp::relocate", _("Relocate"), _("Relocate the working copy to point to a different repository root URL"), "edit-find-replace", "--relocate");
-  }
+  add_subaction (item, menu, tvp_action->property.is_parent && tvp_action->property.parent_version_control,
+                 "tvp::relocate", _("Relocate"), _("Relocate the working copy to point to a different repository root URL"), "edit-find-replace", "--relocate");
 /* Changed
   subitem = gtk_menu_item_new_with_label (_("Mark Resolved"));
-*/if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::resolved", _("Resolved"), _("Remove \"conflicted\" state on working copy files or directories"), "gtk-yes", "--resolved");
-  }/*
-*//* Version control (file) */
+*//* Version control (all) */
+  add_subaction (item, menu, (tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::resolved", _("Resolved"), _("Remove \"conflicted\" state on working copy files or directories"), "gtk-yes", "--resolved");
+  /* Version control (file) */
   if (tvp_action->property.file_version_control)
   {
     /* unimplemented: add_subaction_u (menu, "tvp::resolve", _("Resolve"), _("Resolve"), "gtk-yes", _("Resolve")); */
   }
   /* Version control (all) */
-  if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::revert", _("Revert"), _("Undo all local edits"), "edit-undo", "--revert");
-  }
+  add_subaction (item, menu, (tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::revert", _("Revert"), _("Undo all local edits"), "edit-undo", "--revert");
   /* Version control (all) */
-  if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::status", _("Status"), _("Show the working tree status"), "dialog-information", "--status");
-  }
+  add_subaction (item, menu, (tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::status", _("Status"), _("Show the working tree status"), "dialog-information", "--status");
   /* Version control (parent) */
-  if (tvp_action->property.is_parent && tvp_action->property.parent_version_control)
-  {
-    add_subaction (item, menu, "tvp::switch", _("Switch"), _("Update working copy to a different URL"), "go-jump", "--switch");
-  }
+  add_subaction (item, menu, tvp_action->property.is_parent && tvp_action->property.parent_version_control,
+                 "tvp::switch", _("Switch"), _("Update working copy to a different URL"), "go-jump", "--switch");
   /* Version control (all) */
-  if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::unlock", _("Unlock"), _("Unlock working copy paths"), NULL, "--unlock");
-  }
+  add_subaction (item, menu, (tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::unlock", _("Unlock"), _("Unlock working copy paths"), NULL, "--unlock");
   /* Version control (all) */
-  if ((tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control)
-  {
-    add_subaction (item, menu, "tvp::update", _("Update"), _("Update your working copy"), "view-refresh", "--update");
-  }
+  add_subaction (item, menu, (tvp_action->property.is_parent && tvp_action->property.parent_version_control) || tvp_action->property.directory_version_control || tvp_action->property.file_version_control,
+                 "tvp::update", _("Update"), _("Update your working copy"), "view-refresh", "--update");
 }
 
 
@@ -423,6 +530,203 @@ tvp_setup_display_cb (gpointer data)
 
 
 
+/* the socket of tvp-svn-helper --daemon */
+#define TVP_SVN_HELPER_SOCKET "tvp-svn-helper.socket"
+
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H)
+/* the session environment passed to the daemon, must match the list in
+ * the helper, LC_* is passed as well */
+static const gchar *tvp_daemon_environment[] = {
+  "WAYLAND_DISPLAY",
+  "XAUTHORITY",
+  "SSH_AUTH_SOCK",
+  "DBUS_SESSION_BUS_ADDRESS",
+  "LANG",
+  "LANGUAGE",
+  NULL
+};
+#endif
+
+/* What is needed to start the helper, kept while the daemon is asked */
+typedef struct
+{
+  gchar     **argv;
+  gchar      *display_name;
+  gchar      *watch_path;
+  GdkScreen  *screen;
+  GString    *request;
+} TvpExec;
+
+
+
+static void
+tvp_exec_free (TvpExec *exec)
+{
+  g_strfreev (exec->argv);
+  g_free (exec->display_name);
+  g_free (exec->watch_path);
+  if (exec->screen)
+    g_object_unref (exec->screen);
+  if (exec->request)
+    g_string_free (exec->request, TRUE);
+  g_free (exec);
+}
+
+
+
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H)
+/* The working directory, the display, the session environment ended by
+ * an empty entry and the arguments, each ending in a NUL. Built on the
+ * main loop, as it reads the environment. */
+static GString *
+tvp_daemon_request (gchar **argv, const gchar *display_name)
+{
+  GString *request;
+  gchar **names, **name;
+  const gchar **iter;
+  const gchar *value;
+  gchar *cwd = g_get_current_dir ();
+
+  request = g_string_new (NULL);
+  g_string_append_len (request, cwd, strlen (cwd) + 1);
+  g_string_append_len (request, display_name ? display_name : "", display_name ? strlen (display_name) + 1 : 1);
+  for (iter = tvp_daemon_environment; *iter; iter++)
+  {
+    value = g_getenv (*iter);
+    if (value)
+    {
+      g_string_append_printf (request, "%s=%s", *iter, value);
+      g_string_append_c (request, '\0');
+    }
+  }
+  names = g_listenv ();
+  for (name = names; *name; name++)
+  {
+    if (strncmp (*name, "LC_", 3) == 0 && (*name)[3] && (value = g_getenv (*name)))
+    {
+      g_string_append_printf (request, "%s=%s", *name, value);
+      g_string_append_c (request, '\0');
+    }
+  }
+  g_strfreev (names);
+  g_string_append_c (request, '\0');
+  for (; *argv; argv++)
+    g_string_append_len (request, *argv, strlen (*argv) + 1);
+  g_free (cwd);
+
+  return request;
+}
+
+
+
+/* Hand the request to a running helper daemon, FALSE when there is none
+ * or it does not answer in time. Runs on a worker thread. */
+static gboolean
+tvp_daemon_send (GString *request)
+{
+  struct sockaddr_un addr;
+  struct timeval timeout = { 2, 0 };
+  gchar *path;
+  gchar reply;
+  gsize written = 0;
+  gssize n;
+  gboolean handled = FALSE;
+  int fd;
+
+  path = g_build_filename (g_get_user_runtime_dir (), TVP_SVN_HELPER_SOCKET, NULL);
+  if (strlen (path) >= sizeof (addr.sun_path))
+  {
+    g_free (path);
+    return FALSE;
+  }
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+  g_free (path);
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return FALSE;
+
+  setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+  setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+  if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) == 0)
+  {
+    while (written < request->len)
+    {
+      n = write (fd, request->str + written, request->len - written);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        break;
+      }
+      written += n;
+    }
+
+    if (written == request->len && shutdown (fd, SHUT_WR) == 0)
+      handled = read (fd, &reply, 1) == 1 && reply == 0;
+  }
+
+  close (fd);
+
+  return handled;
+}
+
+
+
+static void
+tvp_daemon_thread (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+  TvpExec *exec = task_data;
+
+  g_task_return_boolean (task, tvp_daemon_send (exec->request));
+}
+#endif
+
+
+
+static void
+tvp_action_spawn (TvpSvnAction *tvp_action, TvpExec *exec)
+{
+  GError *error = NULL;
+  gint pid = 0;
+
+  if (!g_spawn_async (NULL, exec->argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, tvp_setup_display_cb, exec->display_name, &pid, &error))
+  {
+    /* the window might be gone by the time the daemon did not answer */
+    GtkWidget *dialog = gtk_message_dialog_new (NULL, 0, GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE, "Could not spawn \'" TVP_SVN_HELPER "\'");
+    if (exec->screen)
+      gtk_window_set_screen (GTK_WINDOW (dialog), exec->screen);
+    gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (dialog), "%s.", error->message);
+    gtk_dialog_run (GTK_DIALOG (dialog));
+    gtk_widget_destroy (dialog);
+    g_error_free (error);
+  }
+  else
+  {
+    g_signal_emit(tvp_action, action_signal[SIGNAL_NEW_PROCESS], 0, &pid, exec->watch_path);
+  }
+}
+
+
+
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H)
+static void
+tvp_daemon_done (GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+  TvpExec *exec = g_task_get_task_data (G_TASK (result));
+
+  /* no daemon, or it is stuck */
+  if (!g_task_propagate_boolean (G_TASK (result), NULL))
+    tvp_action_spawn (TVP_SVN_ACTION (source_object), exec);
+}
+#endif
+
+
+
 static void tvp_action_exec (ThunarxMenuItem *item, TvpSvnAction *tvp_action)
 {
   guint size, i;
@@ -432,11 +736,12 @@ static void tvp_action_exec (ThunarxMenuItem *item, TvpSvnAction *tvp_action)
   gchar *filename;
   gchar *file;
   gchar *watch_path = NULL;
-  gint pid;
-  GError *error = NULL;
-  char *display_name = NULL;
+  TvpExec *exec;
   GdkScreen *screen = gtk_window_get_screen (GTK_WINDOW (tvp_action->window));
   GdkDisplay *display = gdk_screen_get_display (screen);
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H)
+  GTask *task;
+#endif
 
   iter = tvp_action->files;
 
@@ -502,26 +807,27 @@ static void tvp_action_exec (ThunarxMenuItem *item, TvpSvnAction *tvp_action)
     iter = g_list_next (iter);
   }
 
-  pid = 0;
+  exec = g_new0 (TvpExec, 1);
+  exec->argv = argv;
+  exec->watch_path = watch_path;
   if (screen != NULL)
-    display_name = g_strdup (gdk_display_get_name (display));
-
-  if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, tvp_setup_display_cb, display_name, &pid, &error))
-  {
-    GtkWidget *dialog = gtk_message_dialog_new (GTK_WINDOW (tvp_action->window), GTK_DIALOG_DESTROY_WITH_PARENT|GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE, "Could not spawn \'" TVP_SVN_HELPER "\'");
-    gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (dialog), "%s.", error->message);
-    gtk_dialog_run (GTK_DIALOG (dialog));
-    gtk_widget_destroy (dialog);
-    g_error_free (error);
-  }
-  else
   {
-    g_signal_emit(tvp_action, action_signal[SIGNAL_NEW_PROCESS], 0, &pid, watch_path);
+    exec->display_name = g_strdup (gdk_display_get_name (display));
+    exec->screen = g_object_ref (screen);
   }
 
-  g_free (display_name);
-  g_free (watch_path);
-  g_strfreev (argv);
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H)
+  /* a running daemon saves starting the helper and setting up svn, it is
+   * asked off the main loop so a busy one does not freeze the window */
+  exec->request = tvp_daemon_request (argv + 1, exec->display_name);
+  task = g_task_new (tvp_action, NULL, tvp_daemon_done, NULL);
+  g_task_set_task_data (task, exec, (GDestroyNotify) tvp_exec_free);
+  g_task_run_in_thread (task, tvp_daemon_thread);
+  g_object_unref (task);
+#else
+  tvp_action_spawn (tvp_action, exec);
+  tvp_exec_free (exec);
+#endif
 }
 
 
@@ -48,6 +48,21 @@ ThunarxMenuItem *tvp_svn_action_new     (const gchar*,
                                          gboolean,
                                          gboolean) G_GNUC_MALLOC G_GNUC_INTERNAL;
 
+ThunarxMenuItem *tvp_svn_action_new_pending (const gchar*,
+                                             const gchar*,
+                                             GList *,
+                                             GtkWidget *,
+                                             gboolean,
+                                             gboolean,
+                                             gboolean) G_GNUC_MALLOC G_GNUC_INTERNAL;
+
+void       tvp_svn_action_set_status    (TvpSvnAction *,
+                                         gboolean,
+                                         gboolean,
+                                         gboolean,
+                                         gboolean,
+                                         gboolean) G_GNUC_INTERNAL;
+
 G_END_DECLS;
 
 #endif /* !__TVP_SVN_ACTION_H__ */
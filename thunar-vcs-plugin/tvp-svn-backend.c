@@ -26,16 +26,51 @@
 #include <subversion-1/svn_fs.h>
 #include <subversion-1/svn_dso.h>
 
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
 #include <thunar-vcs-plugin/tvp-svn-backend.h>
 
 
+/* number of directories for which the status is kept */
+#define TVP_SVN_STATUS_CACHE_SIZE 32
+
+
+
+typedef struct
+{
+  gchar        *path;
+  gchar        *wc_db;
+  gint64        dir_mtime;
+  gint64        wc_db_mtime;
+  /* owned by the monitor's handler, which may run after the entry is gone */
+  gint         *valid;
+  GHashTable   *status;
+  GFileMonitor *monitor;
+} TvpSvnStatusCacheEntry;
+
+
 
 static apr_pool_t *pool = NULL;
 static svn_client_ctx_t *ctx = NULL;
 
+static GHashTable *status_cache = NULL;
+static GQueue      status_cache_lru = G_QUEUE_INIT;
 
-gboolean
-tvp_svn_backend_init (void)
+/* the menu provider queries the backend from worker threads */
+static GRecMutex   backend_lock;
+
+/* libsvn is set up on the first query of a working copy */
+static gboolean    setup_failed = FALSE;
+static gboolean    apr_initialized = FALSE;
+static gint64      load_time = 0;
+
+
+static void tvp_svn_status_cache_entry_free (TvpSvnStatusCacheEntry *entry);
+
+
+static gboolean
+tvp_svn_backend_setup (void)
 {
 	svn_error_t *err;
 
@@ -45,6 +80,7 @@ tvp_svn_backend_init (void)
     /* Initialize apr */
     if (apr_initialize())
         return FALSE;
+    apr_initialized = TRUE;
 
     /* Initialize the DSO library, this must be done before svn_pool_create */
 #if CHECK_SVN_VERSION(1,5)
@@ -108,6 +144,8 @@ tvp_svn_backend_init (void)
     return FALSE;
   }
 
+  status_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)tvp_svn_status_cache_entry_free);
+
 	/* We are ready now */
 
 	return TRUE;
@@ -115,15 +153,129 @@ tvp_svn_backend_init (void)
 
 
 
+/* Set up libsvn unless done already, the caller holds the backend lock */
+static gboolean
+tvp_svn_backend_ensure (void)
+{
+  gint64 start;
+
+  if (pool)
+    return TRUE;
+
+  /* don't pay for a failing setup on every query */
+  if (setup_failed)
+    return FALSE;
+
+  start = g_get_monotonic_time ();
+
+  if (!tvp_svn_backend_setup ())
+  {
+    g_warning ("Could not initialize libsvn");
+    setup_failed = TRUE;
+    /* a half done setup would otherwise count as done */
+    if (pool)
+      svn_pool_destroy (pool);
+    pool = NULL;
+    ctx = NULL;
+    if (apr_initialized)
+      apr_terminate ();
+    apr_initialized = FALSE;
+    return FALSE;
+  }
+
+  g_debug ("libsvn initialized in %.1f ms, %.1f s after the plugin was loaded",
+           (g_get_monotonic_time () - start) / 1000.0,
+           (start - load_time) / 1000000.0);
+
+  return TRUE;
+}
+
+
+
+/* Whether path might be inside a working copy, without asking libsvn */
+static gboolean
+tvp_svn_has_admin_dir (const gchar *path)
+{
+  gchar *dir, *parent, *admin;
+  gboolean found = FALSE;
+
+  dir = g_strdup (path);
+  for (;;)
+  {
+    admin = g_build_filename (dir, ".svn", NULL);
+    found = g_file_test (admin, G_FILE_TEST_IS_DIR);
+    g_free (admin);
+    if (found)
+      break;
+
+    parent = g_path_get_dirname (dir);
+    if (!strcmp (parent, dir))
+    {
+      g_free (parent);
+      break;
+    }
+    g_free (dir);
+    dir = parent;
+  }
+  g_free (dir);
+
+  return found;
+}
+
+
+
+/* Called when the plugin is loaded, libsvn itself is set up lazily as
+ * most folders browsed are no working copy */
+gboolean
+tvp_svn_backend_init (void)
+{
+  load_time = g_get_monotonic_time ();
+
+  return TRUE;
+}
+
+
+
 void
 tvp_svn_backend_free (void)
 {
+  g_rec_mutex_lock (&backend_lock);
 	if (pool)
     {
+    g_queue_clear (&status_cache_lru);
+    g_hash_table_destroy (status_cache);
+    status_cache = NULL;
     svn_pool_destroy (pool);
     apr_terminate ();
+    apr_initialized = FALSE;
     }
     pool = NULL;
+    setup_failed = FALSE;
+  g_rec_mutex_unlock (&backend_lock);
+}
+
+
+
+void
+tvp_svn_backend_lock (void)
+{
+  g_rec_mutex_lock (&backend_lock);
+}
+
+
+
+gboolean
+tvp_svn_backend_trylock (void)
+{
+  return g_rec_mutex_trylock (&backend_lock);
+}
+
+
+
+void
+tvp_svn_backend_unlock (void)
+{
+  g_rec_mutex_unlock (&backend_lock);
 }
 
 
@@ -153,6 +305,16 @@ tvp_svn_backend_is_working_copy (const gchar *uri)
     path[strlen (path) - 1] = '\0';
   }
 
+  g_rec_mutex_lock (&backend_lock);
+
+  /* outside of a working copy libsvn is not needed yet */
+  if ((!pool && !tvp_svn_has_admin_dir (path)) || !tvp_svn_backend_ensure ())
+  {
+    g_rec_mutex_unlock (&backend_lock);
+    g_free (path);
+    return FALSE;
+  }
+
   subpool = svn_pool_create (pool);
 
 #if CHECK_SVN_VERSION(1,5) || CHECK_SVN_VERSION(1,6)
@@ -168,6 +330,8 @@ tvp_svn_backend_is_working_copy (const gchar *uri)
 
   svn_pool_destroy (subpool);
 
+  g_rec_mutex_unlock (&backend_lock);
+
   g_free (path);
 
   /* if an error occured or wc_format in not set it is no working copy */
@@ -182,6 +346,15 @@ tvp_svn_backend_is_working_copy (const gchar *uri)
 
 
 
+static void
+tvp_svn_file_status_free (TvpSvnFileStatus *status)
+{
+  g_free (status->path);
+  g_free (status);
+}
+
+
+
 #if CHECK_SVN_VERSION(1,5)
 static void
 status_callback2 (void *baton, const char *path, svn_wc_status2_t *status)
@@ -193,7 +366,7 @@ static svn_error_t *
 status_callback (void *baton, const char *path, const svn_client_status_t *status, apr_pool_t *pool_)
 #endif
 {
-  GSList **list = baton;
+  GHashTable *table = baton;
   TvpSvnFileStatus *entry = g_new (TvpSvnFileStatus, 1);
 
   entry->path = g_strdup (path);
@@ -215,7 +388,50 @@ status_callback (void *baton, const char *path, const svn_client_status_t *statu
       break;
   }
 
-  *list = g_slist_prepend (*list, entry);
+  switch (status->text_status)
+  {
+    case svn_wc_status_normal:
+      entry->state = TVP_VCS_STATUS_NORMAL;
+      break;
+    case svn_wc_status_added:
+    case svn_wc_status_replaced:
+      entry->state = TVP_VCS_STATUS_ADDED;
+      break;
+    case svn_wc_status_missing:
+    case svn_wc_status_deleted:
+    case svn_wc_status_modified:
+    case svn_wc_status_merged:
+      entry->state = TVP_VCS_STATUS_MODIFIED;
+      break;
+    case svn_wc_status_conflicted:
+      entry->state = TVP_VCS_STATUS_CONFLICTED;
+      break;
+    case svn_wc_status_unversioned:
+      entry->state = TVP_VCS_STATUS_UNVERSIONED;
+      break;
+    case svn_wc_status_ignored:
+      entry->state = TVP_VCS_STATUS_IGNORED;
+      break;
+    default:
+      entry->state = TVP_VCS_STATUS_UNKNOWN;
+      break;
+  }
+
+  /* property changes count as well */
+  if (entry->state == TVP_VCS_STATUS_NORMAL)
+  {
+    if (status->prop_status == svn_wc_status_conflicted)
+      entry->state = TVP_VCS_STATUS_CONFLICTED;
+    else if (status->prop_status == svn_wc_status_modified)
+      entry->state = TVP_VCS_STATUS_MODIFIED;
+  }
+#if CHECK_SVN_VERSION_G(1,7)
+  /* tree conflicts */
+  if (status->conflicted)
+    entry->state = TVP_VCS_STATUS_CONFLICTED;
+#endif
+
+  g_hash_table_replace (table, entry->path, entry);
 #if CHECK_SVN_VERSION_G(1,6)
   return SVN_NO_ERROR;
 #endif
@@ -224,28 +440,16 @@ status_callback (void *baton, const char *path, const svn_client_status_t *statu
 
 
 
-GSList *
-tvp_svn_backend_get_status (const gchar *uri)
+static GHashTable *
+tvp_svn_backend_query_status (const gchar *path)
 {
   apr_pool_t *subpool;
   svn_error_t *err;
   svn_opt_revision_t revision = {svn_opt_revision_working};
-  GSList *list = NULL;
-  gchar *path;
+  GHashTable *table;
 
-  /* strip the "file://" part of the uri */
-  if (strncmp (uri, "file://", 7) == 0)
-  {
-    uri += 7;
-  }
-
-  path = g_strdup (uri);
-
-  /* remove trailing '/' cause svn_client_status2 can't handle that */
-  if (strlen (path) > 1 && path[strlen (path) - 1] == '/')
-  {
-    path[strlen (path) - 1] = '\0';
-  }
+  /* the entries are keyed by their own path */
+  table = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)tvp_svn_file_status_free);
 
   subpool = svn_pool_create (pool);
 
@@ -253,38 +457,282 @@ tvp_svn_backend_get_status (const gchar *uri)
 #if CHECK_SVN_VERSION_G(1,9)
   err = svn_client_status6 (NULL, ctx, path, &revision, svn_depth_immediates,
                             TRUE, FALSE, TRUE, TRUE, TRUE, TRUE, NULL,
-                            status_callback, &list, subpool);
+                            status_callback, table, subpool);
 #elif CHECK_SVN_VERSION_G(1,7)
   err = svn_client_status5 (NULL, ctx, path, &revision, svn_depth_immediates,
                             TRUE, FALSE, TRUE, TRUE, TRUE, NULL,
-                            status_callback, &list, subpool);
+                            status_callback, table, subpool);
 #elif CHECK_SVN_VERSION_G(1,6)
-  err = svn_client_status4 (NULL, path, &revision, status_callback3, &list,
+  err = svn_client_status4 (NULL, path, &revision, status_callback3, table,
                             svn_depth_immediates, TRUE, FALSE, TRUE, TRUE, NULL,
                             ctx, subpool);
 #else
-  err = svn_client_status3 (NULL, path, &revision, status_callback2
-                            &list, svn_depth_immediates, TRUE, FALSE, TRUE,
+  err = svn_client_status3 (NULL, path, &revision, status_callback2,
+                            table, svn_depth_immediates, TRUE, FALSE, TRUE,
                             TRUE, NULL, ctx, subpool);
 #endif
 
   svn_pool_destroy (subpool);
 
-  g_free (path);
-
   if (err)
   {
-    GSList *iter;
-    for (iter = list; iter; iter = iter->next)
+    g_hash_table_destroy (table);
+    svn_error_clear (err);
+    return NULL;
+  }
+
+  return table;
+}
+
+
+
+/* Returns the mtime in nanoseconds, several changes within a second are
+ * common. Where stat has no nanoseconds only the seconds count. */
+static gint64
+tvp_svn_get_mtime (const gchar *path)
+{
+  GStatBuf st;
+
+  if (g_stat (path, &st) != 0)
+    return 0;
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  return (gint64) st.st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000) + st.st_mtim.tv_nsec;
+#else
+  return (gint64) st.st_mtime * G_GINT64_CONSTANT (1000000000);
+#endif
+}
+
+
+
+static gchar *
+tvp_svn_find_wc_db (const gchar *path)
+{
+  gchar *dir, *parent, *wc_db;
+
+  /* since 1.7 the administrative data of the whole working copy lives in
+   * the wc.db at the root, search for it upwards */
+  dir = g_strdup (path);
+  for (;;)
+  {
+    wc_db = g_build_filename (dir, ".svn", "wc.db", NULL);
+    if (g_file_test (wc_db, G_FILE_TEST_IS_REGULAR))
     {
-      g_free (iter->data);
+      g_free (dir);
+      return wc_db;
     }
-    g_slist_free (list);
-    svn_error_clear (err);
+    g_free (wc_db);
+
+    parent = g_path_get_dirname (dir);
+    if (!strcmp (parent, dir))
+    {
+      g_free (parent);
+      break;
+    }
+    g_free (dir);
+    dir = parent;
+  }
+  g_free (dir);
+
+  /* older working copies keep their administrative data per directory */
+  return g_build_filename (path, ".svn", "entries", NULL);
+}
+
+
+
+static void
+tvp_svn_status_cache_changed (GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event, gint *valid)
+{
+  /* only the mode or times changed, which does not alter the status */
+  if (event == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+    return;
+
+  /* emitted on the main loop, the backend might be in use by a worker,
+   * which may even have dropped the entry */
+  g_atomic_int_set (valid, FALSE);
+}
+
+
+
+static void
+tvp_svn_status_cache_entry_free (TvpSvnStatusCacheEntry *entry)
+{
+  if (entry->monitor)
+  {
+    /* frees the flag once a running emission is done with it */
+    g_signal_handlers_disconnect_by_func (entry->monitor, tvp_svn_status_cache_changed, entry->valid);
+    g_file_monitor_cancel (entry->monitor);
+    g_object_unref (entry->monitor);
+  }
+  else
+    g_free (entry->valid);
+  if (entry->status)
+    g_hash_table_destroy (entry->status);
+  g_free (entry->wc_db);
+  g_free (entry->path);
+  g_free (entry);
+}
+
+
+
+static TvpSvnStatusCacheEntry *
+tvp_svn_status_cache_lookup (const gchar *path)
+{
+  TvpSvnStatusCacheEntry *entry;
+  GFile *file;
+
+  entry = g_hash_table_lookup (status_cache, path);
+  if (entry)
+  {
+    /* move it to the front of the lru list */
+    g_queue_remove (&status_cache_lru, entry);
+    g_queue_push_head (&status_cache_lru, entry);
+    return entry;
+  }
+
+  entry = g_new0 (TvpSvnStatusCacheEntry, 1);
+  entry->path = g_strdup (path);
+  entry->valid = g_new0 (gint, 1);
+
+  /* file modifications do not change the directory mtime, so watch it */
+  file = g_file_new_for_path (path);
+  entry->monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, NULL);
+  if (entry->monitor)
+    g_signal_connect_data (entry->monitor, "changed", G_CALLBACK (tvp_svn_status_cache_changed),
+                           entry->valid, (GClosureNotify) g_free, 0);
+  g_object_unref (file);
+
+  g_hash_table_insert (status_cache, entry->path, entry);
+  g_queue_push_head (&status_cache_lru, entry);
+
+  /* drop the least recently used directory */
+  if (g_queue_get_length (&status_cache_lru) > TVP_SVN_STATUS_CACHE_SIZE)
+  {
+    TvpSvnStatusCacheEntry *last = g_queue_pop_tail (&status_cache_lru);
+    g_hash_table_remove (status_cache, last->path);
+  }
+
+  return entry;
+}
+
+
+
+static gboolean
+tvp_svn_status_cache_entry_is_current (TvpSvnStatusCacheEntry *entry)
+{
+  /* without a monitor file modifications would go unnoticed */
+  if (!g_atomic_int_get (entry->valid) || !entry->monitor || !entry->wc_db)
+    return FALSE;
+
+  /* adding or removing files touches the directory, svn operations
+   * touch the wc.db */
+  return entry->dir_mtime == tvp_svn_get_mtime (entry->path) &&
+         entry->wc_db_mtime == tvp_svn_get_mtime (entry->wc_db);
+}
+
+
+
+static gchar *
+tvp_svn_normalize_path (const gchar *uri)
+{
+  gchar *path;
+
+  /* strip the "file://" part of the uri */
+  if (strncmp (uri, "file://", 7) == 0)
+  {
+    uri += 7;
+  }
+
+  path = g_strdup (uri);
+
+  /* remove trailing '/' cause svn_client_status2 can't handle that */
+  if (strlen (path) > 1 && path[strlen (path) - 1] == '/')
+  {
+    path[strlen (path) - 1] = '\0';
+  }
+
+  return path;
+}
+
+
+
+/* Returns a table of TvpSvnFileStatus keyed by the absolute path without
+ * trailing '/', or NULL when the folder is no working copy. The table is
+ * owned by the status cache and must not be freed, it stays valid while
+ * the caller holds the backend lock. */
+GHashTable *
+tvp_svn_backend_get_status (const gchar *uri)
+{
+  TvpSvnStatusCacheEntry *entry;
+  GHashTable *status;
+  gchar *path;
+
+  path = tvp_svn_normalize_path (uri);
+
+  g_rec_mutex_lock (&backend_lock);
+
+  /* outside of a working copy libsvn is not needed yet */
+  if ((!pool && !tvp_svn_has_admin_dir (path)) || !tvp_svn_backend_ensure ())
+  {
+    g_rec_mutex_unlock (&backend_lock);
+    g_free (path);
     return NULL;
   }
 
-  return list;
+  entry = tvp_svn_status_cache_lookup (path);
+
+  if (!tvp_svn_status_cache_entry_is_current (entry))
+  {
+    /* the directory might have become (part of) a working copy */
+    g_free (entry->wc_db);
+    entry->wc_db = tvp_svn_find_wc_db (entry->path);
+
+    /* reset before the query, so changes during it are not lost */
+    g_atomic_int_set (entry->valid, TRUE);
+    entry->dir_mtime = tvp_svn_get_mtime (entry->path);
+    entry->wc_db_mtime = tvp_svn_get_mtime (entry->wc_db);
+
+    if (entry->status)
+      g_hash_table_destroy (entry->status);
+    entry->status = tvp_svn_backend_query_status (entry->path);
+  }
+
+  status = entry->status;
+
+  g_rec_mutex_unlock (&backend_lock);
+
+  g_free (path);
+
+  return status;
+}
+
+
+
+/* Like tvp_svn_backend_get_status, but never queries the working copy.
+ * Returns FALSE when the cached status is missing or outdated. */
+gboolean
+tvp_svn_backend_get_cached_status (const gchar *uri, GHashTable **status)
+{
+  TvpSvnStatusCacheEntry *entry;
+  gboolean result = FALSE;
+  gchar *path;
+
+  path = tvp_svn_normalize_path (uri);
+
+  g_rec_mutex_lock (&backend_lock);
+
+  entry = status_cache ? g_hash_table_lookup (status_cache, path) : NULL;
+  if (entry && tvp_svn_status_cache_entry_is_current (entry))
+  {
+    *status = entry->status;
+    result = TRUE;
+  }
+
+  g_rec_mutex_unlock (&backend_lock);
+
+  g_free (path);
+
+  return result;
 }
 
 
@@ -355,6 +803,15 @@ tvp_svn_backend_get_info (const gchar *uri)
     path[strlen (path) - 1] = '\0';
   }
 
+  g_rec_mutex_lock (&backend_lock);
+
+  if ((!pool && !tvp_svn_has_admin_dir (path)) || !tvp_svn_backend_ensure ())
+  {
+    g_rec_mutex_unlock (&backend_lock);
+    g_free (path);
+    return NULL;
+  }
+
   subpool = svn_pool_create (pool);
 
   /* get svn info for this file or directory */
@@ -371,6 +828,8 @@ tvp_svn_backend_get_info (const gchar *uri)
 
   svn_pool_destroy (subpool);
 
+  g_rec_mutex_unlock (&backend_lock);
+
   g_free (path);
 
   if (err)
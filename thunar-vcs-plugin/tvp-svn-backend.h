@@ -23,11 +23,14 @@
 
 #include <subversion-1/svn_version.h>
 
+#include <thunar-vcs-plugin/tvp-vcs-status.h>
+
 G_BEGIN_DECLS;
 
 typedef struct
 {
 	gchar *path;
+	TvpVcsStatus state;
 	struct {
 		unsigned version_control : 1;
 	} flag;
@@ -54,9 +57,15 @@ typedef struct
 gboolean tvp_svn_backend_init(void);
 void     tvp_svn_backend_free(void);
 
+void     tvp_svn_backend_lock (void);
+gboolean tvp_svn_backend_trylock (void);
+void     tvp_svn_backend_unlock (void);
+
 gboolean tvp_svn_backend_is_working_copy (const gchar *uri);
 
-GSList  *tvp_svn_backend_get_status (const gchar *uri);
+GHashTable *tvp_svn_backend_get_status (const gchar *uri);
+
+gboolean tvp_svn_backend_get_cached_status (const gchar *uri, GHashTable **status);
 
 TvpSvnInfo *tvp_svn_backend_get_info (const gchar *uri);
 
@@ -0,0 +1,40 @@
+/*-
+ * Copyright (C) 2007-2011  Peter de Ridder <peter@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __TVP_VCS_STATUS_H__
+#define __TVP_VCS_STATUS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS;
+
+/* the status of a file, as far as it is shown in the file manager */
+typedef enum
+{
+  TVP_VCS_STATUS_UNKNOWN = 0,
+  TVP_VCS_STATUS_NORMAL,
+  TVP_VCS_STATUS_ADDED,
+  TVP_VCS_STATUS_MODIFIED,
+  TVP_VCS_STATUS_CONFLICTED,
+  TVP_VCS_STATUS_UNVERSIONED,
+  TVP_VCS_STATUS_IGNORED
+} TvpVcsStatus;
+
+G_END_DECLS;
+
+#endif /* !__TVP_VCS_STATUS_H__ */
@@ -0,0 +1,528 @@
+/*-
+ * Copyright (C) 2007-2011  Peter de Ridder <peter@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <gtk/gtk.h>
+
+#include "tvp-list-model.h"
+
+/* the strings are copied into blocks of this size */
+#define TVP_LIST_MODEL_BLOCK_SIZE 65536
+
+typedef struct
+{
+  GType type;
+  /* one value per row */
+  GArray *values;
+  /* the strings already stored for a column with repeating values */
+  GHashTable *shared;
+} TvpListColumn;
+
+struct _TvpListModel
+{
+  GObject object;
+
+  gint stamp;
+  gint n_columns;
+  TvpListColumn *columns;
+  guint length;
+
+  GSList *blocks;
+  gchar *block_pos;
+  gsize block_left;
+};
+
+struct _TvpListModelClass
+{
+  GObjectClass object_class;
+};
+
+static void tvp_list_model_tree_model_init (GtkTreeModelIface*);
+static void tvp_list_model_finalize (GObject*);
+
+G_DEFINE_TYPE_WITH_CODE (TvpListModel, tvp_list_model, G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL, tvp_list_model_tree_model_init))
+
+static void
+tvp_list_model_class_init (TvpListModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = tvp_list_model_finalize;
+}
+
+static void
+tvp_list_model_init (TvpListModel *model)
+{
+  model->stamp = g_random_int ();
+}
+
+static gsize
+column_element_size (GType type)
+{
+  switch (G_TYPE_FUNDAMENTAL (type))
+  {
+    case G_TYPE_STRING:
+      return sizeof (const gchar *);
+    case G_TYPE_POINTER:
+      return sizeof (gpointer);
+    case G_TYPE_BOOLEAN:
+      return sizeof (gboolean);
+    case G_TYPE_INT:
+      return sizeof (gint);
+    case G_TYPE_UINT:
+      return sizeof (guint);
+    case G_TYPE_LONG:
+      return sizeof (glong);
+    case G_TYPE_INT64:
+      return sizeof (gint64);
+  }
+  return 0;
+}
+
+TvpListModel*
+tvp_list_model_new (gint n_columns, ...)
+{
+  TvpListModel *model;
+  va_list args;
+  GType type;
+  gint i;
+
+  g_return_val_if_fail (n_columns > 0, NULL);
+
+  model = g_object_new (TVP_TYPE_LIST_MODEL, NULL);
+  model->n_columns = n_columns;
+  model->columns = g_new0 (TvpListColumn, n_columns);
+
+  va_start (args, n_columns);
+  for (i = 0; i < n_columns; i++)
+  {
+    type = va_arg (args, GType);
+    if (!column_element_size (type))
+    {
+      g_warning ("%s: unsupported column type %s", G_STRLOC, g_type_name (type));
+      type = G_TYPE_POINTER;
+    }
+    model->columns[i].type = type;
+    model->columns[i].values = g_array_new (FALSE, TRUE, column_element_size (type));
+  }
+  va_end (args);
+
+  return model;
+}
+
+static void
+tvp_list_model_finalize (GObject *object)
+{
+  TvpListModel *model = TVP_LIST_MODEL (object);
+  gint i;
+
+  for (i = 0; i < model->n_columns; i++)
+  {
+    g_array_free (model->columns[i].values, TRUE);
+    if (model->columns[i].shared)
+      g_hash_table_destroy (model->columns[i].shared);
+  }
+  g_free (model->columns);
+
+  g_slist_free_full (model->blocks, g_free);
+
+  G_OBJECT_CLASS (tvp_list_model_parent_class)->finalize (object);
+}
+
+void
+tvp_list_model_set_column_shared (TvpListModel *model, gint column)
+{
+  g_return_if_fail (TVP_IS_LIST_MODEL (model));
+  g_return_if_fail (column >= 0 && column < model->n_columns);
+  g_return_if_fail (G_TYPE_FUNDAMENTAL (model->columns[column].type) == G_TYPE_STRING);
+
+  if (!model->columns[column].shared)
+    model->columns[column].shared = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+/* Copies str into the blocks of model. The blocks are only freed by clear,
+ * so a replaced string of a column that is not shared has its space reused
+ * when the new string fits, which keeps refilling rows from growing. */
+static const gchar*
+list_model_store_string (TvpListModel *model, TvpListColumn *column, const gchar *old, const gchar *str)
+{
+  gchar *copy;
+  gsize len;
+
+  if (!str)
+    return NULL;
+
+  if (column->shared)
+  {
+    copy = g_hash_table_lookup (column->shared, str);
+    if (copy)
+      return copy;
+  }
+
+  len = strlen (str) + 1;
+
+  if (old && !column->shared && len <= strlen (old) + 1)
+  {
+    memmove ((gchar *) old, str, len);
+    return old;
+  }
+
+  if (G_UNLIKELY (len > TVP_LIST_MODEL_BLOCK_SIZE / 4))
+  {
+    /* large strings get a block of their own */
+    copy = g_malloc (len);
+    model->blocks = g_slist_prepend (model->blocks, copy);
+  }
+  else
+  {
+    if (len > model->block_left)
+    {
+      model->block_pos = g_malloc (TVP_LIST_MODEL_BLOCK_SIZE);
+      model->block_left = TVP_LIST_MODEL_BLOCK_SIZE;
+      model->blocks = g_slist_prepend (model->blocks, model->block_pos);
+    }
+    copy = model->block_pos;
+    model->block_pos += len;
+    model->block_left -= len;
+  }
+
+  memcpy (copy, str, len);
+
+  if (column->shared)
+    g_hash_table_insert (column->shared, copy, copy);
+
+  return copy;
+}
+
+static void
+list_model_set_valist (TvpListModel *model, guint row, va_list args)
+{
+  TvpListColumn *column;
+  gint index;
+
+  while ((index = va_arg (args, gint)) != -1)
+  {
+    if (G_UNLIKELY (index < 0 || index >= model->n_columns))
+    {
+      g_warning ("%s: invalid column number %d", G_STRLOC, index);
+      break;
+    }
+
+    column = &model->columns[index];
+
+    switch (G_TYPE_FUNDAMENTAL (column->type))
+    {
+      case G_TYPE_STRING:
+        g_array_index (column->values, const gchar *, row) = list_model_store_string (model, column,
+            g_array_index (column->values, const gchar *, row), va_arg (args, const gchar *));
+        break;
+      case G_TYPE_POINTER:
+        g_array_index (column->values, gpointer, row) = va_arg (args, gpointer);
+        break;
+      case G_TYPE_BOOLEAN:
+        g_array_index (column->values, gboolean, row) = va_arg (args, gboolean);
+        break;
+      case G_TYPE_INT:
+        g_array_index (column->values, gint, row) = va_arg (args, gint);
+        break;
+      case G_TYPE_UINT:
+        g_array_index (column->values, guint, row) = va_arg (args, guint);
+        break;
+      case G_TYPE_LONG:
+        g_array_index (column->values, glong, row) = va_arg (args, glong);
+        break;
+      case G_TYPE_INT64:
+        g_array_index (column->values, gint64, row) = va_arg (args, gint64);
+        break;
+    }
+  }
+}
+
+guint
+tvp_list_model_append (TvpListModel *model, ...)
+{
+  GtkTreePath *path;
+  GtkTreeIter iter;
+  va_list args;
+  guint row;
+  gint i;
+
+  g_return_val_if_fail (TVP_IS_LIST_MODEL (model), 0);
+
+  row = model->length++;
+  for (i = 0; i < model->n_columns; i++)
+    g_array_set_size (model->columns[i].values, model->length);
+
+  va_start (args, model);
+  list_model_set_valist (model, row, args);
+  va_end (args);
+
+  iter.stamp = model->stamp;
+  iter.user_data = GUINT_TO_POINTER (row);
+
+  path = gtk_tree_path_new_from_indices (row, -1);
+  gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+  gtk_tree_path_free (path);
+
+  return row;
+}
+
+void
+tvp_list_model_set (TvpListModel *model, guint row, ...)
+{
+  GtkTreePath *path;
+  GtkTreeIter iter;
+  va_list args;
+
+  g_return_if_fail (TVP_IS_LIST_MODEL (model));
+  g_return_if_fail (row < model->length);
+
+  va_start (args, row);
+  list_model_set_valist (model, row, args);
+  va_end (args);
+
+  iter.stamp = model->stamp;
+  iter.user_data = GUINT_TO_POINTER (row);
+
+  path = gtk_tree_path_new_from_indices (row, -1);
+  gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+  gtk_tree_path_free (path);
+}
+
+guint
+tvp_list_model_get_length (TvpListModel *model)
+{
+  g_return_val_if_fail (TVP_IS_LIST_MODEL (model), 0);
+
+  return model->length;
+}
+
+void
+tvp_list_model_clear (TvpListModel *model)
+{
+  GtkTreePath *path;
+  gint i;
+
+  g_return_if_fail (TVP_IS_LIST_MODEL (model));
+
+  /* the rows are removed from the end, so the other paths stay valid */
+  while (model->length)
+  {
+    model->length--;
+    path = gtk_tree_path_new_from_indices (model->length, -1);
+    gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+    gtk_tree_path_free (path);
+  }
+
+  for (i = 0; i < model->n_columns; i++)
+  {
+    g_array_set_size (model->columns[i].values, 0);
+    if (model->columns[i].shared)
+      g_hash_table_remove_all (model->columns[i].shared);
+  }
+
+  g_slist_free_full (model->blocks, g_free);
+  model->blocks = NULL;
+  model->block_pos = NULL;
+  model->block_left = 0;
+
+  model->stamp++;
+}
+
+static GtkTreeModelFlags
+tvp_list_model_get_flags (GtkTreeModel *tree_model)
+{
+  return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+tvp_list_model_get_n_columns (GtkTreeModel *tree_model)
+{
+  return TVP_LIST_MODEL (tree_model)->n_columns;
+}
+
+static GType
+tvp_list_model_get_column_type (GtkTreeModel *tree_model, gint index)
+{
+  TvpListModel *model = TVP_LIST_MODEL (tree_model);
+
+  g_return_val_if_fail (index >= 0 && index < model->n_columns, G_TYPE_INVALID);
+
+  return model->columns[index].type;
+}
+
+static gboolean
+list_model_iter_nth (TvpListModel *model, GtkTreeIter *iter, gint n)
+{
+  if (n < 0 || (guint) n >= model->length)
+  {
+    iter->stamp = 0;
+    return FALSE;
+  }
+
+  iter->stamp = model->stamp;
+  iter->user_data = GINT_TO_POINTER (n);
+
+  return TRUE;
+}
+
+static gboolean
+tvp_list_model_get_iter (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path)
+{
+  if (gtk_tree_path_get_depth (path) != 1)
+  {
+    iter->stamp = 0;
+    return FALSE;
+  }
+
+  return list_model_iter_nth (TVP_LIST_MODEL (tree_model), iter, gtk_tree_path_get_indices (path)[0]);
+}
+
+static GtkTreePath*
+tvp_list_model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  g_return_val_if_fail (iter->stamp == TVP_LIST_MODEL (tree_model)->stamp, NULL);
+
+  return gtk_tree_path_new_from_indices (GPOINTER_TO_INT (iter->user_data), -1);
+}
+
+static void
+tvp_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, gint index, GValue *value)
+{
+  TvpListModel *model = TVP_LIST_MODEL (tree_model);
+  TvpListColumn *column;
+  guint row;
+
+  g_return_if_fail (index >= 0 && index < model->n_columns);
+  g_return_if_fail (iter->stamp == model->stamp);
+
+  column = &model->columns[index];
+  row = GPOINTER_TO_UINT (iter->user_data);
+
+  g_value_init (value, column->type);
+
+  /* the strings are handed out without a copy, they live until the row is set or cleared */
+  switch (G_TYPE_FUNDAMENTAL (column->type))
+  {
+    case G_TYPE_STRING:
+      g_value_set_static_string (value, g_array_index (column->values, const gchar *, row));
+      break;
+    case G_TYPE_POINTER:
+      g_value_set_pointer (value, g_array_index (column->values, gpointer, row));
+      break;
+    case G_TYPE_BOOLEAN:
+      g_value_set_boolean (value, g_array_index (column->values, gboolean, row));
+      break;
+    case G_TYPE_INT:
+      g_value_set_int (value, g_array_index (column->values, gint, row));
+      break;
+    case G_TYPE_UINT:
+      g_value_set_uint (value, g_array_index (column->values, guint, row));
+      break;
+    case G_TYPE_LONG:
+      g_value_set_long (value, g_array_index (column->values, glong, row));
+      break;
+    case G_TYPE_INT64:
+      g_value_set_int64 (value, g_array_index (column->values, gint64, row));
+      break;
+  }
+}
+
+static gboolean
+tvp_list_model_iter_next (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  return list_model_iter_nth (TVP_LIST_MODEL (tree_model), iter, GPOINTER_TO_INT (iter->user_data) + 1);
+}
+
+static gboolean
+tvp_list_model_iter_previous (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  return list_model_iter_nth (TVP_LIST_MODEL (tree_model), iter, GPOINTER_TO_INT (iter->user_data) - 1);
+}
+
+static gboolean
+tvp_list_model_iter_children (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+  if (parent)
+  {
+    iter->stamp = 0;
+    return FALSE;
+  }
+
+  return list_model_iter_nth (TVP_LIST_MODEL (tree_model), iter, 0);
+}
+
+static gboolean
+tvp_list_model_iter_has_child (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  return FALSE;
+}
+
+static gint
+tvp_list_model_iter_n_children (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  if (iter)
+    return 0;
+
+  return TVP_LIST_MODEL (tree_model)->length;
+}
+
+static gboolean
+tvp_list_model_iter_nth_child (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+  if (parent)
+  {
+    iter->stamp = 0;
+    return FALSE;
+  }
+
+  return list_model_iter_nth (TVP_LIST_MODEL (tree_model), iter, n);
+}
+
+static gboolean
+tvp_list_model_iter_parent (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+  iter->stamp = 0;
+  return FALSE;
+}
+
+static void
+tvp_list_model_tree_model_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags = tvp_list_model_get_flags;
+  iface->get_n_columns = tvp_list_model_get_n_columns;
+  iface->get_column_type = tvp_list_model_get_column_type;
+  iface->get_iter = tvp_list_model_get_iter;
+  iface->get_path = tvp_list_model_get_path;
+  iface->get_value = tvp_list_model_get_value;
+  iface->iter_next = tvp_list_model_iter_next;
+  iface->iter_previous = tvp_list_model_iter_previous;
+  iface->iter_children = tvp_list_model_iter_children;
+  iface->iter_has_child = tvp_list_model_iter_has_child;
+  iface->iter_n_children = tvp_list_model_iter_n_children;
+  iface->iter_nth_child = tvp_list_model_iter_nth_child;
+  iface->iter_parent = tvp_list_model_iter_parent;
+}
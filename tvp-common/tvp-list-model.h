@@ -0,0 +1,55 @@
+/*-
+ * Copyright (C) 2007-2011  Peter de Ridder <peter@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __TVP_LIST_MODEL_H__
+#define __TVP_LIST_MODEL_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _TvpListModelClass TvpListModelClass;
+typedef struct _TvpListModel      TvpListModel;
+
+#define TVP_TYPE_LIST_MODEL             (tvp_list_model_get_type ())
+#define TVP_LIST_MODEL(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), TVP_TYPE_LIST_MODEL, TvpListModel))
+#define TVP_LIST_MODEL_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), TVP_TYPE_LIST_MODEL, TvpListModelClass))
+#define TVP_IS_LIST_MODEL(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), TVP_TYPE_LIST_MODEL))
+#define TVP_IS_LIST_MODEL_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), TVP_TYPE_LIST_MODEL))
+#define TVP_LIST_MODEL_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), TVP_TYPE_LIST_MODEL, TvpListModelClass))
+
+GType         tvp_list_model_get_type          (void) G_GNUC_CONST G_GNUC_INTERNAL;
+
+TvpListModel* tvp_list_model_new               (gint n_columns,
+                                                ...) G_GNUC_MALLOC G_GNUC_INTERNAL;
+
+void          tvp_list_model_set_column_shared (TvpListModel *model,
+                                                gint column);
+
+guint         tvp_list_model_append            (TvpListModel *model,
+                                                ...);
+/* the strings are copied, a shared column stores each distinct one once */
+void          tvp_list_model_set               (TvpListModel *model,
+                                                guint row,
+                                                ...);
+guint         tvp_list_model_get_length        (TvpListModel *model);
+void          tvp_list_model_clear             (TvpListModel *model);
+
+G_END_DECLS;
+
+#endif /* !__TVP_LIST_MODEL_H__ */
@@ -23,16 +23,23 @@
 #include <exo/exo.h>
 #include <libxfce4util/libxfce4util.h>
 
+#include <tvp-common/tvp-list-model.h>
+
 #include "tgh-common.h"
 #include "tgh-blame-dialog.h"
 
 static void cancel_clicked (GtkButton*, gpointer);
+static void revision_data_func (GtkTreeViewColumn*, GtkCellRenderer*, GtkTreeModel*, GtkTreeIter*, gpointer);
+
+/* the length of the abbreviated revisions */
+#define TGH_BLAME_REVISION_LENGTH 8
 
 struct _TghBlameDialog
 {
   GtkDialog dialog;
 
   GtkWidget *tree_view;
+  TvpListModel *model;
   GtkWidget *close;
   GtkWidget *cancel;
 };
@@ -78,7 +85,6 @@ tgh_blame_dialog_init (TghBlameDialog *dialog)
   GtkWidget *scroll_window;
   GtkWidget *button;
   GtkCellRenderer *renderer;
-  GtkTreeModel *model;
 
   scroll_window = gtk_scrolled_window_new (NULL, NULL);
   gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scroll_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
@@ -92,10 +98,10 @@ tgh_blame_dialog_init (TghBlameDialog *dialog)
       NULL);
 
   renderer = gtk_cell_renderer_text_new ();
-  gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (tree_view),
+  gtk_tree_view_insert_column_with_data_func (GTK_TREE_VIEW (tree_view),
       -1, _("Revision"), renderer,
-      "text", COLUMN_REVISION,
-      NULL);
+      revision_data_func,
+      NULL, NULL);
 
   renderer = gtk_cell_renderer_text_new ();
   gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (tree_view),
@@ -115,11 +121,14 @@ tgh_blame_dialog_init (TghBlameDialog *dialog)
       "text", COLUMN_LINE,
       NULL);
 
-  model = GTK_TREE_MODEL (gtk_list_store_new (COLUMN_COUNT, G_TYPE_INT64, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING));
+  /* the rows only refer to the model, which keeps the strings once per commit */
+  dialog->model = tvp_list_model_new (COLUMN_COUNT, G_TYPE_INT64, G_TYPE_UINT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+  tvp_list_model_set_column_shared (dialog->model, COLUMN_AUTHOR);
+  tvp_list_model_set_column_shared (dialog->model, COLUMN_DATE);
 
-  gtk_tree_view_set_model (GTK_TREE_VIEW (tree_view), model);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (tree_view), GTK_TREE_MODEL (dialog->model));
 
-  g_object_unref (model);
+  g_object_unref (dialog->model);
 
   gtk_container_add (GTK_CONTAINER (scroll_window), tree_view);
   gtk_box_pack_start (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), scroll_window, TRUE, TRUE, 0);
@@ -160,23 +169,58 @@ tgh_blame_dialog_new (const gchar *title, GtkWindow *parent, GtkDialogFlags flag
 }
 
 void
-tgh_blame_dialog_add (TghBlameDialog *dialog, gint64 line_no, const gchar *revision, const gchar *author, const gchar *date, const gchar *line)
+tgh_blame_dialog_set_text (TghBlameDialog *dialog, const gchar *text)
 {
-  GtkTreeModel *model;
-  GtkTreeIter iter;
+  const gchar *end;
+  gchar *line;
+  gint64 line_no = 0;
 
   g_return_if_fail (TGH_IS_BLAME_DIALOG (dialog));
 
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->tree_view));
+  /* all lines are shown up front, the hunks fill in the revisions as git finds them */
+  g_object_ref (dialog->model);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (dialog->tree_view), NULL);
+
+  while (*text)
+  {
+    end = strchr (text, '\n');
+    if (!end)
+      end = text + strlen (text);
+
+    line = g_strndup (text, end - text);
+    tvp_list_model_append (dialog->model,
+        COLUMN_LINE_NO, ++line_no,
+        COLUMN_LINE, line,
+        -1);
+    g_free (line);
+
+    text = *end ? end + 1 : end;
+  }
+
+  gtk_tree_view_set_model (GTK_TREE_VIEW (dialog->tree_view), GTK_TREE_MODEL (dialog->model));
+  g_object_unref (dialog->model);
+}
+
+void
+tgh_blame_dialog_add (TghBlameDialog *dialog, gint64 line_no, guint lines, guint revision, const gchar *author, const gchar *date)
+{
+  guint row;
 
-  gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-  gtk_list_store_set (GTK_LIST_STORE (model), &iter,
-      COLUMN_LINE_NO, line_no,
-      COLUMN_REVISION, revision,
-      COLUMN_AUTHOR, author,
-      COLUMN_DATE, date,
-      COLUMN_LINE, line,
-      -1);
+  g_return_if_fail (TGH_IS_BLAME_DIALOG (dialog));
+  g_return_if_fail (line_no > 0);
+
+  /* the file could not be read or changed meanwhile */
+  while (tvp_list_model_get_length (dialog->model) < line_no + lines - 1)
+    tvp_list_model_append (dialog->model,
+        COLUMN_LINE_NO, (gint64) tvp_list_model_get_length (dialog->model) + 1,
+        -1);
+
+  for (row = line_no - 1; lines--; row++)
+    tvp_list_model_set (dialog->model, row,
+        COLUMN_REVISION, revision,
+        COLUMN_AUTHOR, author,
+        COLUMN_DATE, date,
+        -1);
 }
 
 void
@@ -188,6 +232,20 @@ tgh_blame_dialog_done (TghBlameDialog *dialog)
   gtk_widget_show (dialog->close);
 }
 
+static void
+revision_data_func (GtkTreeViewColumn *column, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data)
+{
+  gchar buffer[TGH_OID_HEX_SIZE];
+  guint revision;
+
+  gtk_tree_model_get (model, iter, COLUMN_REVISION, &revision, -1);
+
+  tgh_oid_to_string (revision, buffer);
+  buffer[MIN (strlen (buffer), TGH_BLAME_REVISION_LENGTH)] = '\0';
+
+  g_object_set (renderer, "text", buffer, NULL);
+}
+
 static void
 cancel_clicked (GtkButton *button, gpointer user_data)
 {
@@ -39,12 +39,14 @@ GtkWidget* tgh_blame_dialog_new       (const gchar *title,
                                        GtkWindow *parent,
                                        GtkDialogFlags flags) G_GNUC_MALLOC G_GNUC_INTERNAL;
 
+void       tgh_blame_dialog_set_text  (TghBlameDialog *dialog,
+                                       const gchar *text);
 void       tgh_blame_dialog_add       (TghBlameDialog *dialog,
                                        gint64 line_no,
-                                       const gchar *revision,
+                                       guint lines,
+                                       guint revision,
                                        const gchar *author,
-                                       const gchar *date,
-                                       const gchar *line);
+                                       const gchar *date);
 void       tgh_blame_dialog_done      (TghBlameDialog *dialog);
 
 G_END_DECLS;
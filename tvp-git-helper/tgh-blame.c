@@ -43,14 +43,15 @@ static gboolean blame_spawn (GtkWidget *dialog, gchar *file, GPid *pid)
   TghOutputParser *parser;
   gchar **argv;
 
-  argv = g_new (gchar*, 6);
+  argv = g_new (gchar*, 7);
 
   argv[0] = "git";
   argv[1] = "--no-pager";
   argv[2] = "blame";
-  argv[3] = "--";
-  argv[4] = file;
-  argv[5] = NULL;
+  argv[3] = "--incremental";
+  argv[4] = "--";
+  argv[5] = file;
+  argv[6] = NULL;
 
   if (!g_spawn_async_with_pipes (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH, NULL, NULL, pid, NULL, &fd_out, &fd_err, &error))
   {
@@ -75,6 +76,7 @@ gboolean tgh_blame (gchar **files, GPid *pid)
 {
   GtkWidget *dialog;
   gchar *prefix;
+  gchar *contents;
 
   if (!files)
     return FALSE;
@@ -102,6 +104,12 @@ gboolean tgh_blame (gchar **files, GPid *pid)
   g_signal_connect (dialog, "cancel-clicked", tgh_cancel, NULL);
   tgh_dialog_start (GTK_DIALOG(dialog), TRUE);
 
+  if (g_file_get_contents (files[0], &contents, NULL, NULL))
+  {
+    tgh_blame_dialog_set_text (TGH_BLAME_DIALOG (dialog), contents);
+    g_free (contents);
+  }
+
   return blame_spawn (dialog, files[0], pid);
 }
 
@@ -131,25 +131,11 @@ tgh_cell_renderer_graph_get_size (GtkCellRenderer *cell, GtkWidget *widget, cons
 
   if (renderer->graph_iter)
   {
-    gint count;
-    TghGraphNode *node_iter;
+    TghGraphRow *row = renderer->graph_iter->data;
+    gint count = row->lanes;
 
-    for (node_iter = renderer->graph_iter->data, count = 0; node_iter; node_iter = node_iter->next, count++)
-    {
-      switch (node_iter->type)
-      {
-        case TGH_GRAPH_LINE:
-          break;
-        case TGH_GRAPH_JUNCTION:
-          graph_height = renderer->junction_size;
-          break;
-      }
-    }
-    
-    if (count)
-    {
-      graph_width  = renderer->spacing + renderer->spacing * count + count;
-    }
+    graph_height = renderer->junction_size;
+    graph_width  = renderer->spacing + renderer->spacing * count + count;
   }
 
   gtk_cell_renderer_get_padding (cell, &xpad, &ypad);
@@ -189,60 +175,50 @@ tgh_cell_renderer_graph_get_size (GtkCellRenderer *cell, GtkWidget *widget, cons
     *height = calc_height;
 }
 
-static gint
-tgh_graph_node_length (TghGraphNode *list)
+static inline gint
+lane_x (gint offset, gint lane, guint spacing, gboolean rtl)
 {
-  TghGraphNode *iter;
-  gint count;
-
-  for (iter = list, count = 0; iter; iter = iter->next, count++);
+  gint x = spacing + spacing * lane + lane;
 
-  return count;
+  return rtl ? offset - x : offset + x;
 }
 
 static gint
-tgh_graph_node_index_of (TghGraphNode *list, const gchar *name)
+row_offset (const TghGraphRow *row, const GdkRectangle *cell_area, guint spacing, gfloat xalign, gboolean rtl)
 {
-  TghGraphNode *iter;
-  gint index1;
+  gint width = spacing + spacing * row->lanes + row->lanes;
+  gint offset;
 
-  for (iter = list, index1 = 0; iter; iter = iter->next, index1++)
-  {
-    if (0 == strcmp (name, iter->name))
-      return index1;
-  }
+  offset = ((rtl ?  (1.0 - xalign) : xalign) * (cell_area->width - width)) + (rtl ? width : 0);
+  if (offset < 0)
+    offset = 0;
 
-  return -1;
+  return offset + cell_area->x;
 }
 
 static void
-draw_node (gint index1, TghGraphNode *node_list, const gchar *name, gint x1_offset, gint x2_offset, gint y_offset, gint height, guint spacing, gboolean bottom, gboolean rtl, cairo_t *cr)
+draw_edges (const TghGraphRow *row, gint x1_offset, gint x2_offset, gint y_offset, gint height, guint spacing, gboolean bottom, gboolean rtl, cairo_t *cr)
 {
-  gint index2;
+  const guint16 *edge;
+  const guint16 *end = row->edges + 2 * row->n_edges;
+  double x1, x2;
 
-  index2 = tgh_graph_node_index_of (node_list, name);
-
-  if (index2 >= 0)
+  /* each edge is drawn half in the row above and half in the row below */
+  for (edge = row->edges; edge < end; edge += 2)
   {
-    double x1, x2;
-    if (rtl)
+    x1 = lane_x (x1_offset, edge[0], spacing, rtl);
+    x2 = lane_x (x2_offset, edge[1], spacing, rtl);
+
+    if (bottom)
     {
-      x1 = x1_offset - (spacing + spacing * index1 + index1);
-      x2 = x2_offset - (spacing + spacing * index2 + index2);
+      cairo_move_to (cr, x1, y_offset);
+      cairo_line_to (cr, (x1+x2)/2, y_offset + height);
     }
     else
     {
-      x1 = x1_offset + spacing + spacing * index1 + index1;
-      x2 = x2_offset + spacing + spacing * index2 + index2;
+      cairo_move_to (cr, (x1+x2)/2, y_offset);
+      cairo_line_to (cr, x2, y_offset + height);
     }
-
-    if (bottom)
-      x2 = (x1+x2)/2;
-    else
-      x1 = (x1+x2)/2;
-
-    cairo_move_to (cr, x1, y_offset);
-    cairo_line_to (cr, x2, y_offset + height);
   }
 }
 
@@ -258,10 +234,8 @@ tgh_cell_renderer_graph_render (GtkCellRenderer *cell, cairo_t *cr, GtkWidget *w
   if (renderer->graph_iter)
   {
     GList *graph_iter;
-    TghGraphNode *node_iter;
-    TghGraphNode *node_list;
-    gchar **junction_iter;
-    gint index1;
+    TghGraphRow *row;
+    gint lane;
     gint line_height, line_offset;
     guint spacing = renderer->spacing;
     guint junction_size = renderer->junction_size;
@@ -293,105 +267,48 @@ tgh_cell_renderer_graph_render (GtkCellRenderer *cell, cairo_t *cr, GtkWidget *w
     gtk_style_context_get_color (gtk_widget_get_style_context (widget), gtk_widget_get_state_flags (widget), &fg);
     gdk_cairo_set_source_rgba (cr, &fg);
 
-    node_list = renderer->graph_iter->data;
-    graph_iter = g_list_next (renderer->graph_iter);
-    if (graph_iter)
-    {
-      line_height = (height - junction_size) / 2;
-      line_offset = y_offset;
-
-      x2_offset = tgh_graph_node_length (graph_iter->data);
-      x2_offset = renderer->spacing + renderer->spacing * x2_offset + x2_offset;
-      x2_offset = ((rtl ?  (1.0 - xalign) : xalign) * (cell_area->width - x2_offset)) + (rtl ? x2_offset : 0);
-      if (x2_offset < 0)
-        x2_offset = 0;
-      x2_offset += cell_area->x;
-
-      index1 = 0;
-      for (node_iter = graph_iter->data; node_iter; node_iter = node_iter->next)
-      {
-        switch (node_iter->type)
-        {
-          case TGH_GRAPH_LINE:
-            draw_node (index1, node_list, node_iter->name, x2_offset, x_offset, line_offset, line_height, spacing, FALSE, rtl, cr);
-            index1++;
-            break;
-          case TGH_GRAPH_JUNCTION:
-            if (node_iter->junction)
-            {
-              for (junction_iter = node_iter->junction; *junction_iter; junction_iter++)
-              {
-                draw_node (index1, node_list, *junction_iter, x2_offset, x_offset, line_offset, line_height, spacing, FALSE, rtl, cr);
-              }
-            }
-            index1++;
-            break;
-        }
-      }
-    }
+    row = renderer->graph_iter->data;
+    line_height = (height - junction_size) / 2;
 
-    graph_iter = g_list_previous (renderer->graph_iter);
+    /* the edges coming from the row above */
+    graph_iter = g_list_next (renderer->graph_iter);
     if (graph_iter)
     {
-      node_list = graph_iter->data;
-
-      x2_offset = tgh_graph_node_length (graph_iter->data);
-      x2_offset = renderer->spacing + renderer->spacing * x2_offset + x2_offset;
-      x2_offset = ((rtl ?  (1.0 - xalign) : xalign) * (cell_area->width - x2_offset)) + (rtl ? x2_offset : 0);
-      if (x2_offset < 0)
-        x2_offset = 0;
-      x2_offset += cell_area->x;
+      x2_offset = row_offset (graph_iter->data, cell_area, spacing, xalign, rtl);
+      draw_edges (graph_iter->data, x2_offset, x_offset, y_offset, line_height, spacing, FALSE, rtl, cr);
     }
-    else
-      node_list = NULL;
 
-    line_height = (height - junction_size) / 2;
     line_offset = y_offset + height - line_height;
 
-    index1 = 0;
-    for (node_iter = renderer->graph_iter->data; node_iter; node_iter = node_iter->next)
+    for (lane = 0; lane < row->lanes; lane++)
     {
-      switch (node_iter->type)
+      x = lane_x (x_offset, lane, spacing, rtl);
+
+      if (lane == row->commit)
+      {
+        cairo_rectangle (cr,
+                         x - (junction_size/2),
+                         y_offset + line_height,
+                         junction_size - 1, junction_size - 1);
+        cairo_stroke (cr);
+      }
+      else
       {
-        case TGH_GRAPH_LINE:
-          if (rtl)
-            x = x_offset - (spacing + spacing * index1 + index1);
-          else
-            x = x_offset + spacing + spacing * index1 + index1;
-
-          cairo_set_line_cap (cr, CAIRO_LINE_CAP_SQUARE);
-          cairo_move_to (cr, x, y_offset + line_height);
-          cairo_line_to (cr, x, line_offset);
-          cairo_stroke (cr);
-
-          draw_node (index1, node_list, node_iter->name, x_offset, x2_offset, line_offset, line_height, spacing, TRUE, rtl, cr);
-          index1++;
-          break;
-        case TGH_GRAPH_JUNCTION:
-          if (rtl)
-            x = x_offset - (spacing + spacing * index1 + index1);
-          else
-            x = x_offset + spacing + spacing * index1 + index1;
-
-          cairo_rectangle (cr,
-                           x - (junction_size/2),
-                           y_offset + line_height,
-                           junction_size - 1, junction_size - 1);
-          cairo_stroke (cr);
-
-          if (node_iter->junction)
-          {
-            for (junction_iter = node_iter->junction; *junction_iter; junction_iter++)
-            {
-              draw_node (index1, node_list, *junction_iter, x_offset, x2_offset, line_offset, line_height, spacing, TRUE, rtl, cr);
-            }
-          }
-          index1++;
-          break;
+        cairo_set_line_cap (cr, CAIRO_LINE_CAP_SQUARE);
+        cairo_move_to (cr, x, y_offset + line_height);
+        cairo_line_to (cr, x, line_offset);
+        cairo_stroke (cr);
       }
     }
 
+    /* the edges going to the row below */
+    graph_iter = g_list_previous (renderer->graph_iter);
+    if (graph_iter)
+    {
+      x2_offset = row_offset (graph_iter->data, cell_area, spacing, xalign, rtl);
+      draw_edges (row, x_offset, x2_offset, line_offset, line_height, spacing, TRUE, rtl, cr);
+    }
+
     cairo_stroke (cr);
   }
 }
-
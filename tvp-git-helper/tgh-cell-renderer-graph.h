@@ -33,14 +33,16 @@ typedef struct _TghCellRendererGraph      TghCellRendererGraph;
 #define TGH_IS_CELL_RENDERER_GRAPH_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), TGH_TYPE_CELL_RENDERER_GRAPH))
 #define TGH_CELL_RENDERER_GRAPH_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), TGH_TYPE_CELL_RENDERER_GRAPH, TghCellRendererGraphClass))
 
-typedef struct _TghGraphNode TghGraphNode;
+typedef struct _TghGraphRow TghGraphRow;
 
-struct  _TghGraphNode
+struct  _TghGraphRow
 {
-  TghGraphNode *next;
-  enum {TGH_GRAPH_LINE, TGH_GRAPH_JUNCTION} type;
-  gchar *name;
-  gchar **junction;
+  /* number of lanes and the lane of the commit itself */
+  guint16 lanes;
+  guint16 commit;
+  /* edges to the next row, pairs of a lane in this row and a lane in the next */
+  guint16 n_edges;
+  guint16 edges[];
 };
 
 GType               tgh_cell_renderer_graph_get_type (void) G_GNUC_CONST G_GNUC_INTERNAL;
@@ -75,15 +75,17 @@ static gboolean clone_spawn (GtkWidget *dialog, gchar *repository, gchar *path,
   gchar **argv;
   struct exit_args *args;
 
-  argv = g_new(gchar*, 7);
+  argv = g_new(gchar*, 8);
 
   argv[0] = "git";
   argv[1] = "--no-pager";
   argv[2] = "clone";
-  argv[3] = "--";
-  argv[4] = repository;
-  argv[5] = path;
-  argv[6] = NULL;
+  /* stderr is a pipe, the meter has to be asked for */
+  argv[3] = "--progress";
+  argv[4] = "--";
+  argv[5] = repository;
+  argv[6] = path;
+  argv[7] = NULL;
 
   if(!g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH, NULL, NULL, pid, NULL, NULL, &fd_err, &error))
   {
@@ -92,7 +94,7 @@ static gboolean clone_spawn (GtkWidget *dialog, gchar *repository, gchar *path,
   }
   g_free (argv);
 
-  parser = tgh_error_parser_new(GTK_WIDGET(dialog));
+  parser = tgh_progress_parser_new(GTK_WIDGET(dialog));
 
   args = g_new(struct exit_args, 1);
   args->parser = parser;
@@ -121,9 +123,10 @@ gboolean tgh_clone (gchar **files, GPid *pid)
   g_strfreev (files);
   repository = tgh_transfer_dialog_get_repository (TGH_TRANSFER_DIALOG (dialog));
   path = tgh_transfer_dialog_get_directory(TGH_TRANSFER_DIALOG(dialog));
-  gtk_widget_destroy (dialog);
 
-  dialog = gtk_message_dialog_new (NULL, 0, GTK_MESSAGE_OTHER, GTK_BUTTONS_CANCEL, _("Cloning..."));
+  /* the dialog stays up to show the progress */
+  gtk_window_set_title (GTK_WINDOW (dialog), _("Cloning..."));
+  tgh_transfer_dialog_start (TGH_TRANSFER_DIALOG (dialog));
   g_signal_connect (dialog, "response", tgh_cancel, NULL);
   tgh_dialog_start (GTK_DIALOG(dialog), TRUE);
 
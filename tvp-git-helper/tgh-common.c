@@ -32,6 +32,13 @@
 #include <sys/wait.h>
 #endif
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+
 #include <glib.h>
 #include <gtk/gtk.h>
 
@@ -44,6 +51,7 @@
 #include "tgh-branch-dialog.h"
 #include "tgh-stash-dialog.h"
 #include "tgh-blame-dialog.h"
+#include "tgh-transfer-dialog.h"
 
 #include "tgh-common.h"
 
@@ -182,9 +190,251 @@ tgh_strip_prefix (gchar **files, const gchar *prefix)
   return stripped;
 }
 
+/* the object ids seen by the helper, each stored once in binary,
+ * slot 0 is used to look up an id before it is added */
+static GByteArray *oid_table = NULL;
+static GHashTable *oid_index = NULL;
+static guint oid_size = 0;
+
+static guint
+oid_hash (gconstpointer key)
+{
+  guint hash;
+
+  /* the ids are hashes already */
+  memcpy (&hash, oid_table->data + GPOINTER_TO_UINT (key) * oid_size, sizeof (hash));
+
+  return hash;
+}
+
+static gboolean
+oid_equal (gconstpointer a, gconstpointer b)
+{
+  return 0 == memcmp (oid_table->data + GPOINTER_TO_UINT (a) * oid_size,
+                      oid_table->data + GPOINTER_TO_UINT (b) * oid_size,
+                      oid_size);
+}
+
+guint
+tgh_oid_intern (const gchar *hex)
+{
+  guint8 raw[(TGH_OID_HEX_SIZE - 1) / 2];
+  gpointer index;
+  gsize len;
+  gint hi, lo;
+  guint i;
+
+  len = strlen (hex);
+
+  /* sha1 or sha256, whichever the repository uses */
+  if (G_UNLIKELY (oid_size == 0))
+  {
+    if (len != 40 && len != 64)
+      return 0;
+    oid_size = len / 2;
+    oid_table = g_byte_array_sized_new (oid_size * 1024);
+    g_byte_array_set_size (oid_table, oid_size);
+    oid_index = g_hash_table_new (oid_hash, oid_equal);
+  }
+
+  if (len != oid_size * 2)
+    return 0;
+
+  for (i = 0; i < oid_size; i++)
+  {
+    hi = g_ascii_xdigit_value (hex[2*i]);
+    lo = g_ascii_xdigit_value (hex[2*i+1]);
+    if (hi < 0 || lo < 0)
+      return 0;
+    raw[i] = hi << 4 | lo;
+  }
+
+  memcpy (oid_table->data, raw, oid_size);
+  if (g_hash_table_lookup_extended (oid_index, GUINT_TO_POINTER (0), &index, NULL))
+    return GPOINTER_TO_UINT (index);
+
+  i = oid_table->len / oid_size;
+  g_byte_array_append (oid_table, raw, oid_size);
+  g_hash_table_add (oid_index, GUINT_TO_POINTER (i));
+
+  return i;
+}
+
+gchar*
+tgh_oid_to_string (guint oid, gchar *buffer)
+{
+  static const gchar digits[] = "0123456789abcdef";
+  const guint8 *raw;
+  guint i;
+
+  if (oid == 0 || oid_table == NULL || oid >= oid_table->len / oid_size)
+  {
+    buffer[0] = '\0';
+    return buffer;
+  }
+
+  raw = oid_table->data + oid * oid_size;
+  for (i = 0; i < oid_size; i++)
+  {
+    buffer[2*i] = digits[raw[i] >> 4];
+    buffer[2*i+1] = digits[raw[i] & 0xf];
+  }
+  buffer[2*oid_size] = '\0';
+
+  return buffer;
+}
+
+gchar*
+tgh_repository_prefix (void)
+{
+  gchar *cwd, *dir, *parent, *git;
+  const gchar *rest;
+  gchar *prefix = NULL;
+
+  cwd = g_get_current_dir ();
+  dir = g_strdup (cwd);
+
+  /* the current directory below the top of the working tree, with a trailing slash */
+  while (prefix == NULL)
+  {
+    git = g_build_filename (dir, ".git", NULL);
+    if (g_file_test (git, G_FILE_TEST_EXISTS))
+    {
+      rest = cwd + strlen (dir);
+      while (*rest == '/')
+        rest++;
+      prefix = *rest ? g_strconcat (rest, "/", NULL) : g_strdup ("");
+    }
+    g_free (git);
+
+    if (prefix == NULL)
+    {
+      parent = g_path_get_dirname (dir);
+      if (strcmp (parent, dir) == 0)
+        prefix = g_strdup ("");
+      g_free (dir);
+      dir = parent;
+    }
+  }
+
+  g_free (dir);
+  g_free (cwd);
+
+  return prefix;
+}
+
+gchar*
+tgh_relative_path (const gchar *prefix, const gchar *path)
+{
+  GString *relative;
+  const gchar *slash;
+
+  /* drop the directories shared with the current directory */
+  while ((slash = strchr (prefix, '/')) && strncmp (prefix, path, slash - prefix + 1) == 0)
+  {
+    path += slash - prefix + 1;
+    prefix = slash + 1;
+  }
+
+  relative = g_string_new (NULL);
+
+  for (; (slash = strchr (prefix, '/')); prefix = slash + 1)
+    g_string_append (relative, "../");
+  g_string_append (relative, path);
+
+  if (relative->len == 0)
+    g_string_append_c (relative, '.');
+
+  return g_string_free (relative, FALSE);
+}
+
+TghStatusRecordType
+tgh_status_record_parse (gchar *record, gchar *staged, gchar *unstaged, gchar **path)
+{
+  TghStatusRecordType type;
+  guint fields;
+
+  /* the number of fields in front of the path, see git-status(1) porcelain v2 */
+  switch (record[0])
+  {
+    case '1':
+      type = TGH_STATUS_RECORD_CHANGED;
+      fields = 8;
+      break;
+    case '2':
+      type = TGH_STATUS_RECORD_RENAMED;
+      fields = 9;
+      break;
+    case 'u':
+      type = TGH_STATUS_RECORD_UNMERGED;
+      fields = 10;
+      break;
+    case '?':
+      type = TGH_STATUS_RECORD_UNTRACKED;
+      fields = 1;
+      break;
+    case '!':
+      type = TGH_STATUS_RECORD_IGNORED;
+      fields = 1;
+      break;
+    default:
+      /* headers */
+      return TGH_STATUS_RECORD_NONE;
+  }
+
+  *staged = *unstaged = '.';
+  if (fields > 1)
+  {
+    if (record[1] != ' ' || record[2] == '\0' || record[3] == '\0')
+      return TGH_STATUS_RECORD_NONE;
+    *staged = record[2];
+    *unstaged = record[3];
+  }
+
+  /* the path is the last field, it may contain spaces itself */
+  for (; fields; fields--)
+  {
+    record = strchr (record, ' ');
+    if (record == NULL)
+      return TGH_STATUS_RECORD_NONE;
+    record++;
+  }
+
+  *path = record;
+
+  return type;
+}
+
+const gchar*
+tgh_status_to_string (gchar status)
+{
+  switch (status)
+  {
+    case 'M':
+      return _("modified");
+    case 'T':
+      return _("typechange");
+    case 'A':
+      return _("new file");
+    case 'D':
+      return _("deleted");
+    case 'R':
+      return _("renamed");
+    case 'C':
+      return _("copied");
+    case 'U':
+      return _("unmerged");
+    case '?':
+      return _("untracked");
+    case '!':
+      return _("ignored");
+  }
+  return NULL;
+}
+
 typedef struct {
   TghOutputParser parent;
-  gchar *error;
+  GString *error;
   GtkWidget *dialog;
   gboolean done, show_error;
 } TghErrorParser;
@@ -196,7 +446,7 @@ tgh_child_exit(GPid pid, gint status, gpointer user_data)
   if(WEXITSTATUS(status))
   {
     if(parser->done)
-      create_error_dialog(GTK_WINDOW(parser->dialog), parser->error);
+      create_error_dialog(GTK_WINDOW(parser->dialog), parser->error->str);
     else
       parser->show_error = TRUE;
   }
@@ -207,10 +457,10 @@ static void
 error_parser_func(TghErrorParser *parser, gchar *line)
 {
   if(line)
-    parser->error = g_strconcat(parser->error, line, NULL);
+    g_string_append(parser->error, line);
   else
     if(parser->show_error)
-      create_error_dialog(GTK_WINDOW(parser->dialog), parser->error);
+      create_error_dialog(GTK_WINDOW(parser->dialog), parser->error->str);
     else
       parser->done = TRUE;
 }
@@ -222,12 +472,185 @@ tgh_error_parser_new(GtkWidget *dialog)
 
   TGH_OUTPUT_PARSER(parser)->parse = TGH_OUTPUT_PARSER_FUNC(error_parser_func);
 
-  parser->error = g_strdup("");
+  parser->error = g_string_new(NULL);
   parser->dialog = dialog;
 
   return TGH_OUTPUT_PARSER(parser);
 }
 
+/* least time between two progress updates of the dialog, in microseconds */
+#define TGH_PROGRESS_INTERVAL 250000
+
+typedef struct {
+  TghErrorParser parent;
+  /* cleared when the dialog goes away before the output ends */
+  GtkWidget *transfer_dialog;
+  gchar *phase;
+  gint64 shown;
+} TghProgressParser;
+
+/* the phases git reports on stderr, a meter is only trusted when it has a known one
+ * or a "(n/m)" counter */
+static const gchar *progress_phases[] = {
+  "Enumerating objects",
+  "Counting objects",
+  "Compressing objects",
+  "Writing objects",
+  "Receiving objects",
+  "Resolving deltas",
+  "Checking connectivity",
+  "Updating files",
+  "Checking out files",
+  "Filtering content",
+  NULL
+};
+
+static gboolean
+progress_known_phase (const gchar *line)
+{
+  const gchar **iter;
+
+  if (g_str_has_prefix (line, "remote:"))
+  {
+    line += strlen ("remote:");
+    while (*line == ' ')
+      line++;
+  }
+
+  for (iter = progress_phases; *iter; iter++)
+    if (g_str_has_prefix (line, *iter))
+      return TRUE;
+
+  return FALSE;
+}
+
+/* Check for a counter like " (4500/10000)" */
+static gboolean
+progress_has_counter (const gchar *text)
+{
+  while (*text == ' ')
+    text++;
+  if (*text++ != '(' || !g_ascii_isdigit (*text))
+    return FALSE;
+  while (g_ascii_isdigit (*text))
+    text++;
+  if (*text++ != '/' || !g_ascii_isdigit (*text))
+    return FALSE;
+  while (g_ascii_isdigit (*text))
+    text++;
+  return *text == ')';
+}
+
+/* Split a meter line like "Receiving objects:  45% (4500/10000), 120.00 MiB | 30.00 MiB/s",
+ * the line is only modified when it is one */
+static gboolean
+progress_parse (gchar *line, gchar **phase, gint *percent, gchar **transfer)
+{
+  gchar *colon, *value, *end, *paren, *done;
+
+  colon = strrchr (line, ':');
+  if (!colon)
+    return FALSE;
+
+  value = colon + 1;
+  while (*value == ' ')
+    value++;
+
+  *percent = g_ascii_strtoll (value, &end, 10);
+  if (end == value)
+    return FALSE;
+
+  if (*end == '%')
+  {
+    /* a message ending in a number and a percent sign is not enough */
+    if (!progress_has_counter (end + 1) && !progress_known_phase (line))
+      return FALSE;
+  }
+  else
+  {
+    /* counting without a known total, "error: 403" must stay a message */
+    if (*end && *end != ',' && !g_ascii_isspace (*end))
+      return FALSE;
+    if (!progress_known_phase (line))
+      return FALSE;
+    *percent = -1;
+  }
+
+  *transfer = NULL;
+  if (strchr (end, '|') && (paren = strchr (end, ')')))
+  {
+    *transfer = paren + 1;
+    if (**transfer == ',')
+      (*transfer)++;
+    done = g_strrstr (*transfer, ", done.");
+    if (done)
+      *done = '\0';
+    *transfer = g_strstrip (*transfer);
+  }
+
+  *colon = '\0';
+  *phase = g_strstrip (line);
+
+  return TRUE;
+}
+
+static void
+progress_parser_func (TghProgressParser *parser, gchar *line)
+{
+  gchar *phase, *transfer;
+  gint percent;
+  gint64 now;
+
+  if (!line)
+  {
+    if (parser->transfer_dialog)
+      g_object_remove_weak_pointer (G_OBJECT (parser->transfer_dialog), (gpointer *) &parser->transfer_dialog);
+    g_free (parser->phase);
+    parser->phase = NULL;
+
+    error_parser_func (&parser->parent, NULL);
+    return;
+  }
+
+  /* anything else is a message kept for the error dialog */
+  if (!progress_parse (line, &phase, &percent, &transfer))
+  {
+    error_parser_func (&parser->parent, line);
+    return;
+  }
+
+  if (!parser->transfer_dialog)
+    return;
+
+  /* git redraws the meter far more often than is worth showing, a new phase is always shown */
+  now = g_get_monotonic_time ();
+  if (now - parser->shown < TGH_PROGRESS_INTERVAL && !g_strcmp0 (phase, parser->phase))
+    return;
+
+  parser->shown = now;
+  g_free (parser->phase);
+  parser->phase = g_strdup (phase);
+
+  tgh_transfer_dialog_set_progress (TGH_TRANSFER_DIALOG (parser->transfer_dialog), phase, percent, transfer);
+}
+
+TghOutputParser*
+tgh_progress_parser_new (GtkWidget *dialog)
+{
+  TghProgressParser *parser = g_new0(TghProgressParser,1);
+
+  TGH_OUTPUT_PARSER(parser)->parse = TGH_OUTPUT_PARSER_FUNC(progress_parser_func);
+  TGH_OUTPUT_PARSER(parser)->split_cr = TRUE;
+
+  parser->parent.error = g_string_new(NULL);
+  parser->parent.dialog = dialog;
+
+  parser->transfer_dialog = dialog;
+  g_object_add_weak_pointer (G_OBJECT (dialog), (gpointer *) &parser->transfer_dialog);
+
+  return TGH_OUTPUT_PARSER(parser);
+}
+
 typedef struct {
   TghOutputParser parent;
   GtkWidget *dialog;
@@ -262,7 +685,7 @@ notify_parser_func(TghNotifyParser *parser, gchar *line)
 TghOutputParser*
 tgh_notify_parser_new (GtkWidget *dialog)
 {
-  TghNotifyParser *parser = g_new(TghNotifyParser,1);
+  TghNotifyParser *parser = g_new0(TghNotifyParser,1);
 
   TGH_OUTPUT_PARSER(parser)->parse = TGH_OUTPUT_PARSER_FUNC(notify_parser_func);
 
@@ -274,11 +697,9 @@ tgh_notify_parser_new (GtkWidget *dialog)
 typedef struct {
   TghOutputParser parent;
   GtkWidget *dialog;
-  enum {
-    STATUS_COMMIT,
-    STATUS_MODIFIED,
-    STATUS_UNTRACKED
-  } state;
+  gchar *prefix;
+  /* the next record is the origin of a rename or copy */
+  gboolean origin;
 } TghStatusParser;
 
 static void
@@ -287,35 +708,46 @@ status_parser_func(TghStatusParser *parser, gchar *line)
   TghStatusDialog *dialog = TGH_STATUS_DIALOG(parser->dialog);
   if(line)
   {
-    if(line[0] == '#' && line[1] == '\t')
+    TghStatusRecordType type;
+    gchar staged, unstaged;
+    gchar *path, *file;
+
+    if(parser->origin)
     {
-      gchar *file = strchr(line, ':');
-      gchar *state = _("untracked");
-      if(file && parser->state != STATUS_UNTRACKED)
-      {
-        *file = '\0';
-        state = line+2;
-        file = line+14;
-      }
-      else
-        file = line+2;
-      file[strlen(file)-1] = '\0';
-      file = g_shell_unquote(file, NULL);
+      parser->origin = FALSE;
+      return;
+    }
+
+    type = tgh_status_record_parse(line, &staged, &unstaged, &path);
+    if(type == TGH_STATUS_RECORD_NONE || type == TGH_STATUS_RECORD_IGNORED)
+      return;
+
+    parser->origin = (type == TGH_STATUS_RECORD_RENAMED);
 
-      tgh_status_dialog_add(dialog, file, state, parser->state == STATUS_COMMIT);
+    file = tgh_relative_path(parser->prefix, path);
 
-      g_free(file);
+    switch(type)
+    {
+      case TGH_STATUS_RECORD_UNMERGED:
+        tgh_status_dialog_add(dialog, file, tgh_status_to_string('U'), FALSE);
+        break;
+      case TGH_STATUS_RECORD_UNTRACKED:
+        tgh_status_dialog_add(dialog, file, tgh_status_to_string('?'), FALSE);
+        break;
+      default:
+        if(staged != '.')
+          tgh_status_dialog_add(dialog, file, tgh_status_to_string(staged), TRUE);
+        if(unstaged != '.')
+          tgh_status_dialog_add(dialog, file, tgh_status_to_string(unstaged), FALSE);
+        break;
     }
-    else if(strstr(line, "git reset"))
-      parser->state = STATUS_COMMIT;
-    else if(strstr(line, "git add"))
-      parser->state = STATUS_UNTRACKED;
-    else if(strstr(line, "git checkout"))
-      parser->state = STATUS_MODIFIED;
+
+    g_free(file);
   }
   else
   {
     tgh_status_dialog_done(dialog);
+    g_free(parser->prefix);
     g_free(parser);
   }
 }
@@ -323,11 +755,13 @@ status_parser_func(TghStatusParser *parser, gchar *line)
 TghOutputParser*
 tgh_status_parser_new (GtkWidget *dialog)
 {
-  TghStatusParser *parser = g_new(TghStatusParser,1);
+  TghStatusParser *parser = g_new0(TghStatusParser,1);
 
   TGH_OUTPUT_PARSER(parser)->parse = TGH_OUTPUT_PARSER_FUNC(status_parser_func);
+  TGH_OUTPUT_PARSER(parser)->nul_terminated = TRUE;
 
   parser->dialog = dialog;
+  parser->prefix = tgh_repository_prefix();
 
   return TGH_OUTPUT_PARSER(parser);
 }
@@ -335,43 +769,69 @@ tgh_status_parser_new (GtkWidget *dialog)
 typedef struct {
   TghOutputParser parent;
   GtkWidget *dialog;
-  gchar *revision;
-  gchar **parents;
-  gchar *author;
-  gchar *author_date;
-  gchar *commit;
-  gchar *commit_date;
-  gchar *message;
-  GSList *files;
+  /* the fields of the current commit, NUL separated and reset per commit */
+  GString *record;
+  guint revision;
+  gssize author;
+  gssize author_date;
+  gssize commit;
+  gssize commit_date;
+  GArray *parents;
+  GString *message;
+  guint count;
 } TghLogParser;
 
+#define LOG_PARSER_FIELD(parser, field) ((parser)->field < 0 ? NULL : (parser)->record->str + (parser)->field)
+
+static gssize
+log_parser_store(TghLogParser *parser, const gchar *text)
+{
+  gssize offset = parser->record->len;
+
+  /* keep the terminating NUL in the record */
+  g_string_append_len(parser->record, text, strlen(text) + 1);
+
+  return offset;
+}
+
+static void
+log_parser_reset(TghLogParser *parser)
+{
+  g_string_truncate(parser->record, 0);
+  g_string_truncate(parser->message, 0);
+  g_array_set_size(parser->parents, 0);
+  parser->revision = 0;
+  parser->author = -1;
+  parser->author_date = -1;
+  parser->commit = -1;
+  parser->commit_date = -1;
+}
+
 static void
 log_parser_add_entry(TghLogParser *parser, TghLogDialog *dialog)
 {
   tgh_log_dialog_add(dialog,
-      g_slist_reverse(parser->files),
       parser->revision,
-      parser->parents,
-      parser->author,
-      parser->author_date,
-      parser->commit,
-      parser->commit_date,
-      parser->message);
-
-  parser->files = NULL;
-  g_free(parser->revision);
-  parser->revision = NULL;
-  g_strfreev(parser->parents);
-  parser->parents = NULL;
-  parser->author = NULL;
-  g_free(parser->author_date);
-  parser->author_date = NULL;
-  g_free(parser->commit);
-  parser->commit = NULL;
-  g_free(parser->commit_date);
-  parser->commit_date = NULL;
-  g_free(parser->message);
-  parser->message = NULL;
+      (guint *)parser->parents->data,
+      parser->parents->len,
+      LOG_PARSER_FIELD(parser, author),
+      LOG_PARSER_FIELD(parser, author_date),
+      LOG_PARSER_FIELD(parser, commit),
+      LOG_PARSER_FIELD(parser, commit_date),
+      parser->message->len ? parser->message->str : NULL);
+
+  parser->count++;
+  log_parser_reset(parser);
+}
+
+static void
+log_parser_free(TghLogParser *parser)
+{
+  g_free(TGH_OUTPUT_PARSER(parser)->buffer);
+  g_string_free(parser->record, TRUE);
+  g_string_free(parser->message, TRUE);
+  g_array_free(parser->parents, TRUE);
+  g_free(parser);
 }
 
 static void
@@ -383,8 +843,7 @@ log_parser_func(TghLogParser *parser, gchar *line)
     if(strncmp(line, "commit ", 7) == 0)
     {
       gchar *revision, *parent;
-      GSList *parent_list = NULL;
-      guint parent_count = 0;
+      guint oid;
 
       if(parser->revision)
         log_parser_add_entry(parser, dialog);
@@ -396,48 +855,86 @@ log_parser_func(TghLogParser *parser, gchar *line)
       {
         *parent++ = '\0';
         parent = g_strchug (parent);
-        parent_list = g_slist_prepend (parent_list, parent);
-        parent_count++;
+        oid = tgh_oid_intern (parent);
+        if (oid)
+          g_array_append_val (parser->parents, oid);
       }
 
-      parser->revision = g_strdup(revision);
-
-      if (parent_count)
-      {
-        gchar **parents = g_new (char*, parent_count+1);
-        parents[parent_count] = NULL;
-        while (parent_list)
-        {
-          parents[--parent_count] = g_strdup (parent_list->data);
-          parent_list = g_slist_delete_link (parent_list, parent_list);
-        }
-        parser->parents = parents;
-      }
+      parser->revision = tgh_oid_intern(revision);
     }
     else if(strncmp(line, "Author:", 7) == 0)
     {
-      parser->author = g_strdup(g_strstrip(line+7));
+      parser->author = log_parser_store(parser, g_strstrip(line+7));
     }
     else if(strncmp(line, "AuthorDate:", 11) == 0)
     {
-      parser->author_date = g_strdup(g_strstrip(line+11));
+      parser->author_date = log_parser_store(parser, g_strstrip(line+11));
     }
     else if(strncmp(line, "Commit:", 7) == 0)
     {
-      parser->commit = g_strdup(g_strstrip(line+7));
+      parser->commit = log_parser_store(parser, g_strstrip(line+7));
     }
     else if(strncmp(line, "CommitDate:", 11) == 0)
     {
-      parser->commit_date = g_strdup(g_strstrip(line+11));
+      parser->commit_date = log_parser_store(parser, g_strstrip(line+11));
     }
     else if(strncmp(line, "    ", 4) == 0)
     {
-      if(parser->message)
-        parser->message = g_strconcat(parser->message, line+4, NULL);
-      else
-        parser->message = g_strdup(line+4);
+      g_string_append(parser->message, line+4);
     }
-    else if(g_ascii_isdigit(line[0]))
+  }
+  else
+  {
+    if(parser->revision)
+      log_parser_add_entry(parser, dialog);
+    tgh_log_dialog_done(dialog);
+    log_parser_free(parser);
+  }
+}
+
+TghOutputParser*
+tgh_log_parser_new (GtkWidget *dialog)
+{
+  TghLogParser *parser = g_new0(TghLogParser,1);
+
+  TGH_OUTPUT_PARSER(parser)->parse = TGH_OUTPUT_PARSER_FUNC(log_parser_func);
+
+  parser->dialog = dialog;
+  parser->record = g_string_sized_new(256);
+  parser->message = g_string_sized_new(256);
+  parser->parents = g_array_new(FALSE, FALSE, sizeof(guint));
+  log_parser_reset(parser);
+
+  return TGH_OUTPUT_PARSER(parser);
+}
+
+guint
+tgh_log_parser_get_count (TghOutputParser *output_parser)
+{
+  return ((TghLogParser *)output_parser)->count;
+}
+
+void
+tgh_log_parser_free (TghOutputParser *output_parser)
+{
+  /* drop the commit in progress without adding it */
+  log_parser_free((TghLogParser *)output_parser);
+}
+
+typedef struct {
+  TghOutputParser parent;
+  GtkWidget *dialog;
+  gchar *revision;
+  GSList *files;
+} TghLogFilesParser;
+
+static void
+log_files_parser_func(TghLogFilesParser *parser, gchar *line)
+{
+  TghLogDialog *dialog = TGH_LOG_DIALOG(parser->dialog);
+  if(line)
+  {
+    if(g_ascii_isdigit(line[0]))
     {
       gchar *ptr, *path;
       TghLogFile *file;
@@ -451,21 +948,21 @@ log_parser_func(TghLogParser *parser, gchar *line)
   }
   else
   {
-    if(parser->revision)
-      log_parser_add_entry(parser, dialog);
-    tgh_log_dialog_done(dialog);
+    tgh_log_dialog_set_files(dialog, parser->revision, g_slist_reverse(parser->files));
+    g_free(parser->revision);
     g_free(parser);
   }
 }
 
 TghOutputParser*
-tgh_log_parser_new (GtkWidget *dialog)
+tgh_log_files_parser_new (GtkWidget *dialog, const gchar *revision)
 {
-  TghLogParser *parser = g_new0(TghLogParser,1);
+  TghLogFilesParser *parser = g_new0(TghLogFilesParser,1);
 
-  TGH_OUTPUT_PARSER(parser)->parse = TGH_OUTPUT_PARSER_FUNC(log_parser_func);
+  TGH_OUTPUT_PARSER(parser)->parse = TGH_OUTPUT_PARSER_FUNC(log_files_parser_func);
 
   parser->dialog = dialog;
+  parser->revision = g_strdup(revision);
 
   return TGH_OUTPUT_PARSER(parser);
 }
@@ -495,7 +992,7 @@ branch_parser_func(TghStatusParser *parser, gchar *line)
 TghOutputParser*
 tgh_branch_parser_new (GtkWidget *dialog)
 {
-  TghBranchParser *parser = g_new(TghBranchParser,1);
+  TghBranchParser *parser = g_new0(TghBranchParser,1);
 
   TGH_OUTPUT_PARSER(parser)->parse = TGH_OUTPUT_PARSER_FUNC(branch_parser_func);
 
@@ -535,7 +1032,7 @@ stash_list_parser_func (TghStashListParser *parser, gchar *line)
 TghOutputParser*
 tgh_stash_list_parser_new (GtkWidget *dialog)
 {
-  TghStashListParser *parser = g_new (TghStashListParser,1);
+  TghStashListParser *parser = g_new0 (TghStashListParser,1);
 
   TGH_OUTPUT_PARSER (parser)->parse = TGH_OUTPUT_PARSER_FUNC (stash_list_parser_func);
 
@@ -572,7 +1069,7 @@ stash_show_parser_func (TghStashShowParser *parser, gchar *line)
 TghOutputParser*
 tgh_stash_show_parser_new (GtkWidget *dialog)
 {
-  TghStashShowParser *parser = g_new (TghStashShowParser,1);
+  TghStashShowParser *parser = g_new0 (TghStashShowParser,1);
 
   TGH_OUTPUT_PARSER (parser)->parse = TGH_OUTPUT_PARSER_FUNC (stash_show_parser_func);
 
@@ -581,52 +1078,127 @@ tgh_stash_show_parser_new (GtkWidget *dialog)
   return TGH_OUTPUT_PARSER (parser);
 }
 
+typedef struct {
+  gchar *author;
+  gchar *date;
+  gint64 time;
+  gchar *tz;
+} TghBlameCommit;
+
 typedef struct {
   TghOutputParser parent;
   GtkWidget *dialog;
+  /* the commits seen so far, their headers are only given once */
+  GHashTable *commits;
+  /* the hunk being read */
+  TghBlameCommit *commit;
+  guint revision;
+  gint64 line_no;
+  guint lines;
 } TghBlameParser;
 
+static void
+blame_commit_free (gpointer data)
+{
+  TghBlameCommit *commit = data;
+
+  g_free (commit->author);
+  g_free (commit->date);
+  g_free (commit->tz);
+  g_free (commit);
+}
+
+static void
+blame_commit_format_date (TghBlameCommit *commit)
+{
+  GDateTime *utc, *local;
+  const gchar *tz = commit->tz;
+  gint sign = 1, offset;
+  gchar *date;
+
+  if (commit->date || !tz)
+    return;
+
+  /* git writes the offset as +hhmm, apply it to the utc time instead of
+   * building a time zone for it */
+  if (*tz == '-')
+    sign = -1;
+  if (*tz == '-' || *tz == '+')
+    tz++;
+  if (strlen (tz) != 4 || !g_ascii_isdigit (tz[0]) || !g_ascii_isdigit (tz[1]) ||
+      !g_ascii_isdigit (tz[2]) || !g_ascii_isdigit (tz[3]))
+    return;
+  offset = sign * (((tz[0] - '0') * 10 + (tz[1] - '0')) * 3600 + ((tz[2] - '0') * 10 + (tz[3] - '0')) * 60);
+
+  /* the same as the default blame output */
+  utc = g_date_time_new_from_unix_utc (commit->time);
+  local = g_date_time_add_seconds (utc, offset);
+
+  date = g_date_time_format (local, "%Y-%m-%d %H:%M:%S");
+  commit->date = g_strconcat (date, " ", commit->tz, NULL);
+
+  g_free (date);
+  g_date_time_unref (local);
+  g_date_time_unref (utc);
+}
+
 static void
 blame_parser_func (TghBlameParser *parser, gchar *line)
 {
   TghBlameDialog *dialog = TGH_BLAME_DIALOG (parser->dialog);
   if (line)
   {
-    gchar *revision, *name, *date, *text, *ptr;
-    guint64 line_no;
-
-    name = strchr (line, '(');
-    *name++ = '\0';
-
-    revision = g_strstrip (line);
-
-    text = strchr (name, ')');
-    *text = '\0';
-    text += 2;
-    text[strlen (text)-1] = '\0';
-
-    ptr = strrchr (name, ' ');
-    line_no = g_ascii_strtoull (ptr, NULL, 10);
+    gchar *ptr;
 
-    while (*--ptr == ' ');
-    ptr[1] = '\0';
+    g_strchomp (line);
 
-    date = strrchr (name, ' ');
-    *date = '\0';
-    ptr = strrchr (name, ' ');
-    *date = ' ';
-    *ptr = '\0';
-    date = strrchr (name, ' ');
-    *ptr = ' ';
-    *date++ = '\0';
-
-    name = g_strstrip (name);
-
-    tgh_blame_dialog_add (dialog, line_no, revision, name, date, text);
+    if (!parser->commit)
+    {
+      /* <revision> <source line> <result line> <lines> */
+      ptr = strchr (line, ' ');
+      if (!ptr)
+        return;
+      *ptr++ = '\0';
+
+      parser->revision = tgh_oid_intern (line);
+      /* skip the line number in the commit itself */
+      strtoul (ptr, &ptr, 10);
+      parser->line_no = g_ascii_strtoll (ptr, &ptr, 10);
+      parser->lines = strtoul (ptr, NULL, 10);
+
+      parser->commit = g_hash_table_lookup (parser->commits, GUINT_TO_POINTER (parser->revision));
+      if (!parser->commit)
+      {
+        parser->commit = g_new0 (TghBlameCommit, 1);
+        g_hash_table_insert (parser->commits, GUINT_TO_POINTER (parser->revision), parser->commit);
+      }
+    }
+    else if (strncmp (line, "author ", 7) == 0)
+    {
+      g_free (parser->commit->author);
+      parser->commit->author = g_strdup (line + 7);
+    }
+    else if (strncmp (line, "author-time ", 12) == 0)
+    {
+      parser->commit->time = g_ascii_strtoll (line + 12, NULL, 10);
+    }
+    else if (strncmp (line, "author-tz ", 10) == 0)
+    {
+      g_free (parser->commit->tz);
+      parser->commit->tz = g_strdup (line + 10);
+    }
+    else if (strncmp (line, "filename ", 9) == 0)
+    {
+      /* the hunk is complete */
+      blame_commit_format_date (parser->commit);
+      tgh_blame_dialog_add (dialog, parser->line_no, parser->lines, parser->revision, parser->commit->author, parser->commit->date);
+      parser->commit = NULL;
+    }
   }
   else
   {
     tgh_blame_dialog_done (dialog);
+    g_hash_table_destroy (parser->commits);
     g_free (parser);
   }
 }
@@ -634,11 +1206,12 @@ blame_parser_func (TghBlameParser *parser, gchar *line)
 TghOutputParser*
 tgh_blame_parser_new (GtkWidget *dialog)
 {
-  TghBlameParser *parser = g_new (TghBlameParser,1);
+  TghBlameParser *parser = g_new0 (TghBlameParser,1);
 
   TGH_OUTPUT_PARSER (parser)->parse = TGH_OUTPUT_PARSER_FUNC (blame_parser_func);
 
   parser->dialog = dialog;
+  parser->commits = g_hash_table_new_full (NULL, NULL, NULL, blame_commit_free);
 
   return TGH_OUTPUT_PARSER (parser);
 }
@@ -679,7 +1252,7 @@ clean_parser_func(TghNotifyParser *parser, gchar *line)
 TghOutputParser*
 tgh_clean_parser_new (GtkWidget *dialog)
 {
-  TghCleanParser *parser = g_new(TghCleanParser,1);
+  TghCleanParser *parser = g_new0(TghCleanParser,1);
 
   TGH_OUTPUT_PARSER(parser)->parse = TGH_OUTPUT_PARSER_FUNC(clean_parser_func);
 
@@ -688,27 +1261,106 @@ tgh_clean_parser_new (GtkWidget *dialog)
   return TGH_OUTPUT_PARSER(parser);
 }
 
+/* amount read from the pipe at once */
+#define TGH_OUTPUT_CHUNK_SIZE 65536
+
+static gchar *
+output_parser_eol (TghOutputParser *parser, gchar *line, gchar *end)
+{
+  gchar *eol, *cr;
+
+  eol = memchr (line, parser->nul_terminated ? '\0' : '\n', end - line);
+
+  if (parser->split_cr && (cr = memchr (line, '\r', (eol ? eol : end) - line)))
+    return cr;
+
+  return eol;
+}
+
+static void
+output_parser_feed (TghOutputParser *parser, gboolean flush)
+{
+  gchar *line, *end, *eol;
+  gchar next;
+
+  line = parser->buffer;
+  end = parser->buffer + parser->length;
+
+  /* hand out the lines in place, the byte after each line is borrowed for the NUL */
+  while ((eol = output_parser_eol (parser, line, end)))
+  {
+    eol++;
+    next = *eol;
+    *eol = '\0';
+    parser->parse (parser, line);
+    *eol = next;
+    line = eol;
+  }
+
+  if (flush && line < end)
+  {
+    *end = '\0';
+    parser->parse (parser, line);
+    line = end;
+  }
+
+  /* only the start of an incomplete line is kept */
+  parser->length = end - line;
+  if (parser->length && line != parser->buffer)
+    memmove (parser->buffer, line, parser->length);
+}
+
+static gssize
+output_parser_read (TghOutputParser *parser, gint fd)
+{
+  gssize n;
+
+  /* keep room for a chunk and the terminating NUL */
+  if (parser->size - parser->length < TGH_OUTPUT_CHUNK_SIZE + 1)
+  {
+    parser->size = MAX (parser->size * 2, parser->length + TGH_OUTPUT_CHUNK_SIZE + 1);
+    parser->buffer = g_realloc (parser->buffer, parser->size);
+  }
+
+  do
+    n = read (fd, parser->buffer + parser->length, TGH_OUTPUT_CHUNK_SIZE);
+  while (n < 0 && errno == EINTR);
+
+  if (n > 0)
+  {
+    parser->length += n;
+    output_parser_feed (parser, FALSE);
+  }
+
+  return n;
+}
+
 gboolean
 tgh_parse_output_func(GIOChannel *source, GIOCondition condition, gpointer data)
 {
   TghOutputParser *parser = TGH_OUTPUT_PARSER (data);
-  gchar *line;
+  gint fd = g_io_channel_unix_get_fd (source);
 
+  /* the pipe is read directly, one chunk per wakeup */
   if(condition & G_IO_IN)
   {
-    while(g_io_channel_read_line(source, &line, NULL, NULL, NULL) == G_IO_STATUS_NORMAL)
-    {
-      parser->parse(parser, line);
-      g_free(line);
-    }
+    if(output_parser_read(parser, fd) > 0)
+      return TRUE;
   }
 
-  if(condition & G_IO_HUP)
+  if(condition & (G_IO_HUP|G_IO_IN))
   {
+    /* the writer is gone, the rest of the output can be read without blocking */
+    while(output_parser_read(parser, fd) > 0);
+    output_parser_feed(parser, TRUE);
+
+    g_free(parser->buffer);
+    parser->buffer = NULL;
+    parser->length = parser->size = 0;
+
     parser->parse(parser, NULL);
     g_io_channel_unref(source);
     return FALSE;
   }
   return TRUE;
 }
-
@@ -30,6 +30,27 @@ void tgh_child_exit     (GPid, gint, gpointer);
 gchar* tgh_common_prefix (gchar **files);
 gchar** tgh_strip_prefix (gchar **files, const gchar *prefix);
 
+/* room for a hex object id and the terminating NUL */
+#define TGH_OID_HEX_SIZE 65
+
+guint  tgh_oid_intern    (const gchar *hex);
+gchar* tgh_oid_to_string (guint oid, gchar *buffer);
+
+gchar* tgh_repository_prefix (void);
+gchar* tgh_relative_path     (const gchar *prefix, const gchar *path);
+
+typedef enum {
+  TGH_STATUS_RECORD_NONE,
+  TGH_STATUS_RECORD_CHANGED,
+  TGH_STATUS_RECORD_RENAMED,
+  TGH_STATUS_RECORD_UNMERGED,
+  TGH_STATUS_RECORD_UNTRACKED,
+  TGH_STATUS_RECORD_IGNORED
+} TghStatusRecordType;
+
+TghStatusRecordType tgh_status_record_parse (gchar *record, gchar *staged, gchar *unstaged, gchar **path);
+const gchar*        tgh_status_to_string    (gchar status);
+
 #define TGH_OUTPUT_PARSER(x) ((TghOutputParser*)(x))
 #define TGH_OUTPUT_PARSER_FUNC(x) ((TghOutputParserFunc)(x))
 
@@ -39,15 +60,27 @@ typedef void (*TghOutputParserFunc) (TghOutputParser *, gchar *);
 
 struct _TghOutputParser {
   TghOutputParserFunc parse;
+  /* unparsed output, owned by tgh_parse_output_func */
+  gchar *buffer;
+  gsize length;
+  gsize size;
+  /* records end in a NUL instead of a newline, as with -z */
+  gboolean nul_terminated;
+  /* a carriage return ends a record as well, as with --progress */
+  gboolean split_cr;
 };
 
 TghOutputParser* tgh_error_parser_new      (GtkWidget *);
+TghOutputParser* tgh_progress_parser_new   (GtkWidget *);
 
 TghOutputParser* tgh_notify_parser_new     (GtkWidget *);
 
 TghOutputParser* tgh_status_parser_new     (GtkWidget *);
 
 TghOutputParser* tgh_log_parser_new        (GtkWidget *);
+guint            tgh_log_parser_get_count  (TghOutputParser *);
+void             tgh_log_parser_free       (TghOutputParser *);
+TghOutputParser* tgh_log_files_parser_new  (GtkWidget *, const gchar *);
 
 TghOutputParser* tgh_branch_parser_new     (GtkWidget *);
 
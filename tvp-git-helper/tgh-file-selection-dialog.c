@@ -28,7 +28,9 @@
 typedef struct {
   TghOutputParser parent;
   GtkWidget *dialog;
-  enum {STATUS_ADDED, STATUS_MODIFIED, STATUS_UNTRACKED} state;
+  gchar *prefix;
+  /* the next record is the origin of a rename or copy */
+  gboolean origin;
 } StatusParser;
 
 static void status_parser_func(StatusParser *, gchar *);
@@ -52,7 +54,7 @@ struct _TghFileSelectionDialogClass
 
 G_DEFINE_TYPE (TghFileSelectionDialog, tgh_file_selection_dialog, GTK_TYPE_DIALOG)
 
-static gchar *argv[] = {"git", "--no-pager", "status", NULL};
+static gchar *argv[] = {"git", "--no-pager", "status", "--porcelain=v2", "-z", "--untracked-files=normal", NULL};
 
 static void
 tgh_file_selection_dialog_class_init (TghFileSelectionDialogClass *klass)
@@ -130,11 +132,13 @@ tgh_file_selection_dialog_init (TghFileSelectionDialog *dialog)
 
 static TghOutputParser* status_parser_new (GtkWidget *dialog)
 {
-  StatusParser *parser = g_new(StatusParser,1);
+  StatusParser *parser = g_new0(StatusParser,1);
 
   TGH_OUTPUT_PARSER(parser)->parse = TGH_OUTPUT_PARSER_FUNC(status_parser_func);
+  TGH_OUTPUT_PARSER(parser)->nul_terminated = TRUE;
 
   parser->dialog = dialog;
+  parser->prefix = tgh_repository_prefix();
 
   return TGH_OUTPUT_PARSER(parser);
 }
@@ -232,75 +236,88 @@ tgh_file_selection_dialog_get_files (TghFileSelectionDialog *dialog)
 }
 
 static void
-status_parser_func(StatusParser *parser, gchar *line)
+status_parser_add(StatusParser *parser, const gchar *path, const gchar *state, TghFileSelectionFlags flag)
 {
   TghFileSelectionDialog *dialog = TGH_FILE_SELECTION_DIALOG(parser->dialog);
-  if(line)
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  gboolean select_ = FALSE;
+  gchar *file;
+
+  if(!(dialog->flags & flag))
+    return;
+
+  switch(flag)
   {
-    gboolean add = FALSE;
-    gboolean select_ = FALSE;
-    if(line[0] == '#' && line[1] == '\t')
-    {
-      gchar *file = strchr(line, ':');
-      gchar *state = _("untracked");
-      if(file && parser->state != STATUS_UNTRACKED)
-      {
-        *file = '\0';
-        state = line+2;
-        file = line+14;
-      }
-      else
-        file = line+2;
-      file[strlen(file)-1] = '\0';
-      file = g_shell_unquote(file, NULL);
+    case TGH_FILE_SELECTION_FLAG_ADDED:
+      select_ = TRUE;
+      break;
+    case TGH_FILE_SELECTION_FLAG_MODIFIED:
+      if(!(dialog->flags & TGH_FILE_SELECTION_FLAG_ADDED))
+        select_ = TRUE;
+      break;
+    case TGH_FILE_SELECTION_FLAG_UNTRACKED:
+      if(!(dialog->flags & (TGH_FILE_SELECTION_FLAG_ADDED|TGH_FILE_SELECTION_FLAG_MODIFIED)))
+        select_ = TRUE;
+      break;
+    default:
+      break;
+  }
 
-      switch(parser->state)
-      {
-        case STATUS_ADDED:
-          if(dialog->flags & TGH_FILE_SELECTION_FLAG_ADDED)
-            add = TRUE;
-          select_ = TRUE;
-          break;
-        case STATUS_MODIFIED:
-          if(dialog->flags & TGH_FILE_SELECTION_FLAG_MODIFIED)
-            add = TRUE;
-          if(!(dialog->flags & TGH_FILE_SELECTION_FLAG_ADDED))
-            select_ = TRUE;
-          break;
-        case STATUS_UNTRACKED:
-          if(dialog->flags & TGH_FILE_SELECTION_FLAG_UNTRACKED)
-            add = TRUE;
-          if(!(dialog->flags & (TGH_FILE_SELECTION_FLAG_ADDED|TGH_FILE_SELECTION_FLAG_MODIFIED)))
-            select_ = TRUE;
-          break;
-      }
+  file = tgh_relative_path(parser->prefix, path);
 
-      if (add)
-      {
-        GtkTreeModel *model;
-        GtkTreeIter iter;
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->tree_view));
+
+  gtk_list_store_append (GTK_LIST_STORE (model), &iter);
+  gtk_list_store_set (GTK_LIST_STORE (model), &iter,
+                      COLUMN_PATH, file,
+                      COLUMN_STAT, state,
+                      COLUMN_SELECTION, select_,
+                      -1);
 
-        model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->tree_view));
+  g_free(file);
+}
 
-        gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-        gtk_list_store_set (GTK_LIST_STORE (model), &iter,
-                            COLUMN_PATH, file,
-                            COLUMN_STAT, state,
-                            COLUMN_SELECTION, select_,
-                            -1);
-      }
+static void
+status_parser_func(StatusParser *parser, gchar *line)
+{
+  if(line)
+  {
+    TghStatusRecordType type;
+    gchar staged, unstaged;
+    gchar *path;
 
-      g_free(file);
+    if(parser->origin)
+    {
+      parser->origin = FALSE;
+      return;
+    }
+
+    type = tgh_status_record_parse(line, &staged, &unstaged, &path);
+
+    switch(type)
+    {
+      case TGH_STATUS_RECORD_CHANGED:
+      case TGH_STATUS_RECORD_RENAMED:
+        parser->origin = (type == TGH_STATUS_RECORD_RENAMED);
+        if(staged != '.')
+          status_parser_add(parser, path, tgh_status_to_string(staged), TGH_FILE_SELECTION_FLAG_ADDED);
+        if(unstaged != '.')
+          status_parser_add(parser, path, tgh_status_to_string(unstaged), TGH_FILE_SELECTION_FLAG_MODIFIED);
+        break;
+      case TGH_STATUS_RECORD_UNMERGED:
+        status_parser_add(parser, path, tgh_status_to_string('U'), TGH_FILE_SELECTION_FLAG_MODIFIED);
+        break;
+      case TGH_STATUS_RECORD_UNTRACKED:
+        status_parser_add(parser, path, tgh_status_to_string('?'), TGH_FILE_SELECTION_FLAG_UNTRACKED);
+        break;
+      default:
+        break;
     }
-    else if(strstr(line, "git reset"))
-      parser->state = STATUS_ADDED;
-    else if(strstr(line, "git add"))
-      parser->state = STATUS_UNTRACKED;
-    else if(strstr(line, "git checkout"))
-      parser->state = STATUS_MODIFIED;
   }
   else
   {
+    g_free(parser->prefix);
     g_free(parser);
   }
 }
@@ -23,6 +23,8 @@
 #include <exo/exo.h>
 #include <libxfce4util/libxfce4util.h>
 
+#include <tvp-common/tvp-list-model.h>
+
 #include "tgh-common.h"
 #include "tgh-cell-renderer-graph.h"
 #include "tgh-log-dialog.h"
@@ -30,14 +32,31 @@
 static void selection_changed (GtkTreeView*, gpointer);
 static void cancel_clicked (GtkButton*, gpointer);
 static void refresh_clicked (GtkButton*, gpointer);
+static void scroll_changed (GtkAdjustment*, gpointer);
+static void tgh_log_file_list_free (gpointer);
+static void tgh_graph_clear (TghLogDialog*);
+static void revision_data_func (GtkTreeViewColumn*, GtkCellRenderer*, GtkTreeModel*, GtkTreeIter*, gpointer);
+
+/* number of commits for which the changed files are kept */
+#define TGH_LOG_FILES_CACHE_SIZE 32
 
 struct _TghLogDialog
 {
   GtkDialog dialog;
 
   GList *graph;
+  /* the commits expected in the next row, with their lane + 1 */
+  GArray *lanes;
+  GHashTable *lane_index;
+  GArray *next_lanes;
+  GHashTable *next_lane_index;
+  GArray *edges;
+
+  GHashTable *files_cache;
+  GQueue *files_lru;
 
   GtkWidget *tree_view;
+  TvpListModel *model;
   GtkWidget *revision_label;
   GtkWidget *text_view;
   GtkWidget *file_view;
@@ -56,14 +75,38 @@ G_DEFINE_TYPE (TghLogDialog, tgh_log_dialog, GTK_TYPE_DIALOG)
 enum {
   SIGNAL_CANCEL = 0,
   SIGNAL_REFRESH,
+  SIGNAL_MORE,
+  SIGNAL_SELECTED,
   SIGNAL_COUNT
 };
 
 static guint signals[SIGNAL_COUNT];
 
+static void
+tgh_log_dialog_finalize (GObject *object)
+{
+  TghLogDialog *dialog = TGH_LOG_DIALOG (object);
+
+  tgh_graph_clear (dialog);
+  g_array_free (dialog->lanes, TRUE);
+  g_array_free (dialog->next_lanes, TRUE);
+  g_hash_table_destroy (dialog->lane_index);
+  g_hash_table_destroy (dialog->next_lane_index);
+  g_array_free (dialog->edges, TRUE);
+
+  g_hash_table_destroy (dialog->files_cache);
+  g_queue_free (dialog->files_lru);
+
+  G_OBJECT_CLASS (tgh_log_dialog_parent_class)->finalize (object);
+}
+
 static void
 tgh_log_dialog_class_init (TghLogDialogClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = tgh_log_dialog_finalize;
+
   signals[SIGNAL_CANCEL] = g_signal_new("cancel-clicked",
       G_OBJECT_CLASS_TYPE (klass),
       G_SIGNAL_RUN_FIRST | G_SIGNAL_ACTION,
@@ -76,6 +119,18 @@ tgh_log_dialog_class_init (TghLogDialogClass *klass)
       0, NULL, NULL,
       g_cclosure_marshal_VOID__VOID,
       G_TYPE_NONE, 0);
+  signals[SIGNAL_MORE] = g_signal_new("more-needed",
+      G_OBJECT_CLASS_TYPE (klass),
+      G_SIGNAL_RUN_FIRST,
+      0, NULL, NULL,
+      g_cclosure_marshal_VOID__VOID,
+      G_TYPE_NONE, 0);
+  signals[SIGNAL_SELECTED] = g_signal_new("revision-selected",
+      G_OBJECT_CLASS_TYPE (klass),
+      G_SIGNAL_RUN_FIRST,
+      0, NULL, NULL,
+      g_cclosure_marshal_VOID__STRING,
+      G_TYPE_NONE, 1, G_TYPE_STRING);
 }
 
 enum {
@@ -86,7 +141,6 @@ enum {
   COLUMN_COMMIT_DATE,
   COLUMN_MESSAGE,
   COLUMN_FULL_MESSAGE,
-  COLUMN_FILE_LIST,
   COLUMN_GRAPH,
   COLUMN_COUNT
 };
@@ -112,6 +166,16 @@ tgh_log_dialog_init (TghLogDialog *dialog)
   GtkWidget *box;
   GtkCellRenderer *renderer;
   GtkTreeModel *model;
+  GtkAdjustment *adjustment;
+
+  dialog->files_cache = g_hash_table_new_full (NULL, NULL, NULL, tgh_log_file_list_free);
+  dialog->files_lru = g_queue_new ();
+
+  dialog->lanes = g_array_new (FALSE, FALSE, sizeof (guint));
+  dialog->lane_index = g_hash_table_new (NULL, NULL);
+  dialog->next_lanes = g_array_new (FALSE, FALSE, sizeof (guint));
+  dialog->next_lane_index = g_hash_table_new (NULL, NULL);
+  dialog->edges = g_array_new (FALSE, FALSE, sizeof (guint16));
 
   pane = gtk_paned_new (GTK_ORIENTATION_VERTICAL);
 
@@ -130,10 +194,10 @@ tgh_log_dialog_init (TghLogDialog *dialog)
   renderer = gtk_cell_renderer_text_new ();
   g_object_set (G_OBJECT (renderer), "width-chars", 9, NULL);
   g_object_set (G_OBJECT (renderer), "ellipsize", PANGO_ELLIPSIZE_END, NULL);
-  gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (tree_view),
+  gtk_tree_view_insert_column_with_data_func (GTK_TREE_VIEW (tree_view),
       -1, _("Revision"),
-      renderer, "text",
-      COLUMN_REVISION, NULL);
+      renderer, revision_data_func,
+      NULL, NULL);
 
   renderer = gtk_cell_renderer_text_new ();
   gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (tree_view),
@@ -167,14 +231,21 @@ tgh_log_dialog_init (TghLogDialog *dialog)
       renderer, "text",
       COLUMN_MESSAGE, NULL);
 
-  model = GTK_TREE_MODEL (gtk_list_store_new (COLUMN_COUNT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER, G_TYPE_POINTER));
+  dialog->model = tvp_list_model_new (COLUMN_COUNT, G_TYPE_UINT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER);
+  tvp_list_model_set_column_shared (dialog->model, COLUMN_AUTHOR);
+  tvp_list_model_set_column_shared (dialog->model, COLUMN_COMMIT);
 
-  gtk_tree_view_set_model (GTK_TREE_VIEW (tree_view), model);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (tree_view), GTK_TREE_MODEL (dialog->model));
 
-  g_object_unref (model);
+  g_object_unref (dialog->model);
 
   g_signal_connect (G_OBJECT (tree_view), "cursor-changed", G_CALLBACK (selection_changed), dialog);
 
+  /* the log is read a page at a time, ask for more near the end */
+  adjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (scroll_window));
+  g_signal_connect (G_OBJECT (adjustment), "value-changed", G_CALLBACK (scroll_changed), dialog);
+  g_signal_connect (G_OBJECT (adjustment), "changed", G_CALLBACK (scroll_changed), dialog);
+
   gtk_container_add (GTK_CONTAINER (scroll_window), tree_view);
   gtk_paned_pack1 (GTK_PANED(pane), scroll_window, TRUE, FALSE);
   gtk_widget_show (tree_view);
@@ -282,117 +353,109 @@ tgh_log_dialog_new (const gchar *title, GtkWindow *parent, GtkDialogFlags flags)
 }
 
 static void
-tgh_graph_node_free (TghGraphNode *node)
+tgh_graph_clear (TghLogDialog *dialog)
 {
-  TghGraphNode *next;
-
-  while (node)
-  {
-    g_free (node->name);
-    g_strfreev (node->junction);
+  g_list_free_full (dialog->graph, g_free);
+  dialog->graph = NULL;
 
-    next = node->next;
-    g_free (node);
-    node = next;
-  }
+  g_array_set_size (dialog->lanes, 0);
+  g_hash_table_remove_all (dialog->lane_index);
 }
 
-static TghGraphNode*
-tgh_graph_node_add (TghGraphNode *prev)
+static void
+tgh_graph_link (TghLogDialog *dialog, guint16 lane, guint oid)
 {
-  TghGraphNode *node = g_new0 (TghGraphNode, 1);
-  if (prev)
-    prev->next = node;
-  return node;
-}
+  gpointer index;
+  guint16 edge[2];
 
-static TghGraphNode*
-add_n_check_node (TghGraphNode *node_iter, TghGraphNode **node_list, const gchar *name, const gchar *revision, gchar **parents, gboolean *found)
-{
-  TghGraphNode *iter;
+  edge[0] = lane;
 
-  for (iter = *node_list; iter; iter = iter->next)
+  index = g_hash_table_lookup (dialog->next_lane_index, GUINT_TO_POINTER (oid));
+  if (index)
+  {
+    /* lanes waiting for the same commit join */
+    edge[1] = GPOINTER_TO_UINT (index) - 1;
+  }
+  else
   {
-    if (G_UNLIKELY(0 == strcmp (iter->name, name)))
-      return node_iter;
+    edge[1] = dialog->next_lanes->len;
+    g_array_append_val (dialog->next_lanes, oid);
+    g_hash_table_insert (dialog->next_lane_index, GUINT_TO_POINTER (oid), GUINT_TO_POINTER (dialog->next_lanes->len));
   }
 
-  node_iter = tgh_graph_node_add (node_iter);
+  g_array_append_vals (dialog->edges, edge, 2);
+}
+
+static TghGraphRow*
+tgh_graph_add (TghLogDialog *dialog, guint revision, const guint *parents, guint n_parents)
+{
+  TghGraphRow *row;
+  GArray *lanes;
+  GHashTable *lane_index;
+  gpointer index;
+  guint16 commit;
+  guint i, j;
+
+  index = g_hash_table_lookup (dialog->lane_index, GUINT_TO_POINTER (revision));
+  if (index)
+    commit = GPOINTER_TO_UINT (index) - 1;
+  else
+  {
+    /* a new branch starts at the left, the edges from the row above move along */
+    g_array_prepend_val (dialog->lanes, revision);
+    commit = 0;
 
-  if (G_UNLIKELY (!*node_list))
-    *node_list = node_iter;
+    if (dialog->graph)
+    {
+      row = dialog->graph->data;
+      for (i = 1; i < 2u * row->n_edges; i += 2)
+        row->edges[i]++;
+    }
+  }
 
-  node_iter->name = g_strdup (name);
+  /* lay out the next row, the commit itself is replaced by its parents */
+  g_array_set_size (dialog->edges, 0);
 
-  if (G_UNLIKELY (0 == strcmp (revision, name)))
+  for (i = 0; i < dialog->lanes->len; i++)
   {
-    *found = TRUE;
-    node_iter->type = TGH_GRAPH_JUNCTION;
-    node_iter->junction = g_strdupv (parents);
+    if (i == commit)
+    {
+      for (j = 0; j < n_parents; j++)
+        tgh_graph_link (dialog, i, parents[j]);
+    }
+    else
+      tgh_graph_link (dialog, i, g_array_index (dialog->lanes, guint, i));
   }
 
-  return node_iter;
+  row = g_malloc (sizeof (TghGraphRow) + dialog->edges->len * sizeof (guint16));
+  row->lanes = dialog->lanes->len;
+  row->commit = commit;
+  row->n_edges = dialog->edges->len / 2;
+  memcpy (row->edges, dialog->edges->data, dialog->edges->len * sizeof (guint16));
+
+  lanes = dialog->lanes;
+  dialog->lanes = dialog->next_lanes;
+  dialog->next_lanes = lanes;
+  g_array_set_size (dialog->next_lanes, 0);
+
+  lane_index = dialog->lane_index;
+  dialog->lane_index = dialog->next_lane_index;
+  dialog->next_lane_index = lane_index;
+  g_hash_table_remove_all (dialog->next_lane_index);
+
+  return row;
 }
 
 void
-tgh_log_dialog_add (TghLogDialog *dialog, GSList *files, const gchar *revision, gchar **parents, const gchar *author, const gchar *author_date, const gchar *commit, const gchar *commit_date, const gchar *message)
+tgh_log_dialog_add (TghLogDialog *dialog, guint revision, const guint *parents, guint n_parents, const gchar *author, const gchar *author_date, const gchar *commit, const gchar *commit_date, const gchar *message)
 {
-  GtkTreeModel *model;
-  GtkTreeIter iter;
   gchar **lines = NULL;
   gchar **line_iter;
   gchar *first_line = NULL;
-  GList *graph;
-  TghGraphNode *next_node_list;
-  TghGraphNode *next_node_iter;
-  TghGraphNode *node_list = NULL;
-  TghGraphNode *node_iter = NULL;
-  gchar **junction_iter;
-  gboolean found = FALSE;
 
   g_return_if_fail (TGH_IS_LOG_DIALOG (dialog));
 
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->tree_view));
-
-  graph = dialog->graph;
-
-  if (graph)
-  {
-    next_node_list = graph->data;
-
-    for (next_node_iter = next_node_list; next_node_iter; next_node_iter = next_node_iter->next)
-    {
-      switch (next_node_iter->type)
-      {
-        case TGH_GRAPH_LINE:
-          node_iter = add_n_check_node (node_iter, &node_list, next_node_iter->name, revision, parents, &found);
-          break;
-        case TGH_GRAPH_JUNCTION:
-          if (G_LIKELY (next_node_iter->junction))
-          {
-            for (junction_iter = next_node_iter->junction; *junction_iter; junction_iter++)
-            {
-              node_iter = add_n_check_node (node_iter, &node_list, *junction_iter, revision, parents, &found);
-            }
-          }
-          break;
-      }
-    }
-  }
-
-  if (!found)
-  {
-    node_iter = g_new0 (TghGraphNode, 1);
-    node_iter->next = node_list;
-    node_iter->name = g_strdup (revision);
-    node_iter->type = TGH_GRAPH_JUNCTION;
-    node_iter->junction = g_strdupv (parents);
-    node_list = node_iter;
-  }
-
-  graph = g_list_prepend (graph, node_list);
-
-  dialog->graph = graph;
+  dialog->graph = g_list_prepend (dialog->graph, tgh_graph_add (dialog, revision, parents, n_parents));
 
   if(message)
   {
@@ -409,8 +472,7 @@ tgh_log_dialog_add (TghLogDialog *dialog, GSList *files, const gchar *revision,
     first_line = *line_iter;
   }
 
-  gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-  gtk_list_store_set (GTK_LIST_STORE (model), &iter,
+  tvp_list_model_append (dialog->model,
       COLUMN_REVISION, revision,
       COLUMN_AUTHOR, author,
       COLUMN_AUTHOR_DATE, author_date,
@@ -418,8 +480,7 @@ tgh_log_dialog_add (TghLogDialog *dialog, GSList *files, const gchar *revision,
       COLUMN_COMMIT_DATE, commit_date,
       COLUMN_MESSAGE, first_line,
       COLUMN_FULL_MESSAGE, message,
-      COLUMN_FILE_LIST, files,
-      COLUMN_GRAPH, graph,
+      COLUMN_GRAPH, dialog->graph,
       -1);
 
   g_strfreev (lines);
@@ -434,15 +495,111 @@ tgh_log_dialog_done (TghLogDialog *dialog)
   gtk_widget_show (dialog->refresh);
 }
 
+static void
+tgh_log_file_free (TghLogFile *file)
+{
+  g_free (file->file);
+  g_free (file);
+}
+
+static void
+tgh_log_file_list_free (gpointer data)
+{
+  g_slist_free_full (data, (GDestroyNotify) tgh_log_file_free);
+}
+
+static void
+show_files (TghLogDialog *dialog, GSList *files)
+{
+  GtkTreeIter iter;
+  GtkTreeModel *model;
+
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->file_view));
+  gtk_list_store_clear (GTK_LIST_STORE (model));
+
+  while(files)
+  {
+    gchar *changes = g_strdup_printf ("+%u -%u", TGH_LOG_FILE (files->data)->insertions, TGH_LOG_FILE (files->data)->deletions);
+    guint sum = TGH_LOG_FILE (files->data)->insertions + TGH_LOG_FILE (files->data)->deletions;
+    gtk_list_store_append (GTK_LIST_STORE (model), &iter);
+    gtk_list_store_set (GTK_LIST_STORE (model), &iter,
+        FILE_COLUMN_FILE, TGH_LOG_FILE (files->data)->file,
+        FILE_COLUMN_PERCENTAGE, sum?TGH_LOG_FILE (files->data)->insertions * 100 / sum:0,
+        FILE_COLUMN_CHANGES, changes,
+        -1);
+    g_free (changes);
+    files = files->next;
+  }
+
+  gtk_tree_view_expand_all (GTK_TREE_VIEW (dialog->file_view));
+}
+
+static GSList *
+lookup_files (TghLogDialog *dialog, guint revision, gboolean *found)
+{
+  GList *link;
+  gpointer files = NULL;
+  gpointer key = GUINT_TO_POINTER (revision);
+
+  *found = g_hash_table_lookup_extended (dialog->files_cache, key, NULL, &files);
+
+  /* move it to the front of the lru */
+  if (*found)
+  {
+    link = g_queue_find (dialog->files_lru, key);
+    g_queue_unlink (dialog->files_lru, link);
+    g_queue_push_head_link (dialog->files_lru, link);
+  }
+
+  return files;
+}
+
+void
+tgh_log_dialog_set_files (TghLogDialog *dialog, const gchar *revision, GSList *files)
+{
+  GtkTreeIter iter;
+  GtkTreeSelection *selection;
+  GtkTreeModel *model;
+  guint selected = 0;
+  gpointer key;
+
+  g_return_if_fail (TGH_IS_LOG_DIALOG (dialog));
+
+  key = GUINT_TO_POINTER (tgh_oid_intern (revision));
+
+  if (g_hash_table_contains (dialog->files_cache, key))
+  {
+    tgh_log_file_list_free (files);
+    return;
+  }
+
+  /* the commit is kept even if the selection moved on while git was busy */
+  if (g_queue_get_length (dialog->files_lru) >= TGH_LOG_FILES_CACHE_SIZE)
+    g_hash_table_remove (dialog->files_cache, g_queue_pop_tail (dialog->files_lru));
+
+  g_queue_push_head (dialog->files_lru, key);
+  g_hash_table_insert (dialog->files_cache, key, files);
+
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (dialog->tree_view));
+
+  if (gtk_tree_selection_get_selected (selection, &model, &iter))
+    gtk_tree_model_get (model, &iter, COLUMN_REVISION, &selected, -1);
+
+  if (selected == GPOINTER_TO_UINT (key))
+    show_files (dialog, files);
+}
+
 static void
 selection_changed (GtkTreeView *tree_view, gpointer user_data)
 {
   GtkTreeIter iter;
   GtkTreeSelection *selection;
   GtkTreeModel *model;
-  gchar *revision;
+  gchar revision[TGH_OID_HEX_SIZE];
+  guint oid;
   gchar *message;
   GSList *files;
+  gboolean found;
 
   TghLogDialog *dialog = TGH_LOG_DIALOG (user_data);
 
@@ -450,33 +607,41 @@ selection_changed (GtkTreeView *tree_view, gpointer user_data)
 
   if (gtk_tree_selection_get_selected (selection, &model, &iter))
   {
-    gtk_tree_model_get (model, &iter, COLUMN_REVISION, &revision, COLUMN_FULL_MESSAGE, &message, COLUMN_FILE_LIST, &files, -1);
+    gtk_tree_model_get (model, &iter, COLUMN_REVISION, &oid, COLUMN_FULL_MESSAGE, &message, -1);
 
+    tgh_oid_to_string (oid, revision);
     gtk_label_set_text (GTK_LABEL (dialog->revision_label), revision);
-    g_free (revision);
 
     gtk_text_buffer_set_text (gtk_text_view_get_buffer (GTK_TEXT_VIEW (dialog->text_view)), message?message:"", -1);
     g_free (message);
 
-    model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->file_view));
-    gtk_list_store_clear (GTK_LIST_STORE (model));
+    /* the changed files are only looked up for the selected commit */
+    files = lookup_files (dialog, oid, &found);
+    show_files (dialog, files);
+    if (!found)
+      g_signal_emit (dialog, signals[SIGNAL_SELECTED], 0, revision);
+  }
+}
 
-    while(files)
-    {
-      gchar *changes = g_strdup_printf ("+%u -%u", TGH_LOG_FILE (files->data)->insertions, TGH_LOG_FILE (files->data)->deletions);
-      guint sum = TGH_LOG_FILE (files->data)->insertions + TGH_LOG_FILE (files->data)->deletions;
-      gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-      gtk_list_store_set (GTK_LIST_STORE (model), &iter,
-          FILE_COLUMN_FILE, TGH_LOG_FILE (files->data)->file,
-          FILE_COLUMN_PERCENTAGE, sum?TGH_LOG_FILE (files->data)->insertions * 100 / sum:0,
-          FILE_COLUMN_CHANGES, changes,
-          -1);
-      g_free (changes);
-      files = files->next;
-    }
+static void
+revision_data_func (GtkTreeViewColumn *column, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data)
+{
+  gchar revision[TGH_OID_HEX_SIZE];
+  guint oid;
 
-    gtk_tree_view_expand_all (GTK_TREE_VIEW (dialog->file_view));
-  }
+  gtk_tree_model_get (model, iter, COLUMN_REVISION, &oid, -1);
+
+  g_object_set (renderer, "text", tgh_oid_to_string (oid, revision), NULL);
+}
+
+static void
+scroll_changed (GtkAdjustment *adjustment, gpointer user_data)
+{
+  TghLogDialog *dialog = TGH_LOG_DIALOG (user_data);
+  gdouble page = gtk_adjustment_get_page_size (adjustment);
+
+  if (gtk_adjustment_get_value (adjustment) + 2 * page >= gtk_adjustment_get_upper (adjustment))
+    g_signal_emit (dialog, signals[SIGNAL_MORE], 0);
 }
 
 static void
@@ -490,12 +655,6 @@ cancel_clicked (GtkButton *button, gpointer user_data)
   g_signal_emit (dialog, signals[SIGNAL_CANCEL], 0);
 }
 
-static void
-tvp_graph_node_free (gpointer data)
-{
-  tgh_graph_node_free ((TghGraphNode *) data);
-}
-
 static void
 refresh_clicked (GtkButton *button, gpointer user_data)
 {
@@ -507,11 +666,9 @@ refresh_clicked (GtkButton *button, gpointer user_data)
 
   g_signal_emit (dialog, signals[SIGNAL_REFRESH], 0);
 
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->tree_view));
-  gtk_list_store_clear (GTK_LIST_STORE (model));
+  tvp_list_model_clear (dialog->model);
 
-  g_list_free_full (dialog->graph, tvp_graph_node_free);
-  dialog->graph = NULL;
+  tgh_graph_clear (dialog);
 
   gtk_text_buffer_set_text (gtk_text_view_get_buffer (GTK_TEXT_VIEW (dialog->text_view)), "", -1);
 
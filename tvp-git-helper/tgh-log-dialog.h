@@ -49,14 +49,17 @@ GtkWidget*   tgh_log_dialog_new      (const gchar *title,
                                       GtkDialogFlags flags) G_GNUC_MALLOC G_GNUC_INTERNAL;
 
 void         tgh_log_dialog_add      (TghLogDialog *dialog,
-                                      GSList *files,
-                                      const gchar *revision,
-                                      gchar ** parents,
+                                      guint revision,
+                                      const guint *parents,
+                                      guint n_parents,
                                       const gchar *author,
                                       const gchar *author_date,
                                       const gchar *commit,
                                       const gchar *commit_date,
                                       const gchar *message);
+void         tgh_log_dialog_set_files (TghLogDialog *dialog,
+                                       const gchar *revision,
+                                       GSList *files);
 void         tgh_log_dialog_done     (TghLogDialog *dialog);
 
 G_END_DECLS;
@@ -35,17 +35,66 @@
 
 #include "tgh-log.h"
 
+/* number of commits read before waiting for the user to scroll */
+#define TGH_LOG_PAGE_SIZE 500
+
+static struct {
+  GIOChannel *channel;
+  TghOutputParser *parser;
+  guint watch;
+  guint limit;
+} log_stream;
+
+static void log_stream_stop (void)
+{
+  if (log_stream.watch)
+    g_source_remove (log_stream.watch);
+
+  /* closing the pipe makes a waiting git exit */
+  if (log_stream.channel)
+  {
+    g_io_channel_shutdown (log_stream.channel, FALSE, NULL);
+    g_io_channel_unref (log_stream.channel);
+    tgh_log_parser_free (log_stream.parser);
+  }
+
+  log_stream.channel = NULL;
+  log_stream.parser = NULL;
+  log_stream.watch = 0;
+}
+
+static gboolean log_stream_func (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+  if(!tgh_parse_output_func(source, condition, data))
+  {
+    log_stream.channel = NULL;
+    log_stream.parser = NULL;
+    log_stream.watch = 0;
+    return FALSE;
+  }
+
+  /* stop reading, git blocks on the full pipe until the next page is wanted */
+  if(tgh_log_parser_get_count(TGH_OUTPUT_PARSER (data)) >= log_stream.limit)
+  {
+    log_stream.watch = 0;
+    return FALSE;
+  }
+  return TRUE;
+}
+
 static gboolean log_spawn (TghLogDialog *dialog, gchar **files, GPid *pid)
 {
   GError *error = NULL;
   gint fd_out, fd_err;
-  GIOChannel *chan_out, *chan_err;
+  GIOChannel *chan_err;
   TghOutputParser *parser;
   gsize length;
   gint i;
   gchar **argv;
 
-  length = 10;
+  log_stream_stop ();
+
+  length = 9;
   if(files)
     length += g_strv_length(files);
 
@@ -54,15 +103,14 @@ static gboolean log_spawn (TghLogDialog *dialog, gchar **files, GPid *pid)
   argv[0] = "git";
   argv[1] = "--no-pager";
   argv[2] = "log";
-  argv[3] = "--numstat";
-  argv[4] = "--parents";
-  argv[5] = "--pretty=fuller";
-  argv[6] = "--boundary";
-  argv[7] = "--date-order";
-  argv[8] = "--";
+  argv[3] = "--parents";
+  argv[4] = "--pretty=fuller";
+  argv[5] = "--boundary";
+  argv[6] = "--date-order";
+  argv[7] = "--";
   argv[length-1] = NULL;
 
-  i = 9;
+  i = 8;
   if(files)
     while(*files)
       argv[i++] = *files++;
@@ -78,14 +126,60 @@ static gboolean log_spawn (TghLogDialog *dialog, gchar **files, GPid *pid)
 
   g_child_watch_add(*pid, (GChildWatchFunc)tgh_child_exit, parser);
 
-  chan_out = g_io_channel_unix_new(fd_out);
+  log_stream.channel = g_io_channel_unix_new(fd_out);
+  log_stream.parser = tgh_log_parser_new(GTK_WIDGET(dialog));
+  log_stream.limit = TGH_LOG_PAGE_SIZE;
+  log_stream.watch = g_io_add_watch(log_stream.channel, G_IO_IN|G_IO_HUP, log_stream_func, log_stream.parser);
+
   chan_err = g_io_channel_unix_new(fd_err);
-  g_io_add_watch(chan_out, G_IO_IN|G_IO_HUP, (GIOFunc)tgh_parse_output_func, tgh_log_parser_new(GTK_WIDGET(dialog)));
   g_io_add_watch(chan_err, G_IO_IN|G_IO_HUP, (GIOFunc)tgh_parse_output_func, parser);
 
   return TRUE;
 }
 
+static gboolean files_spawn (TghLogDialog *dialog, gchar **files, const gchar *revision)
+{
+  GError *error = NULL;
+  gint fd_out;
+  GIOChannel *chan_out;
+  gsize length;
+  gint i;
+  gchar **argv;
+
+  length = 9;
+  if(files)
+    length += g_strv_length(files);
+
+  argv = g_new(gchar*, length);
+
+  argv[0] = "git";
+  argv[1] = "--no-pager";
+  argv[2] = "log";
+  argv[3] = "--max-count=1";
+  argv[4] = "--numstat";
+  argv[5] = "--pretty=format:";
+  argv[6] = (gchar *) revision;
+  argv[7] = "--";
+  argv[length-1] = NULL;
+
+  i = 8;
+  if(files)
+    while(*files)
+      argv[i++] = *files++;
+
+  if(!g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, NULL, NULL, &fd_out, NULL, &error))
+  {
+    g_free (argv);
+    return FALSE;
+  }
+  g_free (argv);
+
+  chan_out = g_io_channel_unix_new(fd_out);
+  g_io_add_watch(chan_out, G_IO_IN|G_IO_HUP, (GIOFunc)tgh_parse_output_func, tgh_log_files_parser_new(GTK_WIDGET(dialog), revision));
+
+  return TRUE;
+}
+
 static void create_log_child(TghLogDialog *dialog, gpointer user_data)
 {
   GPid pid;
@@ -95,6 +189,26 @@ static void create_log_child(TghLogDialog *dialog, gpointer user_data)
     tgh_log_dialog_done(dialog);
 }
 
+static void load_more(TghLogDialog *dialog, gpointer user_data)
+{
+  /* resume reading if the current page was filled */
+  if (log_stream.channel && !log_stream.watch)
+  {
+    log_stream.limit = tgh_log_parser_get_count (log_stream.parser) + TGH_LOG_PAGE_SIZE;
+    log_stream.watch = g_io_add_watch(log_stream.channel, G_IO_IN|G_IO_HUP, log_stream_func, log_stream.parser);
+  }
+}
+
+static void cancel_log(TghLogDialog *dialog, gpointer user_data)
+{
+  log_stream_stop ();
+}
+
+static void show_files(TghLogDialog *dialog, const gchar *revision, gpointer user_data)
+{
+  files_spawn(dialog, user_data, revision);
+}
+
 gboolean tgh_log (gchar **files, GPid *pid)
 {
   GtkWidget *dialog;
@@ -124,6 +238,9 @@ gboolean tgh_log (gchar **files, GPid *pid)
   tgh_dialog_start (GTK_DIALOG (dialog), TRUE);
 
   g_signal_connect(dialog, "refresh-clicked", G_CALLBACK(create_log_child), files);
+  g_signal_connect(dialog, "cancel-clicked", G_CALLBACK(cancel_log), NULL);
+  g_signal_connect(dialog, "more-needed", G_CALLBACK(load_more), NULL);
+  g_signal_connect(dialog, "revision-selected", G_CALLBACK(show_files), files);
 
   return log_spawn(TGH_LOG_DIALOG(dialog), files, pid);
 }
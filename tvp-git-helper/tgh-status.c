@@ -39,7 +39,7 @@
 
 #include "tgh-status.h"
 
-static gchar *argv[] = {"git", "--no-pager", "status", NULL};
+static gchar *argv[] = {"git", "--no-pager", "status", "--porcelain=v2", "-z", "--untracked-files=normal", NULL};
 
 static gboolean status_spawn (TghStatusDialog *dialog, GPid *pid)
 {
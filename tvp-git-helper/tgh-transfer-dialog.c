@@ -33,8 +33,11 @@ struct _TghTransferDialog
     GtkDialog dialog;
 
     GtkWidget *repository;
+    GtkWidget *browse;
     GtkWidget *path;
     GtkWidget *filechooser;
+    GtkWidget *progress;
+    GtkWidget *transfer;
 };
 
 struct _TghTransferDialogClass
@@ -75,7 +78,7 @@ tgh_transfer_dialog_init (TghTransferDialog *dialog)
             NULL);
 
     image = gtk_image_new_from_icon_name ("document-open", GTK_ICON_SIZE_MENU);
-    button = gtk_button_new();
+    dialog->browse = button = gtk_button_new();
     gtk_button_set_image(GTK_BUTTON(button), image);
     g_signal_connect(button, "clicked", G_CALLBACK(browse_callback), dialog);
 
@@ -103,6 +106,15 @@ tgh_transfer_dialog_init (TghTransferDialog *dialog)
     gtk_widget_show(label);
     gtk_widget_show(dialog->path);
 
+    /* shown once the transfer runs */
+    dialog->progress = gtk_progress_bar_new ();
+    gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (dialog->progress), TRUE);
+    gtk_grid_attach (GTK_GRID (grid), dialog->progress, 0, 2, 2, 1);
+
+    dialog->transfer = gtk_label_new (NULL);
+    gtk_widget_set_halign (dialog->transfer, GTK_ALIGN_START);
+    gtk_grid_attach (GTK_GRID (grid), dialog->transfer, 0, 3, 2, 1);
+
     gtk_window_set_title (GTK_WINDOW (dialog), _("Transfer"));
 
     gtk_dialog_add_buttons (GTK_DIALOG (dialog),
@@ -192,6 +204,34 @@ gchar* tgh_transfer_dialog_get_directory (TghTransferDialog *dialog)
     return gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog->path));
 }
 
+void tgh_transfer_dialog_start (TghTransferDialog *dialog)
+{
+    g_return_if_fail (TGH_IS_TRANSFER_DIALOG (dialog));
+
+    gtk_widget_set_sensitive (dialog->repository, FALSE);
+    gtk_widget_set_sensitive (dialog->browse, FALSE);
+    gtk_widget_set_sensitive (dialog->path, FALSE);
+    gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog), GTK_RESPONSE_OK, FALSE);
+
+    gtk_widget_show (dialog->progress);
+    gtk_widget_show (dialog->transfer);
+}
+
+void tgh_transfer_dialog_set_progress (TghTransferDialog *dialog, const gchar *phase, gint percent, const gchar *transfer)
+{
+    g_return_if_fail (TGH_IS_TRANSFER_DIALOG (dialog));
+
+    gtk_progress_bar_set_text (GTK_PROGRESS_BAR (dialog->progress), phase);
+
+    /* no total known */
+    if (percent < 0)
+        gtk_progress_bar_pulse (GTK_PROGRESS_BAR (dialog->progress));
+    else
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (dialog->progress), percent / 100.0);
+
+    gtk_label_set_text (GTK_LABEL (dialog->transfer), transfer?transfer:"");
+}
+
 static void
 browse_callback(GtkButton *button, TghTransferDialog *dialog)
 {
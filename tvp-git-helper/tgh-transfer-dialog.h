@@ -44,6 +44,9 @@ GtkWidget* tgh_transfer_dialog_new      (const gchar *title,
 gchar* tgh_transfer_dialog_get_repository (TghTransferDialog*);
 gchar* tgh_transfer_dialog_get_directory (TghTransferDialog*);
 
+void   tgh_transfer_dialog_start        (TghTransferDialog*);
+void   tgh_transfer_dialog_set_progress (TghTransferDialog*, const gchar *phase, gint percent, const gchar *transfer);
+
 G_END_DECLS;
 
 #endif /* !__TGH_TRANSFER_DIALOG_H__ */
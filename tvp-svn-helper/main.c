@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #endif
 
+#include <string.h>
+
 #include <glib.h>
 #include <glib/gprintf.h>
 #include <gtk/gtk.h>
@@ -34,6 +36,7 @@
 #include <subversion-1/svn_pools.h>
 
 #include "tsh-common.h"
+#include "tsh-daemon.h"
 #include "tsh-add.h"
 #include "tsh-blame.h"
 #include "tsh-checkout.h"
@@ -66,15 +69,16 @@ void tsh_replace_thread (GThread *new_thread)
   thread = new_thread;
 }
 
-int main (int argc, char *argv[])
+/* Run the action given on the command line, pool and svn_ctx are set up
+ * already when called from the daemon */
+static int tsh_run (int argc, char *argv[], apr_pool_t *pool, svn_client_ctx_t *svn_ctx)
 {
 	/* SVN variables */
-	apr_pool_t *pool;
 	svn_error_t *err;
-	svn_client_ctx_t *svn_ctx;
 
 	/* CMD-line options */
 	gboolean print_version = FALSE;
+	gboolean run_daemon = FALSE;
 	gboolean add = FALSE;
 	gboolean blame = FALSE;
 	gboolean changelist = FALSE;
@@ -97,6 +101,7 @@ int main (int argc, char *argv[])
   gboolean switch_ = FALSE;
 	gboolean unlock = FALSE;
 	gboolean update = FALSE;
+	gint update_parallel = 0;
 	gchar **files = NULL;
 	GError *error = NULL;
 
@@ -106,6 +111,7 @@ int main (int argc, char *argv[])
 	GOptionEntry general_options_table[] =
 	{
 		{ "version", 'v', 0, G_OPTION_ARG_NONE, &print_version, N_("Print version information"), NULL },
+		{ "daemon", '\0', 0, G_OPTION_ARG_NONE, &run_daemon, N_("Keep running and execute the actions requested by the plugin"), NULL },
 		{ G_OPTION_REMAINING, '\0', G_OPTION_ARG_FILENAME, G_OPTION_ARG_FILENAME_ARRAY, &files, NULL, NULL },
 		{ NULL, '\0', 0, 0, NULL, NULL, NULL }
 	};
@@ -239,16 +245,10 @@ int main (int argc, char *argv[])
 	GOptionEntry update_options_table[] =
 	{
 		{ "update", '\0', 0, G_OPTION_ARG_NONE, &update, N_("Execute update action"), NULL },
+		{ "parallel", '\0', 0, G_OPTION_ARG_INT, &update_parallel, N_("Update up to N working copies at once"), "N" },
 		{ NULL, '\0', 0, 0, NULL, NULL, NULL }
 	};
 
-  /* setup translation domain */
-  xfce_textdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR, "UTF-8");
-
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-	gdk_threads_init ();
-G_GNUC_END_IGNORE_DEPRECATIONS
-
 	option_context = g_option_context_new("<action> [options] [args]");
 
 	g_option_context_add_main_entries(option_context, general_options_table, GETTEXT_PACKAGE);
@@ -354,7 +354,14 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 		return EXIT_SUCCESS;
 	}
 
-	if(!tsh_init(&pool, &err))
+	/* handled by main, as the only argument */
+	if(run_daemon)
+	{
+		g_fprintf(stderr, "%s: %s\n\tTry --help-all\n", g_get_prgname(), _("--daemon takes no other arguments"));
+		return EXIT_FAILURE;
+	}
+
+	if(!pool && !tsh_init(&pool, &err))
 	{
 		if(err)
 		{
@@ -366,7 +373,7 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 		return EXIT_FAILURE;
 	}
 
-	if(!tsh_create_context(&svn_ctx, pool, &err))
+	if(!svn_ctx && !tsh_create_context(&svn_ctx, pool, &err))
 	{
 		if(err)
 		{
@@ -494,13 +501,17 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 
 	if(update)
 	{
-		thread = tsh_update(files, svn_ctx, pool);
+		thread = tsh_update(files, update_parallel, svn_ctx, pool);
 	}
 
 	if(thread)
 	{
 		gtk_main ();
 
+		/* the dialog is gone, stop the svn call and let the worker finish without it */
+		tsh_cancel ();
+		tsh_queue_stop ();
+
 		g_thread_join (thread);
 	}
 
@@ -509,3 +520,38 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 	return EXIT_SUCCESS;
 }
 
+int main (int argc, char *argv[])
+{
+	apr_pool_t *pool = NULL;
+	svn_error_t *err;
+	svn_client_ctx_t *svn_ctx = NULL;
+
+  /* setup translation domain */
+  xfce_textdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR, "UTF-8");
+
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+	gdk_threads_init ();
+G_GNUC_END_IGNORE_DEPRECATIONS
+
+	/* GTK is only initialized in the process forked for each action */
+	if(argc == 2 && strcmp(argv[1], "--daemon") == 0)
+	{
+		g_set_prgname(G_LOG_DOMAIN);
+
+		if(!tsh_init(&pool, &err) || !tsh_create_context(&svn_ctx, pool, &err))
+		{
+			if(err)
+			{
+				svn_handle_error2(err, stderr, FALSE, G_LOG_DOMAIN ": ");
+				svn_error_clear(err);
+			}
+			if(pool)
+				svn_pool_destroy(pool);
+			return EXIT_FAILURE;
+		}
+
+		return tsh_daemon_run(tsh_run, pool, svn_ctx);
+	}
+
+	return tsh_run(argc, argv, NULL, NULL);
+}
@@ -82,6 +82,8 @@ static gpointer add_thread (gpointer user_data)
 #endif
         {
           error_str = tsh_strerror(err);
+          tsh_queue_flush ();
+
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
           gdk_threads_enter();
           tsh_notify_dialog_add(dialog, _("Failed"), error_str, NULL);
@@ -108,6 +110,8 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 #endif
     {
       error_str = tsh_strerror(err);
+      tsh_queue_flush ();
+
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
       gdk_threads_enter();
       tsh_notify_dialog_add(dialog, _("Failed"), error_str, NULL);
@@ -122,6 +126,8 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 
   svn_pool_destroy (subpool);
 
+	tsh_queue_flush ();
+
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
 	gdk_threads_enter();
 	tsh_notify_dialog_done (dialog);
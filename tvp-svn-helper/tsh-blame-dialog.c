@@ -23,6 +23,8 @@
 #include <exo/exo.h>
 #include <libxfce4util/libxfce4util.h>
 
+#include <tvp-common/tvp-list-model.h>
+
 #include <subversion-1/svn_client.h>
 #include <subversion-1/svn_pools.h>
 
@@ -36,6 +38,7 @@ struct _TshBlameDialog
 	GtkDialog dialog;
 
 	GtkWidget *tree_view;
+	TvpListModel *model;
 	GtkWidget *close;
 	GtkWidget *cancel;
 };
@@ -81,7 +84,6 @@ tsh_blame_dialog_init (TshBlameDialog *dialog)
 	GtkWidget *scroll_window;
 	GtkWidget *button;
 	GtkCellRenderer *renderer;
-	GtkTreeModel *model;
 
 	scroll_window = gtk_scrolled_window_new (NULL, NULL);
 	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scroll_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
@@ -118,11 +120,14 @@ tsh_blame_dialog_init (TshBlameDialog *dialog)
                                                "text", COLUMN_LINE,
                                                NULL);
 
-	model = GTK_TREE_MODEL (gtk_list_store_new (COLUMN_COUNT, G_TYPE_INT64, G_TYPE_LONG, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING));
+	/* the rows only refer to the model, which keeps the strings once per commit */
+	dialog->model = tvp_list_model_new (COLUMN_COUNT, G_TYPE_INT64, G_TYPE_LONG, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+	tvp_list_model_set_column_shared (dialog->model, COLUMN_AUTHOR);
+	tvp_list_model_set_column_shared (dialog->model, COLUMN_DATE);
 
-	gtk_tree_view_set_model (GTK_TREE_VIEW (tree_view), model);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (tree_view), GTK_TREE_MODEL (dialog->model));
 
-	g_object_unref (model);
+	g_object_unref (dialog->model);
 
 	gtk_container_add (GTK_CONTAINER (scroll_window), tree_view);
 	gtk_box_pack_start (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), scroll_window, TRUE, TRUE, 0);
@@ -165,15 +170,9 @@ tsh_blame_dialog_new (const gchar *title, GtkWindow *parent, GtkDialogFlags flag
 void
 tsh_blame_dialog_add (TshBlameDialog *dialog, gint64 line_no, glong revision, const gchar *author, const gchar *date, const gchar *line)
 {
-	GtkTreeModel *model;
-	GtkTreeIter iter;
-
   g_return_if_fail (TSH_IS_BLAME_DIALOG (dialog));
 
-	model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->tree_view));
-
-	gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-	gtk_list_store_set (GTK_LIST_STORE (model), &iter,
+	tvp_list_model_append (dialog->model,
 	                    COLUMN_LINE_NO, line_no,
                       COLUMN_REVISION, revision,
                       COLUMN_AUTHOR, author,
@@ -73,6 +73,7 @@ static gpointer blame_thread (gpointer user_data)
 #endif
   {
     svn_pool_destroy (subpool);
+    tsh_queue_flush ();
 
     error_str = tsh_strerror(err);
 
@@ -98,6 +99,7 @@ G_GNUC_END_IGNORE_DEPRECATIONS
   }
 
   svn_pool_destroy (subpool);
+  tsh_queue_flush ();
 
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
   gdk_threads_enter();
@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #endif
 
+#include <string.h>
+
 #include <glib.h>
 #include <gtk/gtk.h>
 
@@ -62,6 +64,38 @@ static svn_error_t* tsh_check_cancel(void*);
 
 static gboolean cancelled = FALSE;
 
+/* records applied to the dialogs per main loop iteration */
+#define TSH_QUEUE_BATCH_SIZE 2000
+/* records a worker may run ahead of the dialog */
+#define TSH_QUEUE_MAX_PENDING 50000
+
+/* how often the dialog shows the transfer progress, in ms */
+#define TSH_PROGRESS_INTERVAL 500
+
+typedef struct {
+  /* the last count reported through the context */
+  gint64 progress;
+  /* bytes the current ra session still has to transfer, -1 when unknown,
+   * a context that has not transferred anything yet does not count */
+  gint64 remaining;
+} TshProgressSession;
+
+/* bytes transferred, summed over the ra sessions of the operation */
+static GMutex progress_lock;
+static gint64 progress_bytes = 0;
+/* the sessions of all contexts counting into progress_bytes */
+static GSList *progress_sessions = NULL;
+/* the session of the context passed to tsh_progress_start */
+static TshProgressSession progress_session;
+
+static GAsyncQueue *record_queue = NULL;
+static gint record_idle = 0;
+static guint record_pending = 0;
+static GMutex record_lock;
+static GCond record_cond;
+/* the main loop is gone, nothing drains the queue anymore */
+static gboolean record_stopped = FALSE;
+
 gboolean tsh_init (apr_pool_t **ppool, svn_error_t **perr)
 {
 	apr_pool_t *pool;
@@ -839,6 +873,239 @@ tsh_char_to_string(gchar status)
   return status_string;
 }
 
+static gboolean
+tsh_queue_drain (gpointer user_data)
+{
+  TshRecord *record;
+  guint count = 0;
+
+  /* called with the gdk lock held, so the whole batch is one update */
+  while (count < TSH_QUEUE_BATCH_SIZE && (record = g_async_queue_try_pop (record_queue)))
+  {
+    record->apply (record);
+    count++;
+  }
+
+  g_mutex_lock (&record_lock);
+  record_pending -= count;
+  g_cond_broadcast (&record_cond);
+  g_mutex_unlock (&record_lock);
+
+  /* give gtk a chance to draw before the next batch */
+  if (count == TSH_QUEUE_BATCH_SIZE)
+    return TRUE;
+
+  g_atomic_int_set (&record_idle, 0);
+
+  /* a record may have been pushed before the flag was cleared */
+  if (g_async_queue_length (record_queue) > 0 && g_atomic_int_compare_and_exchange (&record_idle, 0, 1))
+    return TRUE;
+
+  return FALSE;
+}
+
+static void
+tsh_queue_drop (TshRecord *record)
+{
+  if (record->free)
+    record->free (record);
+  else
+    g_free (record);
+}
+
+void
+tsh_queue_push (TshRecord *record)
+{
+  g_mutex_lock (&record_lock);
+  if (G_UNLIKELY (!record_queue))
+    record_queue = g_async_queue_new ();
+  while (record_pending >= TSH_QUEUE_MAX_PENDING && !record_stopped)
+    g_cond_wait (&record_cond, &record_lock);
+  if (record_stopped)
+  {
+    g_mutex_unlock (&record_lock);
+    tsh_queue_drop (record);
+    return;
+  }
+  record_pending++;
+  g_mutex_unlock (&record_lock);
+
+  g_async_queue_push (record_queue, record);
+
+  if (g_atomic_int_compare_and_exchange (&record_idle, 0, 1))
+  {
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    gdk_threads_add_idle (tsh_queue_drain, NULL);
+G_GNUC_END_IGNORE_DEPRECATIONS
+  }
+}
+
+void
+tsh_queue_flush (void)
+{
+  /* wait until every record of this worker reached its dialog */
+  g_mutex_lock (&record_lock);
+  while (record_pending && !record_stopped)
+    g_cond_wait (&record_cond, &record_lock);
+  g_mutex_unlock (&record_lock);
+}
+
+/* Called once the main loop has quit, a worker still running must not wait
+ * for records that will never be applied */
+void
+tsh_queue_stop (void)
+{
+  TshRecord *record;
+
+  g_mutex_lock (&record_lock);
+  record_stopped = TRUE;
+  g_cond_broadcast (&record_cond);
+  g_mutex_unlock (&record_lock);
+
+  if (record_queue)
+    while ((record = g_async_queue_try_pop (record_queue)))
+      tsh_queue_drop (record);
+}
+
+/* baton is the TshProgressSession of the context */
+void
+tsh_progress_func (apr_off_t progress, apr_off_t total, void *baton, apr_pool_t *pool)
+{
+  TshProgressSession *session = baton;
+
+  /* only counted here, the dialog picks it up on a timer */
+  g_mutex_lock (&progress_lock);
+  /* each ra session counts from 0 */
+  progress_bytes += progress >= session->progress ? progress - session->progress : progress;
+  session->progress = progress;
+  session->remaining = total >= 0 ? total - progress : -1;
+  g_mutex_unlock (&progress_lock);
+}
+
+static gboolean
+tsh_progress_update (gpointer user_data)
+{
+  TshNotifyDialog *dialog = TSH_NOTIFY_DIALOG (user_data);
+  TshProgressSession *session;
+  gint64 bytes, total;
+  GSList *iter;
+
+  g_mutex_lock (&progress_lock);
+  bytes = total = progress_bytes;
+  /* an estimate is only possible when every session knows its size */
+  for (iter = progress_sessions; iter && total >= 0; iter = iter->next)
+  {
+    session = iter->data;
+    total = session->remaining >= 0 ? total + session->remaining : -1;
+  }
+  g_mutex_unlock (&progress_lock);
+
+  tsh_notify_dialog_set_progress (dialog, bytes, total);
+
+  return TRUE;
+}
+
+static void
+tsh_progress_stop (GtkWidget *dialog, gpointer user_data)
+{
+  g_source_remove (GPOINTER_TO_UINT (user_data));
+}
+
+static apr_status_t
+tsh_progress_detach (void *data)
+{
+  g_mutex_lock (&progress_lock);
+  progress_sessions = g_slist_remove (progress_sessions, data);
+  g_mutex_unlock (&progress_lock);
+
+  return APR_SUCCESS;
+}
+
+/* Count the bytes transferred through another context as well, for
+ * workers running next to the one passed to tsh_progress_start. The
+ * context stops counting when pool is destroyed. */
+void
+tsh_progress_attach (svn_client_ctx_t *ctx, apr_pool_t *pool)
+{
+  TshProgressSession *session;
+
+  session = apr_pcalloc (pool, sizeof (TshProgressSession));
+
+  g_mutex_lock (&progress_lock);
+  progress_sessions = g_slist_prepend (progress_sessions, session);
+  g_mutex_unlock (&progress_lock);
+  apr_pool_cleanup_register (pool, session, tsh_progress_detach, apr_pool_cleanup_null);
+
+  ctx->progress_func = tsh_progress_func;
+  ctx->progress_baton = session;
+}
+
+/* Show the bytes transferred by the operation using ctx in dialog */
+void
+tsh_progress_start (svn_client_ctx_t *ctx, GtkWidget *dialog)
+{
+  guint source;
+
+  g_mutex_lock (&progress_lock);
+  progress_bytes = 0;
+  progress_session.progress = 0;
+  progress_session.remaining = 0;
+  if (!g_slist_find (progress_sessions, &progress_session))
+    progress_sessions = g_slist_prepend (progress_sessions, &progress_session);
+  g_mutex_unlock (&progress_lock);
+
+  ctx->progress_func = tsh_progress_func;
+  ctx->progress_baton = &progress_session;
+
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+  source = gdk_threads_add_timeout (TSH_PROGRESS_INTERVAL, tsh_progress_update, dialog);
+G_GNUC_END_IGNORE_DEPRECATIONS
+  g_signal_connect (dialog, "destroy", G_CALLBACK (tsh_progress_stop), GUINT_TO_POINTER (source));
+}
+
+typedef struct {
+  TshRecord parent;
+  TshNotifyDialog *dialog;
+  const gchar *action;
+  gchar *path;
+  gchar *mime;
+} TshNotifyRecord;
+
+static void
+tsh_notify_record_free (TshRecord *record)
+{
+  TshNotifyRecord *notify = (TshNotifyRecord *) record;
+
+  g_free (notify->path);
+  g_free (notify->mime);
+  g_free (notify);
+}
+
+static void
+tsh_notify_record_apply (TshRecord *record)
+{
+  TshNotifyRecord *notify = (TshNotifyRecord *) record;
+
+  tsh_notify_dialog_add (notify->dialog, notify->action, notify->path, notify->mime);
+
+  tsh_notify_record_free (record);
+}
+
+static void
+tsh_notify_push (TshNotifyDialog *dialog, const gchar *action, const gchar *path, const gchar *mime)
+{
+  TshNotifyRecord *record;
+
+  record = g_new (TshNotifyRecord, 1);
+  record->parent.apply = tsh_notify_record_apply;
+  record->parent.free = tsh_notify_record_free;
+  record->dialog = dialog;
+  record->action = action;
+  record->path = g_strdup (path);
+  record->mime = g_strdup (mime);
+  tsh_queue_push (TSH_RECORD (record));
+}
+
 void
 tsh_notify_func2(void *baton, const svn_wc_notify_t *notify, apr_pool_t *pool)
 {
@@ -873,11 +1140,49 @@ tsh_notify_func2(void *baton, const svn_wc_notify_t *notify, apr_pool_t *pool)
       break;
 	}
 
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-  gdk_threads_enter();
-  tsh_notify_dialog_add(dialog, action, path, mime);
-  gdk_threads_leave();
-G_GNUC_END_IGNORE_DEPRECATIONS
+  tsh_notify_push (dialog, action, path, mime);
+}
+
+typedef struct {
+  TshRecord parent;
+  TshStatusDialog *dialog;
+  gboolean versioned;
+  const gchar *text;
+  const gchar *prop;
+  const gchar *repos_text;
+  const gchar *repos_prop;
+  gchar path[1];
+} TshStatusRecord;
+
+static void
+tsh_status_record_apply (TshRecord *record)
+{
+  TshStatusRecord *status = (TshStatusRecord *) record;
+
+  if (tsh_status_dialog_get_show_unversioned (status->dialog) || status->versioned)
+    tsh_status_dialog_add(status->dialog, status->path, status->text, status->prop, status->repos_text, status->repos_prop);
+
+  g_free (status);
+}
+
+static void
+tsh_status_push (TshStatusDialog *dialog, const char *path, gboolean versioned, enum svn_wc_status_kind text, enum svn_wc_status_kind prop, enum svn_wc_status_kind repos_text, enum svn_wc_status_kind repos_prop)
+{
+  gsize len = strlen (path);
+  TshStatusRecord *record;
+
+  /* one allocation holding the path as well */
+  record = g_malloc (sizeof (TshStatusRecord) + len);
+  record->parent.apply = tsh_status_record_apply;
+  record->parent.free = NULL;
+  record->dialog = dialog;
+  record->versioned = versioned;
+  record->text = tsh_status_to_string(text);
+  record->prop = tsh_status_to_string(prop);
+  record->repos_text = tsh_status_to_string(repos_text);
+  record->repos_prop = tsh_status_to_string(repos_prop);
+  memcpy (record->path, path, len + 1);
+  tsh_queue_push (TSH_RECORD (record));
 }
 
 void
@@ -885,12 +1190,7 @@ tsh_status_func2(void *baton, const char *path, svn_wc_status2_t *status)
 {
 	TshStatusDialog *dialog = TSH_STATUS_DIALOG (baton);
 
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-  gdk_threads_enter();
-  if (tsh_status_dialog_get_show_unversioned (dialog) || status->entry)
-    tsh_status_dialog_add(dialog, path, tsh_status_to_string(status->text_status), tsh_status_to_string(status->prop_status), tsh_status_to_string(status->repos_text_status), tsh_status_to_string(status->repos_prop_status));
-  gdk_threads_leave();
-G_GNUC_END_IGNORE_DEPRECATIONS
+  tsh_status_push (dialog, path, status->entry != NULL, status->text_status, status->prop_status, status->repos_text_status, status->repos_prop_status);
 }
 
 svn_error_t *
@@ -905,12 +1205,7 @@ tsh_status_func(void *baton, const char *path, const svn_client_status_t *status
 {
   TshStatusDialog *dialog = TSH_STATUS_DIALOG (baton);
 
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-  gdk_threads_enter();
-  if (tsh_status_dialog_get_show_unversioned (dialog) || status->versioned)
-    tsh_status_dialog_add(dialog, path, tsh_status_to_string(status->text_status), tsh_status_to_string(status->prop_status), tsh_status_to_string(status->repos_text_status), tsh_status_to_string(status->repos_prop_status));
-  gdk_threads_leave();
-G_GNUC_END_IGNORE_DEPRECATIONS
+  tsh_status_push (dialog, path, status->versioned, status->text_status, status->prop_status, status->repos_text_status, status->repos_prop_status);
 
   return SVN_NO_ERROR;
 }
@@ -992,6 +1287,64 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 	return SVN_NO_ERROR;
 }
 
+typedef struct {
+  TshRecord parent;
+  TshLogDialog *dialog;
+  gboolean pop;
+  gboolean has_children;
+  glong revision;
+  GSList *files;
+  gchar *author;
+  gchar *date;
+  gchar *message;
+} TshLogRecord;
+
+static void
+tsh_log_record_apply (TshRecord *record)
+{
+  TshLogRecord *log = (TshLogRecord *) record;
+  gchar *path;
+
+  /* the merged revisions are nested below the revision on top of the stack */
+  if (log->pop)
+  {
+    tsh_log_dialog_pop (log->dialog);
+  }
+  else
+  {
+    path = tsh_log_dialog_add(log->dialog, tsh_log_dialog_top (log->dialog), log->files, log->revision, log->author, log->date, log->message);
+
+    if (log->has_children)
+      tsh_log_dialog_push (log->dialog, path);
+    else
+      g_free (path);
+  }
+
+  g_free (log->author);
+  g_free (log->date);
+  g_free (log->message);
+  g_free (log);
+}
+
+static void
+tsh_log_record_free (TshRecord *record)
+{
+  TshLogRecord *log = (TshLogRecord *) record;
+  GSList *iter;
+
+  for (iter = log->files; iter; iter = iter->next)
+  {
+    g_free (TSH_LOG_FILE (iter->data)->file);
+    g_free (iter->data);
+  }
+  g_slist_free (log->files);
+
+  g_free (log->author);
+  g_free (log->date);
+  g_free (log->message);
+  g_free (log);
+}
+
 svn_error_t *
 tsh_log_func (void *baton, svn_log_entry_t *log_entry, apr_pool_t *pool)
 {
@@ -1003,13 +1356,18 @@ tsh_log_func (void *baton, svn_log_entry_t *log_entry, apr_pool_t *pool)
   gchar *date = NULL;
   gchar *message = NULL;
   GSList *files = NULL;
-  const gchar *parent = NULL;
-  gchar *path = NULL;
+  TshLogRecord *record;
 	TshLogDialog *dialog = TSH_LOG_DIALOG (baton);
 
+  record = g_new0 (TshLogRecord, 1);
+  record->parent.apply = tsh_log_record_apply;
+  record->parent.free = tsh_log_record_free;
+  record->dialog = dialog;
+
   if (log_entry->revision == SVN_INVALID_REVNUM)
   {
-    tsh_log_dialog_pop (dialog);
+    record->pop = TRUE;
+    tsh_queue_push (TSH_RECORD (record));
 	return SVN_NO_ERROR;
   }
 
@@ -1046,24 +1404,61 @@ tsh_log_func (void *baton, svn_log_entry_t *log_entry, apr_pool_t *pool)
     }
   }
 
-  parent = tsh_log_dialog_top (dialog);
+  record->has_children = log_entry->has_children;
+  record->revision = log_entry->revision;
+  record->files = files;
+  record->author = author;
+  record->date = date;
+  record->message = message;
+  tsh_queue_push (TSH_RECORD (record));
 
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-  gdk_threads_enter();
-  path = tsh_log_dialog_add(dialog, parent, files, log_entry->revision, author, date, message);
-  gdk_threads_leave();
-G_GNUC_END_IGNORE_DEPRECATIONS
+	return SVN_NO_ERROR;
+}
 
-  if (log_entry->has_children)
-    tsh_log_dialog_push (dialog, path);
-  else
-    g_free (path);
+typedef struct {
+  TshRecord parent;
+  TshBlameDialog *dialog;
+  apr_int64_t line_no;
+  svn_revnum_t revision;
+  const gchar *author;
+  const gchar *date;
+  gchar line[1];
+} TshBlameRecord;
+
+static void
+tsh_blame_record_apply (TshRecord *record)
+{
+  TshBlameRecord *blame = (TshBlameRecord *) record;
 
-  g_free(author);
-  g_free(date);
-  g_free(message);
+  tsh_blame_dialog_add(blame->dialog, blame->line_no, blame->revision, blame->author, blame->date, blame->line);
 
-	return SVN_NO_ERROR;
+  g_free (blame);
+}
+
+static void
+tsh_blame_push (TshBlameDialog *dialog, apr_int64_t line_no, svn_revnum_t revision, const gchar *author, const gchar *date, const gchar *line)
+{
+  gsize line_len, author_len, date_len;
+  TshBlameRecord *record;
+  gchar *ptr;
+
+  line_len = strlen (line) + 1;
+  author_len = author ? strlen (author) + 1 : 0;
+  date_len = date ? strlen (date) + 1 : 0;
+
+  /* the strings are stored behind the record, one allocation per line */
+  record = g_malloc (sizeof (TshBlameRecord) + line_len + author_len + date_len);
+  record->parent.apply = tsh_blame_record_apply;
+  record->parent.free = NULL;
+  record->dialog = dialog;
+  record->line_no = line_no;
+  record->revision = revision;
+  memcpy (record->line, line, line_len);
+  ptr = record->line + line_len;
+  record->author = author ? memcpy (ptr, author, author_len) : NULL;
+  ptr += author_len;
+  record->date = date ? memcpy (ptr, date, date_len) : NULL;
+  tsh_queue_push (TSH_RECORD (record));
 }
 
 svn_error_t *
@@ -1079,11 +1474,7 @@ tsh_blame_func2 (void *baton, apr_int64_t line_no, svn_revnum_t revision, const
     apr_ctime((date_str = g_new0(gchar, APR_CTIME_LEN)), date_val);
   }
 
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-  gdk_threads_enter();
-  tsh_blame_dialog_add(dialog, line_no, revision, author, date_str, line);
-  gdk_threads_leave();
-G_GNUC_END_IGNORE_DEPRECATIONS
+  tsh_blame_push (dialog, line_no, revision, author, date_str, line);
 
   g_free(date_str);
 
@@ -1112,11 +1503,7 @@ tsh_blame_func3 (void *baton, svn_revnum_t start_revision, svn_revnum_t end_revi
     apr_ctime((date = g_new0(gchar, APR_CTIME_LEN)), date_val);
   }
 
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-  gdk_threads_enter();
-  tsh_blame_dialog_add(dialog, line_no, revision, author, date, line);
-  gdk_threads_leave();
-G_GNUC_END_IGNORE_DEPRECATIONS
+  tsh_blame_push (dialog, line_no, revision, author, date, line);
 
   g_free(author);
   g_free(date);
@@ -1158,11 +1545,7 @@ tsh_commit_func2  (const svn_commit_info_t *commit_info, void *baton, apr_pool_t
 
   if(commit_info->post_commit_err)
   {
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-    gdk_threads_enter();
-    tsh_notify_dialog_add(dialog, _("Error"), commit_info->post_commit_err, NULL);
-    gdk_threads_leave();
-G_GNUC_END_IGNORE_DEPRECATIONS
+    tsh_notify_push(dialog, _("Error"), commit_info->post_commit_err, NULL);
   }
   else
   {
@@ -1176,11 +1559,7 @@ G_GNUC_END_IGNORE_DEPRECATIONS
       message = _("Local action");
     }
 
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-    gdk_threads_enter();
-    tsh_notify_dialog_add(dialog, _("Completed"), message, NULL);
-    gdk_threads_leave();
-G_GNUC_END_IGNORE_DEPRECATIONS
+    tsh_notify_push(dialog, _("Completed"), message, NULL);
   }
 
   return SVN_NO_ERROR;
@@ -31,6 +31,28 @@ void tsh_reset_cancel(void);
 
 gboolean tsh_create_context (svn_client_ctx_t**, apr_pool_t*, svn_error_t**);
 
+#define TSH_RECORD(x) ((TshRecord*)(x))
+
+typedef struct _TshRecord TshRecord;
+
+typedef void (*TshRecordFunc) (TshRecord *);
+
+/* A row for a dialog, produced by a worker and applied on the main loop.
+ * The apply function frees the record, free drops one that never reached
+ * its dialog and is NULL when g_free is enough. */
+struct _TshRecord {
+  TshRecordFunc apply;
+  TshRecordFunc free;
+};
+
+void tsh_queue_push  (TshRecord *);
+void tsh_queue_flush (void);
+void tsh_queue_stop  (void);
+
+void tsh_progress_start (svn_client_ctx_t *, GtkWidget *);
+void tsh_progress_attach (svn_client_ctx_t *, apr_pool_t *);
+void tsh_progress_func  (apr_off_t, apr_off_t, void *, apr_pool_t *);
+
 void         tsh_notify_func2  (void *, const svn_wc_notify_t *, apr_pool_t *);
 void         tsh_status_func2  (void *, const char *, svn_wc_status2_t *);
 svn_error_t *tsh_status_func3  (void *, const char *, svn_wc_status2_t *, apr_pool_t *);
@@ -0,0 +1,373 @@
+/*-
+ * Copyright (C) 2007-2011  Peter de Ridder <peter@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+#include <sys/un.h>
+#endif
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <subversion-1/svn_client.h>
+#include <subversion-1/svn_pools.h>
+
+#include "tsh-common.h"
+#include "tsh-daemon.h"
+
+/* must match the name used in the plugin */
+#define TSH_DAEMON_SOCKET "tvp-svn-helper.socket"
+
+/* largest request accepted, a selection of a few thousand files */
+#define TSH_DAEMON_MAX_REQUEST (1024 * 1024)
+
+/* the session environment taken from the request, must match the list in
+ * the plugin, LC_* is taken as well */
+static const gchar *daemon_environment[] = {
+  "WAYLAND_DISPLAY",
+  "XAUTHORITY",
+  "SSH_AUTH_SOCK",
+  "DBUS_SESSION_BUS_ADDRESS",
+  "LANG",
+  "LANGUAGE",
+  NULL
+};
+
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H)
+
+static gboolean
+daemon_read_request (int fd, GString *request)
+{
+  gchar buffer[4096];
+  ssize_t n;
+
+  while ((n = read (fd, buffer, sizeof (buffer))))
+  {
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+
+    g_string_append_len (request, buffer, n);
+    if (request->len > TSH_DAEMON_MAX_REQUEST)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+daemon_is_environment (const gchar *name, gsize len)
+{
+  const gchar **iter;
+
+  if (len > 3 && strncmp (name, "LC_", 3) == 0)
+    return TRUE;
+
+  for (iter = daemon_environment; *iter; iter++)
+    if (strlen (*iter) == len && strncmp (name, *iter, len) == 0)
+      return TRUE;
+
+  return FALSE;
+}
+
+/* Replace the session environment of the daemon by the one of the plugin */
+static void
+daemon_set_environment (const gchar * const *env)
+{
+  const gchar *value;
+  gchar **names, **iter;
+
+  /* what the plugin's session doesn't have must not leak from the daemon's */
+  names = g_listenv ();
+  for (iter = names; *iter; iter++)
+    if (daemon_is_environment (*iter, strlen (*iter)))
+      g_unsetenv (*iter);
+  g_strfreev (names);
+
+  for (; *env; env++)
+  {
+    value = strchr (*env, '=');
+    if (value && daemon_is_environment (*env, value - *env))
+    {
+      gchar *name = g_strndup (*env, value - *env);
+      g_setenv (name, value + 1, TRUE);
+      g_free (name);
+    }
+  }
+}
+
+/* Describes the files svn reads its configuration from, the context is
+ * only set up again when this changes */
+static gchar *
+daemon_config_stamp (void)
+{
+  static const gchar *names[] = { "config", "servers" };
+  GString *stamp = g_string_new (NULL);
+  gchar *dirs[2];
+  gchar *path;
+  struct stat st;
+  guint i, j;
+
+  dirs[0] = g_build_filename (g_get_home_dir (), ".subversion", NULL);
+  dirs[1] = g_strdup ("/etc/subversion");
+
+  for (i = 0; i < G_N_ELEMENTS (dirs); i++)
+  {
+    for (j = 0; j < G_N_ELEMENTS (names); j++)
+    {
+      path = g_build_filename (dirs[i], names[j], NULL);
+      if (stat (path, &st) == 0)
+        g_string_append_printf (stamp, "%s %ld %ld %ld\n", path, (long) st.st_ino, (long) st.st_mtime, (long) st.st_size);
+      g_free (path);
+    }
+    g_free (dirs[i]);
+  }
+
+  return g_string_free (stamp, FALSE);
+}
+
+/* Set up the context again when the configuration changed since the last
+ * request, the auth cache is kept otherwise */
+static void
+daemon_reload_config (apr_pool_t *pool, svn_client_ctx_t **ctx, apr_pool_t **ctx_pool, gchar **config_stamp)
+{
+  svn_client_ctx_t *new_ctx;
+  apr_pool_t *new_pool;
+  svn_error_t *err;
+  gchar *stamp;
+
+  stamp = daemon_config_stamp ();
+  if (!strcmp (stamp, *config_stamp))
+  {
+    g_free (stamp);
+    return;
+  }
+
+  new_pool = svn_pool_create (pool);
+  if (!tsh_create_context (&new_ctx, new_pool, &err))
+  {
+    /* keep the old one, a broken configuration would fail anyway */
+    if (err)
+      svn_error_clear (err);
+    svn_pool_destroy (new_pool);
+    g_free (stamp);
+    return;
+  }
+
+  if (*ctx_pool)
+    svn_pool_destroy (*ctx_pool);
+  *ctx_pool = new_pool;
+  *ctx = new_ctx;
+
+  g_free (*config_stamp);
+  *config_stamp = stamp;
+}
+
+/* A request holds the working directory, the display, the session
+ * environment as NAME=value entries ended by an empty one, and the
+ * arguments, each terminated by a NUL */
+static void
+daemon_handle (int listen_fd, int fd, TshDaemonFunc func, apr_pool_t *pool, svn_client_ctx_t *ctx)
+{
+  GString *request = g_string_new (NULL);
+  GPtrArray *args;
+  const gchar *iter, *end;
+  gchar reply = 1;
+  guint env_end;
+  pid_t pid;
+
+  if (!daemon_read_request (fd, request))
+  {
+    g_string_free (request, TRUE);
+    return;
+  }
+
+  args = g_ptr_array_new ();
+  for (iter = request->str, end = iter + request->len; iter < end; iter += strlen (iter) + 1)
+    g_ptr_array_add (args, (gpointer) iter);
+
+  /* the environment ends at the first empty entry after the display */
+  for (env_end = 2; env_end < args->len; env_end++)
+    if (!*(const gchar *) g_ptr_array_index (args, env_end))
+      break;
+
+  /* the working directory, the display, the environment and an action */
+  if (env_end + 1 < args->len)
+  {
+    pid = fork ();
+    if (pid == 0)
+    {
+      const gchar *cwd = g_ptr_array_index (args, 0);
+      const gchar *display = g_ptr_array_index (args, 1);
+
+      close (listen_fd);
+      close (fd);
+
+      /* svn waits for the tunnel agents it starts */
+      signal (SIGCHLD, SIG_DFL);
+
+      if (chdir (cwd) < 0)
+        _exit (EXIT_FAILURE);
+
+      if (*display)
+        g_setenv ("DISPLAY", display, TRUE);
+
+      g_ptr_array_index (args, env_end) = NULL;
+      daemon_set_environment ((const gchar * const *) args->pdata + 2);
+
+      /* argv[0] takes the place of the empty entry ending the environment */
+      args->pdata[env_end] = (gpointer) g_get_prgname ();
+      g_ptr_array_add (args, NULL);
+
+      exit (func (args->len - env_end - 1, (char **) args->pdata + env_end, pool, ctx));
+    }
+
+    if (pid > 0)
+      reply = 0;
+  }
+
+  /* tell the plugin it doesn't need to spawn a helper itself */
+  if (write (fd, &reply, 1) < 0)
+    g_warning ("%s", g_strerror (errno));
+
+  g_ptr_array_free (args, TRUE);
+  g_string_free (request, TRUE);
+}
+
+int
+tsh_daemon_run (TshDaemonFunc func, apr_pool_t *pool, svn_client_ctx_t *ctx)
+{
+  struct sockaddr_un addr;
+  struct timeval timeout = { 5, 0 };
+  apr_pool_t *ctx_pool = NULL;
+  gchar *config_stamp;
+  gchar *path;
+  mode_t mask;
+  int fd, conn;
+
+  path = g_build_filename (g_get_user_runtime_dir (), TSH_DAEMON_SOCKET, NULL);
+  if (strlen (path) >= sizeof (addr.sun_path))
+  {
+    g_fprintf (stderr, "%s: %s\n", g_get_prgname (), _("Socket path too long"));
+    g_free (path);
+    return EXIT_FAILURE;
+  }
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+  g_free (path);
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+  {
+    g_fprintf (stderr, "%s: %s\n", g_get_prgname (), g_strerror (errno));
+    return EXIT_FAILURE;
+  }
+
+  /* a socket nobody listens on is left over from a daemon that died */
+  if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) == 0)
+  {
+    g_fprintf (stderr, "%s: %s\n", g_get_prgname (), _("The daemon is already running"));
+    close (fd);
+    return EXIT_FAILURE;
+  }
+  close (fd);
+  unlink (addr.sun_path);
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  mask = umask (0077);
+  if (fd < 0 || bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 || listen (fd, 16) < 0)
+  {
+    umask (mask);
+    g_fprintf (stderr, "%s: %s\n", g_get_prgname (), g_strerror (errno));
+    if (fd >= 0)
+      close (fd);
+    return EXIT_FAILURE;
+  }
+  umask (mask);
+
+  /* the actions are never waited for */
+  signal (SIGCHLD, SIG_IGN);
+
+  /* the context passed in was set up with the current configuration */
+  config_stamp = daemon_config_stamp ();
+
+  for (;;)
+  {
+    conn = accept (fd, NULL, NULL);
+    if (conn < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      g_fprintf (stderr, "%s: %s\n", g_get_prgname (), g_strerror (errno));
+      break;
+    }
+
+    /* a stuck client should not block the others */
+    setsockopt (conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+    daemon_reload_config (pool, &ctx, &ctx_pool, &config_stamp);
+
+    daemon_handle (fd, conn, func, pool, ctx);
+    close (conn);
+  }
+
+  g_free (config_stamp);
+  close (fd);
+  unlink (addr.sun_path);
+
+  return EXIT_FAILURE;
+}
+
+#else
+
+int
+tsh_daemon_run (TshDaemonFunc func, apr_pool_t *pool, svn_client_ctx_t *ctx)
+{
+  g_fprintf (stderr, "%s: %s\n", g_get_prgname (), _("Not supported on this platform"));
+  return EXIT_FAILURE;
+}
+
+#endif
@@ -24,6 +24,8 @@
 #include <exo/exo.h>
 #include <libxfce4util/libxfce4util.h>
 
+#include <tvp-common/tvp-list-model.h>
+
 #include <subversion-1/svn_client.h>
 #include <subversion-1/svn_pools.h>
 
@@ -32,19 +34,26 @@
 
 static void cancel_clicked (GtkButton*, gpointer);
 static void refresh_clicked (GtkButton*, gpointer);
+static void file_changed (GtkComboBox*, gpointer);
+static gboolean key_pressed (GtkWidget*, GdkEventKey*, gpointer);
+static void line_data_func (GtkTreeViewColumn*, GtkCellRenderer*, GtkTreeModel*, GtkTreeIter*, gpointer);
 
 struct _TshDiffDialog
 {
   GtkDialog dialog;
 
-  GtkWidget *text_view;
-  GtkTextTag *tag_red;
-  GtkTextTag *tag_green;
-  GtkTextTag *tag_bold;
+  GtkWidget *tree_view;
+  TvpListModel *model;
+  GtkTreeViewColumn *column;
+  /* the width of a character and of the longest line in columns, for the fixed width column */
+  gint char_width;
+  gint max_length;
+  /* the first row of each file, in the order of the file selector */
+  GArray *file_rows;
+  GtkWidget *file;
   GtkWidget *close;
   GtkWidget *cancel;
   GtkWidget *refresh;
-  gint current_line;
   GtkWidget *depth;
   GtkWidget *notice_ancestry;
   GtkWidget *no_diff_deleted;
@@ -68,9 +77,36 @@ enum {
 
 static guint signals[SIGNAL_COUNT];
 
+enum {
+  COLUMN_LINE = 0,
+  COLUMN_KIND,
+  COLUMN_COUNT
+};
+
+enum {
+  LINE_CONTEXT = 0,
+  LINE_REMOVED,
+  LINE_ADDED,
+  LINE_FILE
+};
+
+static void
+tsh_diff_dialog_finalize (GObject *object)
+{
+  TshDiffDialog *dialog = TSH_DIFF_DIALOG (object);
+
+  g_array_free (dialog->file_rows, TRUE);
+
+  G_OBJECT_CLASS (tsh_diff_dialog_parent_class)->finalize (object);
+}
+
 static void
 tsh_diff_dialog_class_init (TshDiffDialogClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = tsh_diff_dialog_finalize;
+
   signals[SIGNAL_CANCEL] = g_signal_new("cancel-clicked",
     G_OBJECT_CLASS_TYPE (klass),
     G_SIGNAL_RUN_FIRST | G_SIGNAL_ACTION,
@@ -88,9 +124,11 @@ tsh_diff_dialog_class_init (TshDiffDialogClass *klass)
 static void
 tsh_diff_dialog_init (TshDiffDialog *dialog)
 {
-  GtkWidget *text_view;
-  GtkTextBuffer *text_buffer;
+  GtkWidget *tree_view;
   GtkWidget *scroll_window;
+  GtkWidget *file;
+  PangoLayout *layout;
+  PangoFontDescription *font;
   GtkWidget *button;
   GtkWidget *grid;
   GtkTreeModel *model;
@@ -106,24 +144,46 @@ tsh_diff_dialog_init (TshDiffDialog *dialog)
   scroll_window = gtk_scrolled_window_new (NULL, NULL);
   gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scroll_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
 
-  dialog->text_view = text_view = gtk_text_view_new ();
-  gtk_text_view_set_editable(GTK_TEXT_VIEW(text_view), FALSE);
-  gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(text_view), FALSE);
-  gtk_text_view_set_monospace (GTK_TEXT_VIEW (text_view), TRUE);
-  text_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(dialog->text_view));
-  dialog->tag_red = gtk_text_buffer_create_tag(text_buffer, NULL,
-                                               "foreground", "red", NULL);
-  dialog->tag_green = gtk_text_buffer_create_tag(text_buffer, NULL,
-                                                 "foreground",
-                                                 "forestgreen", NULL);
-  dialog->tag_bold = gtk_text_buffer_create_tag(text_buffer, NULL,
-                                                "weight",
-                                                PANGO_WEIGHT_BOLD, NULL);
-  dialog->current_line = 0;
-
-  gtk_container_add (GTK_CONTAINER (scroll_window), text_view);
+  /* a fixed height list only lays out and colours the visible lines */
+  dialog->tree_view = tree_view = gtk_tree_view_new ();
+  gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (tree_view), FALSE);
+  gtk_tree_view_set_enable_search (GTK_TREE_VIEW (tree_view), FALSE);
+  gtk_tree_selection_set_mode (gtk_tree_view_get_selection (GTK_TREE_VIEW (tree_view)), GTK_SELECTION_MULTIPLE);
+  g_signal_connect (G_OBJECT (tree_view), "key-press-event", G_CALLBACK (key_pressed), dialog);
+
+  renderer = gtk_cell_renderer_text_new ();
+  g_object_set (G_OBJECT (renderer), "family", "monospace", "ypad", 0, NULL);
+
+  dialog->column = gtk_tree_view_column_new ();
+  gtk_tree_view_column_set_sizing (dialog->column, GTK_TREE_VIEW_COLUMN_FIXED);
+  gtk_tree_view_column_pack_start (dialog->column, renderer, TRUE);
+  gtk_tree_view_column_set_cell_data_func (dialog->column, renderer, line_data_func, NULL, NULL);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (tree_view), dialog->column);
+
+  gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (tree_view), TRUE);
+
+  font = pango_font_description_from_string ("monospace");
+  layout = gtk_widget_create_pango_layout (tree_view, "M");
+  pango_layout_set_font_description (layout, font);
+  pango_layout_get_pixel_size (layout, &dialog->char_width, NULL);
+  g_object_unref (layout);
+  pango_font_description_free (font);
+  dialog->max_length = 0;
+
+  dialog->model = tvp_list_model_new (COLUMN_COUNT, G_TYPE_STRING, G_TYPE_INT);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (tree_view), GTK_TREE_MODEL (dialog->model));
+  g_object_unref (dialog->model);
+
+  dialog->file_rows = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  dialog->file = file = gtk_combo_box_text_new ();
+  g_signal_connect (G_OBJECT (file), "changed", G_CALLBACK (file_changed), dialog);
+  gtk_box_pack_start (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), file, FALSE, FALSE, 0);
+  gtk_widget_show (file);
+
+  gtk_container_add (GTK_CONTAINER (scroll_window), tree_view);
   gtk_box_pack_start (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), scroll_window, TRUE, TRUE, 0);
-  gtk_widget_show (text_view);
+  gtk_widget_show (tree_view);
   gtk_widget_show (scroll_window);
 
   gtk_window_set_title (GTK_WINDOW (dialog), _("Diff"));
@@ -236,32 +296,93 @@ tsh_diff_dialog_new (const gchar *title, GtkWindow *parent, GtkDialogFlags flags
   return GTK_WIDGET(dialog);
 }
 
+static void
+tsh_diff_dialog_clear (TshDiffDialog *dialog)
+{
+  tvp_list_model_clear (dialog->model);
+
+  g_array_set_size (dialog->file_rows, 0);
+  gtk_combo_box_text_remove_all (GTK_COMBO_BOX_TEXT (dialog->file));
+
+  dialog->max_length = 0;
+  gtk_tree_view_column_set_fixed_width (dialog->column, 1);
+}
+
+/* The number of columns the line takes on screen, with tab stops every
+ * 8 columns like pango uses and double width for wide characters */
+static gint
+line_columns (const gchar *line, gint len)
+{
+  const gchar *end = line + len;
+  gunichar c;
+  gint columns = 0;
+
+  while (line < end)
+  {
+    c = g_utf8_get_char_validated (line, end - line);
+    if (c == (gunichar) -1 || c == (gunichar) -2)
+    {
+      /* shown as a replacement character */
+      columns++;
+      line++;
+      continue;
+    }
+
+    if (c == '\t')
+      columns += 8 - columns % 8;
+    else if (g_unichar_iswide (c))
+      columns += 2;
+    else if (!g_unichar_iszerowidth (c))
+      columns++;
+
+    line = g_utf8_next_char (line);
+  }
+
+  return columns;
+}
+
 void
 tsh_diff_dialog_add (TshDiffDialog *dialog, const char *line, gint len)
 {
-  GtkTextBuffer *text_buffer;
-  GtkTextIter line_start;
-  GtkTextTag *tag = NULL;
+  gchar *text;
+  gint kind = LINE_CONTEXT;
+  gint columns;
+  guint row;
 
   g_return_if_fail (TSH_IS_DIFF_DIALOG (dialog));
 
   if (line[0] == '-')
-    tag = dialog->tag_red;
+    kind = LINE_REMOVED;
   else if (line[0] == '+')
-    tag = dialog->tag_green;
+    kind = LINE_ADDED;
   else if (strncmp(line, "Index", 5) == 0)
-    tag = dialog->tag_bold;
-
-  text_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(dialog->text_view));
-  gtk_text_buffer_get_iter_at_line(text_buffer, &line_start,
-                                   dialog->current_line);
-  if (tag)
-    gtk_text_buffer_insert_with_tags(text_buffer, &line_start, line, len,
-                                     tag, NULL);
-  else
-    gtk_text_buffer_insert(text_buffer, &line_start, line, len);
-
-  dialog->current_line++;
+    kind = LINE_FILE;
+
+  /* one row per line, without the line ending */
+  while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+    len--;
+
+  text = g_strndup (line, len);
+  row = tvp_list_model_append (dialog->model,
+                               COLUMN_LINE, text,
+                               COLUMN_KIND, kind,
+                               -1);
+
+  if (kind == LINE_FILE && strncmp (text, "Index: ", 7) == 0)
+  {
+    g_array_append_val (dialog->file_rows, row);
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (dialog->file), text + 7);
+  }
+
+  g_free (text);
+
+  /* bytes would overestimate non ascii text and underestimate tabs */
+  columns = line_columns (line, len);
+  if (columns > dialog->max_length)
+  {
+    dialog->max_length = columns;
+    gtk_tree_view_column_set_fixed_width (dialog->column, (columns + 2) * dialog->char_width);
+  }
 }
 
 void
@@ -290,17 +411,88 @@ static void
 refresh_clicked(GtkButton *button, gpointer user_data)
 {
   TshDiffDialog *dialog = TSH_DIFF_DIALOG(user_data);
-  GtkTextBuffer *text_buffer;
 
   gtk_widget_hide(dialog->refresh);
   gtk_widget_show(dialog->cancel);
 
-  text_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(dialog->text_view));
-  gtk_text_buffer_set_text(text_buffer, "", -1);
+  tsh_diff_dialog_clear (dialog);
 
   g_signal_emit(dialog, signals[SIGNAL_REFRESH], 0);
 }
 
+static void
+file_changed (GtkComboBox *combo_box, gpointer user_data)
+{
+  TshDiffDialog *dialog = TSH_DIFF_DIALOG (user_data);
+  GtkTreePath *path;
+  gint active;
+
+  active = gtk_combo_box_get_active (combo_box);
+  if (active < 0 || (guint) active >= dialog->file_rows->len)
+    return;
+
+  path = gtk_tree_path_new_from_indices (g_array_index (dialog->file_rows, guint, active), -1);
+  gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (dialog->tree_view), path, NULL, TRUE, 0.0, 0.0);
+  gtk_tree_view_set_cursor (GTK_TREE_VIEW (dialog->tree_view), path, NULL, FALSE);
+  gtk_tree_path_free (path);
+}
+
+static gboolean
+key_pressed (GtkWidget *widget, GdkEventKey *event, gpointer user_data)
+{
+  TshDiffDialog *dialog = TSH_DIFF_DIALOG (user_data);
+  GtkTreeSelection *selection;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  GList *rows, *row;
+  GString *text;
+  gchar *line;
+
+  if (!(event->state & GDK_CONTROL_MASK) || (event->keyval != GDK_KEY_c && event->keyval != GDK_KEY_C))
+    return FALSE;
+
+  /* copy the selected lines as text */
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (dialog->tree_view));
+  rows = gtk_tree_selection_get_selected_rows (selection, &model);
+  text = g_string_new (NULL);
+
+  for (row = rows; row; row = row->next)
+  {
+    if (gtk_tree_model_get_iter (model, &iter, row->data))
+    {
+      gtk_tree_model_get (model, &iter, COLUMN_LINE, &line, -1);
+      g_string_append (text, line);
+      g_string_append_c (text, '\n');
+      g_free (line);
+    }
+  }
+
+  gtk_clipboard_set_text (gtk_widget_get_clipboard (widget, GDK_SELECTION_CLIPBOARD), text->str, text->len);
+
+  g_string_free (text, TRUE);
+  g_list_free_full (rows, (GDestroyNotify) gtk_tree_path_free);
+
+  return TRUE;
+}
+
+static void
+line_data_func (GtkTreeViewColumn *column, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data)
+{
+  gchar *line;
+  gint kind;
+
+  gtk_tree_model_get (model, iter, COLUMN_LINE, &line, COLUMN_KIND, &kind, -1);
+
+  g_object_set (renderer,
+                "text", line,
+                "foreground", kind == LINE_REMOVED ? "red" : "forestgreen",
+                "foreground-set", kind == LINE_REMOVED || kind == LINE_ADDED,
+                "weight", kind == LINE_FILE ? PANGO_WEIGHT_BOLD : PANGO_WEIGHT_NORMAL,
+                NULL);
+
+  g_free (line);
+}
+
 svn_depth_t
 tsh_diff_dialog_get_depth (TshDiffDialog *dialog)
 {
@@ -356,8 +548,7 @@ tsh_diff_dialog_get_notice_ancestry (TshDiffDialog *dialog)
 void
 tsh_diff_dialog_start (TshDiffDialog *dialog)
 {
-  GtkTextBuffer *text_buffer;
+  g_return_if_fail (TSH_IS_DIFF_DIALOG (dialog));
 
-  text_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(dialog->text_view));
-  gtk_text_buffer_set_text(text_buffer, _("Loading..."), -1);
+  tsh_diff_dialog_clear (dialog);
 }
@@ -25,6 +25,8 @@
 #include <stdlib.h>
 #endif
 
+#include <string.h>
+
 #include <glib.h>
 #include <gtk/gtk.h>
 
@@ -50,6 +52,101 @@ struct thread_args {
   gchar **files;
 };
 
+typedef struct {
+  TshRecord parent;
+  TshDiffDialog *dialog;
+  gint len;
+  gchar line[1];
+} TshDiffRecord;
+
+static void diff_record_apply (TshRecord *record)
+{
+  TshDiffRecord *diff = (TshDiffRecord *) record;
+
+  tsh_diff_dialog_add (diff->dialog, diff->line, diff->len);
+
+  g_free (diff);
+}
+
+static void diff_push (TshDiffDialog *dialog, const gchar *line, gint len)
+{
+  TshDiffRecord *record;
+
+  record = g_malloc (sizeof (TshDiffRecord) + len);
+  record->parent.apply = diff_record_apply;
+  record->parent.free = NULL;
+  record->dialog = dialog;
+  record->len = len;
+  memcpy (record->line, line, len);
+  record->line[len] = '\0';
+  tsh_queue_push (TSH_RECORD (record));
+}
+
+#if CHECK_SVN_VERSION_G(1,9)
+typedef struct {
+  TshDiffDialog *dialog;
+  /* the start of a line that is not complete yet */
+  GString *line;
+} TshDiffSink;
+
+static svn_error_t *diff_sink_write (void *baton, const char *data, apr_size_t *len)
+{
+  TshDiffSink *sink = baton;
+  const char *end = data + *len;
+  const char *eol;
+
+  /* complete lines are queued straight from the buffer svn hands over */
+  while ((eol = memchr (data, '\n', end - data)))
+  {
+    eol++;
+    if (sink->line->len)
+    {
+      g_string_append_len (sink->line, data, eol - data);
+      diff_push (sink->dialog, sink->line->str, sink->line->len);
+      g_string_truncate (sink->line, 0);
+    }
+    else
+      diff_push (sink->dialog, data, eol - data);
+    data = eol;
+  }
+
+  if (data < end)
+    g_string_append_len (sink->line, data, end - data);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *diff_sink_close (void *baton)
+{
+  TshDiffSink *sink = baton;
+
+  /* the last line without a newline */
+  if (sink->line->len)
+  {
+    diff_push (sink->dialog, sink->line->str, sink->line->len);
+    g_string_truncate (sink->line, 0);
+  }
+
+  return SVN_NO_ERROR;
+}
+
+static svn_stream_t *diff_sink_new (TshDiffDialog *dialog, GString *line, apr_pool_t *pool)
+{
+  TshDiffSink *sink = apr_palloc (pool, sizeof (TshDiffSink));
+  svn_stream_t *stream;
+
+  sink->dialog = dialog;
+  sink->line = line;
+  g_string_truncate (line, 0);
+
+  stream = svn_stream_create (sink, pool);
+  svn_stream_set_write (stream, diff_sink_write);
+  svn_stream_set_close (stream, diff_sink_close);
+
+  return stream;
+}
+#endif
+
 static gpointer diff_thread (gpointer user_data)
 {
   struct thread_args *args = user_data;
@@ -65,12 +162,20 @@ static gpointer diff_thread (gpointer user_data)
   gchar **files = args->files;
   gint size, i;
   GtkWidget *error;
+#if CHECK_SVN_VERSION_G(1,9)
+  GString *line = g_string_new (NULL);
+#else
   apr_file_t *outfile;
   apr_file_t *errfile;
+#endif
 
   size = files?g_strv_length(files):0;
 
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+  gdk_threads_enter();
   tsh_diff_dialog_start(dialog);
+  gdk_threads_leave();
+G_GNUC_END_IGNORE_DEPRECATIONS
 
   subpool = svn_pool_create (pool);
 
@@ -90,6 +195,7 @@ static gpointer diff_thread (gpointer user_data)
     APR_ARRAY_PUSH (paths, const char *) = ""; // current directory
   }
 
+#if !CHECK_SVN_VERSION_G(1,9)
   err = svn_io_open_unique_file3(&outfile, NULL, NULL,
                                  svn_io_file_del_on_pool_cleanup,
                                  pool, subpool);
@@ -101,15 +207,13 @@ static gpointer diff_thread (gpointer user_data)
                                  pool, subpool);
   if (err)
     goto on_error;
+#endif
 
   for (i = 0; i < paths->nelts; i++)
   {
     const char *path = APR_ARRAY_IDX(paths, i, const char *);
     svn_opt_revision_t revision1;
     svn_opt_revision_t revision2;
-    apr_pool_t *iterpool;
-    apr_off_t pos;
-    svn_stream_t *stream;
 
     svn_pool_clear(subpool);
 
@@ -118,15 +222,28 @@ static gpointer diff_thread (gpointer user_data)
     revision2.kind = svn_opt_revision_working;
 
 #if CHECK_SVN_VERSION_G(1,9)
-    svn_stream_t *outstream = svn_stream_from_aprfile2(outfile, TRUE, pool);
-    svn_stream_t *errstream = svn_stream_from_aprfile2(errfile, TRUE, pool);
+    /* the lines go to the dialog while svn is writing them */
+    svn_stream_t *outstream = diff_sink_new(dialog, line, subpool);
+    svn_stream_t *errstream = svn_stream_empty(subpool);
 
     if ((err = svn_client_diff6(NULL, path, &revision1, path, &revision2,
                                 NULL, depth, !notice_ancestry, FALSE,
                                 no_diff_deleted, show_copies_as_adds,
                                 FALSE, FALSE, FALSE, FALSE, APR_LOCALE_CHARSET,
                                 outstream, errstream, NULL, ctx, subpool)))
-#elif CHECK_SVN_VERSION_G(1,7)
+    {
+      goto on_error;
+    }
+
+    err = svn_stream_close(outstream);
+    if (err)
+      goto on_error;
+#else
+    apr_pool_t *iterpool;
+    apr_off_t pos;
+    svn_stream_t *stream;
+
+#if CHECK_SVN_VERSION_G(1,7)
     if ((err = svn_client_diff5(NULL, path, &revision1, path, &revision2,
                                 NULL, depth, !notice_ancestry, no_diff_deleted,
                                 show_copies_as_adds, FALSE, FALSE, APR_LOCALE_CHARSET,
@@ -141,8 +258,7 @@ static gpointer diff_thread (gpointer user_data)
       goto on_error;
     }
 
-    /* XXX Slurps the entire diff into memory. Is there a way to
-     * make GTK display a file directly? */
+    /* older libraries only write to a file, read back what this path added */
     err = svn_io_file_flush_to_disk(outfile, subpool);
     if (err)
       goto on_error;
@@ -151,7 +267,7 @@ static gpointer diff_thread (gpointer user_data)
     if (err)
       goto on_error;
 
-    stream = svn_stream_from_aprfile2(outfile, FALSE, subpool);
+    stream = svn_stream_from_aprfile2(outfile, TRUE, subpool);
     iterpool = svn_pool_create(subpool);
     for (;;)
     {
@@ -169,18 +285,24 @@ static gpointer diff_thread (gpointer user_data)
 
       svn_stringbuf_appendcstr(buf, APR_EOL_STR);
 
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-      gdk_threads_enter();
-      tsh_diff_dialog_add(dialog, buf->data, buf->len);
-      gdk_threads_leave();
-G_GNUC_END_IGNORE_DEPRECATIONS
+      diff_push (dialog, buf->data, buf->len);
     }
     svn_pool_destroy(iterpool);
-    err = svn_stream_close(stream);
+
+    err = svn_io_file_trunc(outfile, 0, subpool);
     if (err)
       goto on_error;
+    pos = 0;
+    err = svn_io_file_seek(outfile, APR_SET, &pos, subpool);
+    if (err)
+      goto on_error;
+#endif
   }
   svn_pool_destroy (subpool);
+#if CHECK_SVN_VERSION_G(1,9)
+  g_string_free (line, TRUE);
+#endif
+  tsh_queue_flush ();
 
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
   gdk_threads_enter();
@@ -193,6 +315,10 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 
 on_error:
   svn_pool_destroy (subpool);
+#if CHECK_SVN_VERSION_G(1,9)
+  g_string_free (line, TRUE);
+#endif
+  tsh_queue_flush ();
   
   if (err->apr_err != SVN_ERR_CANCELLED)
   {
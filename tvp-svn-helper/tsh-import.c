@@ -83,6 +83,8 @@ static gpointer import_thread (gpointer user_data)
 
     error_str = tsh_strerror(err);
 
+    tsh_queue_flush ();
+
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
     gdk_threads_enter();
     tsh_notify_dialog_add(dialog, _("Failed"), error_str, NULL);
@@ -103,6 +105,8 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 
   svn_pool_destroy (subpool);
 
+  tsh_queue_flush ();
+
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
   gdk_threads_enter();
 #if CHECK_SVN_VERSION_S(1,6)
@@ -150,6 +154,7 @@ GThread *tsh_import (gchar **files, svn_client_ctx_t *ctx, apr_pool_t *pool)
 
 	ctx->notify_func2 = tsh_notify_func2;
 	ctx->notify_baton2 = dialog;
+	tsh_progress_start (ctx, dialog);
 
 	args = g_malloc (sizeof (struct thread_args));
 	args->ctx = ctx;
@@ -0,0 +1,434 @@
+/*-
+ * Copyright (C) 2007-2011  Peter de Ridder <peter@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <subversion-1/svn_client.h>
+#include <subversion-1/svn_dirent_uri.h>
+#include <subversion-1/svn_path.h>
+#include <subversion-1/svn_pools.h>
+#include <subversion-1/svn_props.h>
+
+#include "tsh-common.h"
+
+#include "tsh-log-cache.h"
+
+/* revision, author, date, message and the changed paths */
+#define TSH_LOG_ENTRY_TYPE "(xmsmsmsa(ys))"
+/* the range covered after the batch and the entries it added */
+#define TSH_LOG_BATCH_TYPE "(xxa" TSH_LOG_ENTRY_TYPE ")"
+
+struct _TshLogCache
+{
+  gchar *filename;
+  /* newest first */
+  GPtrArray *entries;
+  /* received, but not yet known to be complete */
+  GPtrArray *pending;
+  /* every revision from low up to high is in entries */
+  svn_revnum_t low;
+  svn_revnum_t high;
+};
+
+static svn_revnum_t
+log_entry_revision (GVariant *entry)
+{
+  gint64 revision;
+
+  g_variant_get_child (entry, 0, "x", &revision);
+
+  return revision;
+}
+
+/* Index of the first entry not newer than revision */
+static guint
+log_cache_find (TshLogCache *cache, svn_revnum_t revision)
+{
+  guint low = 0, high = cache->entries->len;
+
+  while (low < high)
+  {
+    guint mid = low + (high - low) / 2;
+
+    if (log_entry_revision (g_ptr_array_index (cache->entries, mid)) > revision)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+/* Move the pending entries into the cache, which now covers low up to high */
+static void
+log_cache_merge (TshLogCache *cache, svn_revnum_t low, svn_revnum_t high)
+{
+  GPtrArray *entries, *pending = cache->pending;
+  guint i = 0, j = 0;
+
+  entries = g_ptr_array_new_full (cache->entries->len + pending->len, (GDestroyNotify) g_variant_unref);
+
+  while (i < cache->entries->len || j < pending->len)
+  {
+    GVariant *entry;
+
+    if (j == pending->len)
+      entry = g_ptr_array_index (cache->entries, i++);
+    else if (i == cache->entries->len)
+      entry = g_ptr_array_index (pending, j++);
+    else if (log_entry_revision (g_ptr_array_index (cache->entries, i)) > log_entry_revision (g_ptr_array_index (pending, j)))
+      entry = g_ptr_array_index (cache->entries, i++);
+    else
+      entry = g_ptr_array_index (pending, j++);
+
+    /* the ranges overlap at their ends */
+    if (entries->len && log_entry_revision (g_ptr_array_index (entries, entries->len - 1)) == log_entry_revision (entry))
+      continue;
+
+    g_ptr_array_add (entries, g_variant_ref (entry));
+  }
+
+  g_ptr_array_free (cache->entries, TRUE);
+  cache->entries = entries;
+  g_ptr_array_set_size (pending, 0);
+
+  cache->low = low;
+  cache->high = high;
+}
+
+static void
+log_cache_load (TshLogCache *cache)
+{
+  gchar *contents;
+  gsize length, offset = 0, good = 0;
+
+  if (!g_file_get_contents (cache->filename, &contents, &length, NULL))
+    return;
+
+  while (length - offset >= sizeof (guint32))
+  {
+    GVariant *batch, *entries;
+    gint64 low, high;
+    guint32 size;
+    gpointer data;
+    gsize i, n;
+
+    memcpy (&size, contents + offset, sizeof (guint32));
+    size = GUINT32_FROM_LE (size);
+    offset += sizeof (guint32);
+
+    /* a batch cut short by a crash */
+    if (size > length - offset)
+      break;
+
+    data = g_malloc (size);
+    memcpy (data, contents + offset, size);
+    batch = g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE (TSH_LOG_BATCH_TYPE), data, size, FALSE, g_free, data));
+    offset += size;
+
+    /* garbage would otherwise be read as empty values */
+    if (!g_variant_is_normal_form (batch))
+    {
+      g_variant_unref (batch);
+      break;
+    }
+    good = offset;
+
+    g_variant_get (batch, "(xx@a" TSH_LOG_ENTRY_TYPE ")", &low, &high, &entries);
+    n = g_variant_n_children (entries);
+    for (i = 0; i < n; i++)
+      g_ptr_array_add (cache->pending, g_variant_get_child_value (entries, i));
+    g_variant_unref (entries);
+    g_variant_unref (batch);
+
+    log_cache_merge (cache, low, high);
+  }
+
+  /* the next batch is appended, so it must not end up behind the bad bytes */
+  if (good < length && truncate (cache->filename, good) < 0)
+    g_warning ("Failed to truncate %s: %s", cache->filename, g_strerror (errno));
+
+  g_free (contents);
+}
+
+TshLogCache *
+tsh_log_cache_open (apr_array_header_t *paths, gboolean strict_history, svn_client_ctx_t *ctx, apr_pool_t *pool)
+{
+#if CHECK_SVN_VERSION_G(1,8)
+  TshLogCache *cache;
+  GString *key;
+  const char *uuid = NULL;
+  gchar *checksum, *dirname;
+  svn_error_t *err;
+  int i;
+
+  /* the same log asked for through another working copy shares the cache */
+  key = g_string_new (strict_history ? "strict\n" : "\n");
+  for (i = 0; i < paths->nelts; i++)
+  {
+    const char *path = APR_ARRAY_IDX (paths, i, const char *);
+    const char *url;
+
+    if (!svn_path_is_url (path))
+    {
+      if ((err = svn_dirent_get_absolute (&path, path, pool)))
+      {
+        svn_error_clear (err);
+        g_string_free (key, TRUE);
+        return NULL;
+      }
+    }
+
+    if ((err = svn_client_url_from_path2 (&url, path, ctx, pool, pool)) ||
+        (!uuid && (err = svn_client_get_repos_root (NULL, &uuid, path, ctx, pool, pool))))
+    {
+      svn_error_clear (err);
+      g_string_free (key, TRUE);
+      return NULL;
+    }
+
+    if (!url || !uuid)
+    {
+      g_string_free (key, TRUE);
+      return NULL;
+    }
+
+    g_string_append (key, url);
+    g_string_append_c (key, '\n');
+  }
+
+  dirname = g_build_filename (g_get_user_cache_dir (), PACKAGE, "svn-log", uuid, NULL);
+  if (g_mkdir_with_parents (dirname, 0700))
+  {
+    g_free (dirname);
+    g_string_free (key, TRUE);
+    return NULL;
+  }
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key->str, key->len);
+  g_string_free (key, TRUE);
+
+  cache = g_new0 (TshLogCache, 1);
+  cache->filename = g_build_filename (dirname, checksum, NULL);
+  cache->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+  cache->pending = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+  cache->low = SVN_INVALID_REVNUM;
+  cache->high = SVN_INVALID_REVNUM;
+
+  g_free (checksum);
+  g_free (dirname);
+
+  log_cache_load (cache);
+
+  return cache;
+#else
+  /* no way to get the repository uuid of a path */
+  return NULL;
+#endif
+}
+
+void
+tsh_log_cache_free (TshLogCache *cache)
+{
+  g_ptr_array_free (cache->entries, TRUE);
+  g_ptr_array_free (cache->pending, TRUE);
+  g_free (cache->filename);
+  g_free (cache);
+}
+
+svn_revnum_t
+tsh_log_cache_get_low (TshLogCache *cache)
+{
+  return cache->low;
+}
+
+svn_revnum_t
+tsh_log_cache_get_high (TshLogCache *cache)
+{
+  return cache->high;
+}
+
+guint
+tsh_log_cache_count_below (TshLogCache *cache, svn_revnum_t revision)
+{
+  return cache->entries->len - log_cache_find (cache, revision);
+}
+
+void
+tsh_log_cache_add (TshLogCache *cache, svn_log_entry_t *log_entry, apr_pool_t *pool)
+{
+  GVariantBuilder files;
+  svn_string_t *value;
+  gchar *author = NULL;
+  gchar *date = NULL;
+  gchar *message = NULL;
+
+  if (log_entry->revprops)
+  {
+    value = apr_hash_get (log_entry->revprops, SVN_PROP_REVISION_AUTHOR, APR_HASH_KEY_STRING);
+    if (value)
+      author = g_strndup (value->data, value->len);
+
+    value = apr_hash_get (log_entry->revprops, SVN_PROP_REVISION_DATE, APR_HASH_KEY_STRING);
+    if (value)
+      date = g_strndup (value->data, value->len);
+
+    value = apr_hash_get (log_entry->revprops, SVN_PROP_REVISION_LOG, APR_HASH_KEY_STRING);
+    if (value)
+      message = g_strndup (value->data, value->len);
+  }
+
+  g_variant_builder_init (&files, G_VARIANT_TYPE ("a(ys)"));
+  if (log_entry->changed_paths)
+  {
+    apr_hash_index_t *hi;
+
+    /* the receiver's pool is cleared for every revision */
+    for (hi = apr_hash_first (pool, log_entry->changed_paths); hi; hi = apr_hash_next (hi))
+    {
+      const svn_log_changed_path_t *changed;
+      const char *path;
+
+      apr_hash_this (hi, (const void**)&path, NULL, (void**)&changed);
+      g_variant_builder_add (&files, "(ys)", (guchar) changed->action, path);
+    }
+  }
+
+  g_ptr_array_add (cache->pending, g_variant_ref_sink (g_variant_new ("(xmsmsms@a(ys))", (gint64) log_entry->revision, author, date, message, g_variant_builder_end (&files))));
+
+  g_free (author);
+  g_free (date);
+  g_free (message);
+}
+
+/* Store the pending entries, the cache now covers low up to high */
+void
+tsh_log_cache_commit (TshLogCache *cache, svn_revnum_t low, svn_revnum_t high)
+{
+  GVariantBuilder builder;
+  GVariant *batch;
+  guint32 size;
+  gchar *buffer;
+  gsize length;
+  int fd;
+  guint i;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" TSH_LOG_ENTRY_TYPE));
+  for (i = 0; i < cache->pending->len; i++)
+    g_variant_builder_add_value (&builder, g_ptr_array_index (cache->pending, i));
+  batch = g_variant_ref_sink (g_variant_new ("(xx@a" TSH_LOG_ENTRY_TYPE ")", (gint64) low, (gint64) high, g_variant_builder_end (&builder)));
+
+  /* batches are only ever appended, a torn one is cut off on load */
+  fd = g_open (cache->filename, O_WRONLY | O_APPEND | O_CREAT, 0666);
+  if (fd >= 0)
+  {
+    /* the size and the data in a single write, so concurrent helpers
+     * can not interleave them */
+    length = sizeof (guint32) + g_variant_get_size (batch);
+    buffer = g_malloc (length);
+    size = GUINT32_TO_LE (g_variant_get_size (batch));
+    memcpy (buffer, &size, sizeof (guint32));
+    memcpy (buffer + sizeof (guint32), g_variant_get_data (batch), g_variant_get_size (batch));
+
+    if (write (fd, buffer, length) < 0)
+      g_warning ("Failed to write %s: %s", cache->filename, g_strerror (errno));
+
+    g_free (buffer);
+    close (fd);
+  }
+
+  g_variant_unref (batch);
+
+  log_cache_merge (cache, low, high);
+}
+
+/* Forget the entries of a request that did not finish */
+void
+tsh_log_cache_rollback (TshLogCache *cache)
+{
+  g_ptr_array_set_size (cache->pending, 0);
+}
+
+/* Pass at most limit entries, starting at revision, to receiver, as svn_client_log would */
+svn_error_t *
+tsh_log_cache_replay (TshLogCache *cache, svn_revnum_t revision, gint limit, svn_log_entry_receiver_t receiver, void *baton, apr_pool_t *pool)
+{
+  svn_error_t *err = SVN_NO_ERROR;
+  apr_pool_t *iterpool;
+  guint i;
+
+  iterpool = svn_pool_create (pool);
+
+  for (i = log_cache_find (cache, revision); i < cache->entries->len && limit > 0; i++, limit--)
+  {
+    svn_log_entry_t *log_entry;
+    const gchar *author, *date, *message;
+    GVariantIter *files;
+    const gchar *path;
+    guchar action;
+    gint64 number;
+
+    svn_pool_clear (iterpool);
+
+    g_variant_get (g_ptr_array_index (cache->entries, i), "(xm&sm&sm&sa(ys))", &number, &author, &date, &message, &files);
+
+    log_entry = svn_log_entry_create (iterpool);
+    log_entry->revision = number;
+    log_entry->revprops = apr_hash_make (iterpool);
+    if (author)
+      apr_hash_set (log_entry->revprops, SVN_PROP_REVISION_AUTHOR, APR_HASH_KEY_STRING, svn_string_create (author, iterpool));
+    if (date)
+      apr_hash_set (log_entry->revprops, SVN_PROP_REVISION_DATE, APR_HASH_KEY_STRING, svn_string_create (date, iterpool));
+    if (message)
+      apr_hash_set (log_entry->revprops, SVN_PROP_REVISION_LOG, APR_HASH_KEY_STRING, svn_string_create (message, iterpool));
+
+    log_entry->changed_paths = apr_hash_make (iterpool);
+    while (g_variant_iter_next (files, "(y&s)", &action, &path))
+    {
+      svn_log_changed_path_t *changed = apr_pcalloc (iterpool, sizeof (svn_log_changed_path_t));
+
+      changed->action = action;
+      changed->copyfrom_rev = SVN_INVALID_REVNUM;
+      apr_hash_set (log_entry->changed_paths, apr_pstrdup (iterpool, path), APR_HASH_KEY_STRING, changed);
+    }
+    g_variant_iter_free (files);
+
+    if ((err = receiver (baton, log_entry, iterpool)))
+      break;
+  }
+
+  svn_pool_destroy (iterpool);
+
+  return err;
+}
@@ -0,0 +1,41 @@
+/*-
+ * Copyright (C) 2007-2011  Peter de Ridder <peter@xfce.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __TSH_LOG_CACHE_H__
+#define __TSH_LOG_CACHE_H__
+
+G_BEGIN_DECLS
+
+typedef struct _TshLogCache TshLogCache;
+
+TshLogCache  *tsh_log_cache_open        (apr_array_header_t *, gboolean, svn_client_ctx_t *, apr_pool_t *);
+void          tsh_log_cache_free        (TshLogCache *);
+
+svn_revnum_t  tsh_log_cache_get_low     (TshLogCache *);
+svn_revnum_t  tsh_log_cache_get_high    (TshLogCache *);
+guint         tsh_log_cache_count_below (TshLogCache *, svn_revnum_t);
+
+void          tsh_log_cache_add         (TshLogCache *, svn_log_entry_t *, apr_pool_t *);
+void          tsh_log_cache_commit      (TshLogCache *, svn_revnum_t, svn_revnum_t);
+void          tsh_log_cache_rollback    (TshLogCache *);
+
+svn_error_t  *tsh_log_cache_replay      (TshLogCache *, svn_revnum_t, gint, svn_log_entry_receiver_t, void *, apr_pool_t *);
+
+G_END_DECLS
+
+#endif /*__TSH_LOG_CACHE_H__*/
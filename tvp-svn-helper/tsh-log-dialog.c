@@ -32,6 +32,8 @@
 static void selection_changed (GtkTreeView*, gpointer);
 static void cancel_clicked (GtkButton*, gpointer);
 static void refresh_clicked (GtkButton*, gpointer);
+static void adjustment_changed (GtkAdjustment*, gpointer);
+static gboolean check_more (gpointer);
 
 static void move_info (GtkTreeStore*, GtkTreeIter*, GtkTreeIter*);
 
@@ -49,6 +51,9 @@ struct _TshLogDialog
 	GtkWidget *refresh;
 
   GSList *message_stack;
+
+  /* older revisions can be loaded */
+  gboolean more;
 };
 
 struct _TshLogDialogClass
@@ -61,6 +66,7 @@ G_DEFINE_TYPE (TshLogDialog, tsh_log_dialog, GTK_TYPE_DIALOG)
 enum {
   SIGNAL_CANCEL = 0,
   SIGNAL_REFRESH,
+  SIGNAL_MORE,
   SIGNAL_COUNT
 };
 
@@ -81,6 +87,12 @@ tsh_log_dialog_class_init (TshLogDialogClass *klass)
     0, NULL, NULL,
     g_cclosure_marshal_VOID__VOID,
     G_TYPE_NONE, 0);
+  signals[SIGNAL_MORE] = g_signal_new("more-requested",
+    G_OBJECT_CLASS_TYPE (klass),
+    G_SIGNAL_RUN_FIRST | G_SIGNAL_ACTION,
+    0, NULL, NULL,
+    g_cclosure_marshal_VOID__VOID,
+    G_TYPE_NONE, 0);
 }
 
 enum {
@@ -154,6 +166,8 @@ tsh_log_dialog_init (TshLogDialog *dialog)
 	g_object_unref (model);
 
   g_signal_connect (G_OBJECT (tree_view), "cursor-changed", G_CALLBACK (selection_changed), dialog);
+  g_signal_connect (gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tree_view)), "value-changed", G_CALLBACK (adjustment_changed), dialog);
+  g_signal_connect (gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tree_view)), "changed", G_CALLBACK (adjustment_changed), dialog);
 
 	gtk_container_add (GTK_CONTAINER (scroll_window), tree_view);
   gtk_paned_pack1 (GTK_PANED(pane), scroll_window, TRUE, FALSE);
@@ -352,6 +366,23 @@ tsh_log_dialog_done (TshLogDialog *dialog)
 
   gtk_widget_hide (dialog->cancel);
   gtk_widget_show (dialog->refresh);
+
+  /* the page may not fill the view, check from the main loop as loading
+   * the next page joins the log thread calling this */
+  if (dialog->more)
+  {
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    gdk_threads_add_idle (check_more, g_object_ref (dialog));
+G_GNUC_END_IGNORE_DEPRECATIONS
+  }
+}
+
+void
+tsh_log_dialog_set_more (TshLogDialog *dialog, gboolean more)
+{
+  g_return_if_fail (TSH_IS_LOG_DIALOG (dialog));
+
+  dialog->more = more;
 }
 
 gboolean
@@ -370,6 +401,47 @@ tsh_log_dialog_get_show_merged (TshLogDialog *dialog)
   return gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->merged_revisions));
 }
 
+static void
+request_more (TshLogDialog *dialog)
+{
+  GtkAdjustment *adjustment;
+
+  /* nothing older, or a page is still loading */
+  if (!dialog->more || gtk_widget_get_visible (dialog->cancel))
+    return;
+
+  adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (dialog->tree_view));
+
+  /* load the next page once the end is less than a page away */
+  if (gtk_adjustment_get_value (adjustment) + 2 * gtk_adjustment_get_page_size (adjustment) < gtk_adjustment_get_upper (adjustment))
+    return;
+
+  dialog->more = FALSE;
+
+  gtk_widget_hide (dialog->refresh);
+  gtk_widget_show (dialog->cancel);
+
+  g_signal_emit (dialog, signals[SIGNAL_MORE], 0);
+}
+
+static gboolean
+check_more (gpointer user_data)
+{
+  TshLogDialog *dialog = TSH_LOG_DIALOG (user_data);
+
+  request_more (dialog);
+
+  g_object_unref (dialog);
+
+  return FALSE;
+}
+
+static void
+adjustment_changed (GtkAdjustment *adjustment, gpointer user_data)
+{
+  request_more (TSH_LOG_DIALOG (user_data));
+}
+
 static void
 selection_changed (GtkTreeView *tree_view, gpointer user_data)
 {
@@ -425,6 +497,8 @@ refresh_clicked (GtkButton *button, gpointer user_data)
 	gtk_widget_hide (dialog->refresh);
 	gtk_widget_show (dialog->cancel);
 
+  dialog->more = FALSE;
+
   g_signal_emit (dialog, signals[SIGNAL_REFRESH], 0);
 
 	model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->tree_view));
@@ -59,6 +59,8 @@ void         tsh_log_dialog_push     (TshLogDialog *dialog,
 const gchar* tsh_log_dialog_top      (TshLogDialog *dialog);
 void         tsh_log_dialog_pop      (TshLogDialog *dialog);
 void         tsh_log_dialog_done     (TshLogDialog *dialog);
+void         tsh_log_dialog_set_more (TshLogDialog *dialog,
+                                      gboolean more);
 
 gboolean tsh_log_dialog_get_hide_copied (TshLogDialog *dialog);
 gboolean tsh_log_dialog_get_show_merged (TshLogDialog *dialog);
@@ -36,42 +36,211 @@
 #include "tsh-common.h"
 #include "tsh-dialog-common.h"
 #include "tsh-log-dialog.h"
+#include "tsh-log-cache.h"
 
 #include "tsh-log.h"
 
+/* revisions fetched at once */
+#define TSH_LOG_PAGE_SIZE 100
+
 struct thread_args {
 	svn_client_ctx_t *ctx;
 	apr_pool_t *pool;
 	TshLogDialog *dialog;
 	gchar **files;
 	apr_array_header_t *paths;
+	/* newest revision of the next page, invalid for HEAD */
+	svn_revnum_t next;
+	gboolean strict_history;
+	gboolean merged_revisions;
+	TshLogCache *cache;
 };
 
-static gpointer log_thread (gpointer user_data)
+struct log_baton {
+	TshLogDialog *dialog;
+	/* store the entries instead of showing them */
+	TshLogCache *cache;
+	gint depth;
+	gint count;
+	svn_revnum_t first;
+	svn_revnum_t last;
+};
+
+static svn_error_t *log_receiver (void *baton, svn_log_entry_t *log_entry, apr_pool_t *pool)
+{
+  struct log_baton *log = baton;
+
+  if (log_entry->revision == SVN_INVALID_REVNUM)
+    log->depth--;
+  else
+  {
+    /* merged revisions don't count for the limit */
+    if (!log->depth)
+    {
+      if (!log->count++)
+        log->first = log_entry->revision;
+      log->last = log_entry->revision;
+
+      if (log->cache)
+        tsh_log_cache_add (log->cache, log_entry, pool);
+    }
+
+    if (log_entry->has_children)
+      log->depth++;
+  }
+
+  if (log->cache)
+    return SVN_NO_ERROR;
+
+  return tsh_log_func (log->dialog, log_entry, pool);
+}
+
+static svn_error_t *log_fetch (struct thread_args *args, struct log_baton *log, svn_revnum_t start, svn_revnum_t end, int limit, apr_pool_t *pool)
 {
-	struct thread_args *args = user_data;
   svn_opt_revision_t revision;
   svn_opt_revision_range_t range;
+	apr_array_header_t *ranges;
+	apr_array_header_t *revprops;
+
+  log->depth = 0;
+  log->count = 0;
+  log->first = SVN_INVALID_REVNUM;
+  log->last = SVN_INVALID_REVNUM;
+
+  revprops = apr_array_make (pool, 3, sizeof (const char*));
+  APR_ARRAY_PUSH (revprops, const char*) = SVN_PROP_REVISION_AUTHOR;
+  APR_ARRAY_PUSH (revprops, const char*) = SVN_PROP_REVISION_DATE;
+  APR_ARRAY_PUSH (revprops, const char*) = SVN_PROP_REVISION_LOG;
+
+  revision.kind = svn_opt_revision_unspecified;
+  if (SVN_IS_VALID_REVNUM (start))
+  {
+    range.start.kind = svn_opt_revision_number;
+    range.start.value.number = start;
+  }
+  else
+    range.start.kind = svn_opt_revision_head;
+  range.end.kind = svn_opt_revision_number;
+  range.end.value.number = end;
+  ranges = apr_array_make (pool, 1, sizeof (svn_opt_revision_range_t *));
+  APR_ARRAY_PUSH (ranges, svn_opt_revision_range_t *) = &range;
+#if CHECK_SVN_VERSION(1,5)
+	return svn_client_log4(args->paths, &revision, &range.start, &range.end, limit, TRUE, args->strict_history, args->merged_revisions, revprops, log_receiver, log, args->ctx, pool);
+#else /* CHECK_SVN_VERSION(1,6) */
+	return svn_client_log5(args->paths, &revision, ranges, limit, TRUE, args->strict_history, args->merged_revisions, revprops, log_receiver, log, args->ctx, pool);
+#endif
+}
+
+/* Show the next page from the cache, only asking the server for what it misses */
+static svn_error_t *log_page_cached (struct thread_args *args, struct log_baton *log, gboolean *more, apr_pool_t *pool)
+{
+  TshLogCache *cache = args->cache;
+	svn_error_t *err;
+  svn_revnum_t high;
+
+  log->cache = cache;
+
+  if (!SVN_IS_VALID_REVNUM (args->next))
+  {
+    high = tsh_log_cache_get_high (cache);
+
+    if (!SVN_IS_VALID_REVNUM (high))
+    {
+      if ((err = log_fetch (args, log, SVN_INVALID_REVNUM, 0, TSH_LOG_PAGE_SIZE, pool)))
+      {
+        tsh_log_cache_rollback (cache);
+        return err;
+      }
+      tsh_log_cache_commit (cache, log->count == TSH_LOG_PAGE_SIZE ? log->last : 0, log->count ? log->first : 0);
+    }
+    else
+    {
+      /* only the revisions committed since the last time */
+      if ((err = log_fetch (args, log, SVN_INVALID_REVNUM, high, 0, pool)))
+      {
+        tsh_log_cache_rollback (cache);
+        return err;
+      }
+      tsh_log_cache_commit (cache, tsh_log_cache_get_low (cache), log->count ? MAX (log->first, high) : high);
+    }
+
+    args->next = tsh_log_cache_get_high (cache);
+  }
+
+  /* fill the cache up to a full page */
+  while (tsh_log_cache_count_below (cache, args->next) < TSH_LOG_PAGE_SIZE && tsh_log_cache_get_low (cache) > 0)
+  {
+    if ((err = log_fetch (args, log, tsh_log_cache_get_low (cache) - 1, 0, TSH_LOG_PAGE_SIZE, pool)))
+    {
+      tsh_log_cache_rollback (cache);
+      return err;
+    }
+    tsh_log_cache_commit (cache, log->count == TSH_LOG_PAGE_SIZE ? log->last : 0, tsh_log_cache_get_high (cache));
+  }
+
+  log->cache = NULL;
+  log->depth = 0;
+  log->count = 0;
+  log->last = SVN_INVALID_REVNUM;
+
+  if ((err = tsh_log_cache_replay (cache, args->next, TSH_LOG_PAGE_SIZE, log_receiver, log, pool)))
+    return err;
+
+  *more = FALSE;
+  if (log->count)
+  {
+    args->next = log->last - 1;
+    *more = args->next >= 0 && (tsh_log_cache_count_below (cache, args->next) || tsh_log_cache_get_low (cache) > 0);
+  }
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *log_page (struct thread_args *args, struct log_baton *log, gboolean *more, apr_pool_t *pool)
+{
+	svn_error_t *err;
+
+  log->cache = NULL;
+
+  if ((err = log_fetch (args, log, args->next, 0, TSH_LOG_PAGE_SIZE, pool)))
+    return err;
+
+  *more = FALSE;
+  if (log->count)
+  {
+    args->next = log->last - 1;
+    *more = log->count == TSH_LOG_PAGE_SIZE && args->next >= 0;
+  }
+
+  return SVN_NO_ERROR;
+}
+
+static gpointer log_thread (gpointer user_data)
+{
+	struct thread_args *args = user_data;
 	svn_error_t *err;
 	svn_client_ctx_t *ctx = args->ctx;
 	apr_pool_t *subpool, *pool = args->pool;
 	TshLogDialog *dialog = args->dialog;
 	gchar **files = args->files;
 	apr_array_header_t *paths = args->paths;
-	apr_array_header_t *ranges;
-	apr_array_header_t *revprops;
+	struct log_baton log;
 	gint size, i;
-  gboolean strict_history;
-  gboolean merged_revisions;
+  gboolean first_page = !SVN_IS_VALID_REVNUM (args->next);
+  gboolean more = FALSE;
   GtkWidget *error;
   gchar *error_str;
 
+  /* the following pages keep the options of the first one */
+  if (first_page)
+  {
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-  gdk_threads_enter ();
-  strict_history = tsh_log_dialog_get_hide_copied (dialog);
-  merged_revisions = tsh_log_dialog_get_show_merged (dialog);
-  gdk_threads_leave ();
+    gdk_threads_enter ();
+    args->strict_history = tsh_log_dialog_get_hide_copied (dialog);
+    args->merged_revisions = tsh_log_dialog_get_show_merged (dialog);
+    gdk_threads_leave ();
 G_GNUC_END_IGNORE_DEPRECATIONS
+  }
 
   if(!paths)
   {
@@ -98,24 +267,27 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 
   subpool = svn_pool_create (pool);
 
-  revprops = apr_array_make (subpool, 3, sizeof (const char*));
-  APR_ARRAY_PUSH (revprops, const char*) = SVN_PROP_REVISION_AUTHOR;
-  APR_ARRAY_PUSH (revprops, const char*) = SVN_PROP_REVISION_DATE;
-  APR_ARRAY_PUSH (revprops, const char*) = SVN_PROP_REVISION_LOG;
+  /* the cache follows the history of the paths, without merges */
+  if (first_page)
+  {
+    if (args->cache)
+      tsh_log_cache_free (args->cache);
+    args->cache = NULL;
+    if (!args->merged_revisions)
+      args->cache = tsh_log_cache_open (paths, args->strict_history, ctx, subpool);
+  }
 
-  revision.kind = svn_opt_revision_unspecified;
-  range.start.kind = svn_opt_revision_head;
-  range.end.kind = svn_opt_revision_number;
-  range.end.value.number = 0;
-  ranges = apr_array_make (subpool, 1, sizeof (svn_opt_revision_range_t *));
-  APR_ARRAY_PUSH (ranges, svn_opt_revision_range_t *) = &range;
-#if CHECK_SVN_VERSION(1,5)
-	if ((err = svn_client_log4(paths, &revision, &range.start, &range.end, 0, TRUE, strict_history, merged_revisions, revprops, tsh_log_func, dialog, ctx, subpool)))
-#else /* CHECK_SVN_VERSION(1,6) */
-	if ((err = svn_client_log5(paths, &revision, ranges, 0, TRUE, strict_history, merged_revisions, revprops, tsh_log_func, dialog, ctx, subpool)))
-#endif
+  log.dialog = dialog;
+
+  if (args->cache)
+    err = log_page_cached (args, &log, &more, subpool);
+  else
+    err = log_page (args, &log, &more, subpool);
+
+	if (err)
 	{
     svn_pool_destroy (subpool);
+    tsh_queue_flush ();
 
     error_str = tsh_strerror(err);
 
@@ -141,9 +313,11 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 	}
 
   svn_pool_destroy (subpool);
+  tsh_queue_flush ();
 
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
 	gdk_threads_enter();
+	tsh_log_dialog_set_more (dialog, more);
 	tsh_log_dialog_done (dialog);
   gdk_threads_leave();
 G_GNUC_END_IGNORE_DEPRECATIONS
@@ -153,6 +327,20 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 }
 
 static void create_log_thread(TshLogDialog *dialog, struct thread_args *args)
+{
+	GThread *thread;
+
+  /* start over at HEAD */
+  args->next = SVN_INVALID_REVNUM;
+
+	thread = g_thread_new (NULL, log_thread, args);
+  if (thread)
+    tsh_replace_thread (thread);
+  else
+    tsh_log_dialog_done (dialog);
+}
+
+static void create_more_thread(TshLogDialog *dialog, struct thread_args *args)
 {
 	GThread *thread = g_thread_new (NULL, log_thread, args);
   if (thread)
@@ -179,8 +367,11 @@ GThread *tsh_log (gchar **files, svn_client_ctx_t *ctx, apr_pool_t *pool)
 	args->dialog = TSH_LOG_DIALOG (dialog);
 	args->files = files;
   args->paths = NULL;
+  args->next = SVN_INVALID_REVNUM;
+  args->cache = NULL;
 
   g_signal_connect(dialog, "refresh-clicked", G_CALLBACK(create_log_thread), args);
+  g_signal_connect(dialog, "more-requested", G_CALLBACK(create_more_thread), args);
 
 	return g_thread_new (NULL, log_thread, args);
 }
@@ -32,8 +32,14 @@ struct _TshNotifyDialog
 	GtkDialog dialog;
 
 	GtkWidget *tree_view;
+	GtkWidget *progress;
 	GtkWidget *close;
 	GtkWidget *cancel;
+
+  /* the previous sample, to compute the rate from */
+  gint64 progress_bytes;
+  gint64 progress_time;
+  gdouble rate;
 };
 
 struct _TshNotifyDialogClass
@@ -111,6 +117,11 @@ tsh_notify_dialog_init (TshNotifyDialog *dialog)
 	gtk_widget_show (tree_view);
 	gtk_widget_show (scroll_window);
 
+	/* only shown once something was transferred */
+	dialog->progress = gtk_label_new (NULL);
+	gtk_widget_set_halign (dialog->progress, GTK_ALIGN_START);
+	gtk_box_pack_start (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), dialog->progress, FALSE, FALSE, 0);
+
 	gtk_window_set_title (GTK_WINDOW (dialog), _("Notification"));
 
 	dialog->close = button = gtk_dialog_add_button (GTK_DIALOG (dialog), _("_Close"), GTK_RESPONSE_CLOSE);
@@ -168,6 +179,49 @@ tsh_notify_dialog_add (TshNotifyDialog *dialog, const char *action, const char *
 	gtk_tree_path_free (path);
 }
 
+void
+tsh_notify_dialog_set_progress (TshNotifyDialog *dialog, gint64 bytes, gint64 total)
+{
+  gint64 now = g_get_monotonic_time ();
+  gchar *size, *rate, *text;
+
+  g_return_if_fail (TSH_IS_NOTIFY_DIALOG (dialog));
+
+  if (bytes <= 0)
+    return;
+
+  if (dialog->progress_time)
+  {
+    gdouble sample = (bytes - dialog->progress_bytes) * (gdouble) G_USEC_PER_SEC / MAX (now - dialog->progress_time, 1);
+
+    /* smooth out the bursts of the network */
+    dialog->rate = dialog->rate > 0 ? 0.8 * dialog->rate + 0.2 * sample : sample;
+  }
+  dialog->progress_bytes = bytes;
+  dialog->progress_time = now;
+
+  size = g_format_size (bytes);
+  rate = g_format_size ((guint64) dialog->rate);
+
+  if (total > bytes && dialog->rate >= 1)
+  {
+    gchar *total_size = g_format_size (total);
+    gint64 left = (total - bytes) / dialog->rate;
+
+    text = g_strdup_printf (_("%s of %s transferred (%s/s), %d:%02d left"), size, total_size, rate, (gint) (left / 60), (gint) (left % 60));
+    g_free (total_size);
+  }
+  else
+    text = g_strdup_printf (_("%s transferred (%s/s)"), size, rate);
+
+  gtk_label_set_text (GTK_LABEL (dialog->progress), text);
+  gtk_widget_show (dialog->progress);
+
+  g_free (text);
+  g_free (rate);
+  g_free (size);
+}
+
 void
 tsh_notify_dialog_done (TshNotifyDialog *dialog)
 {
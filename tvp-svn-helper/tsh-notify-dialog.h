@@ -43,6 +43,9 @@ void       tsh_notify_dialog_add      (TshNotifyDialog *dialog,
                                        const char *action,
                                        const char *path,
                                        const char *mime_type);
+void       tsh_notify_dialog_set_progress (TshNotifyDialog *dialog,
+                                           gint64 bytes,
+                                           gint64 total);
 void       tsh_notify_dialog_done     (TshNotifyDialog *dialog);
 
 G_END_DECLS;
@@ -72,6 +72,8 @@ static gpointer resolved_thread (gpointer user_data)
       {
         error_str = tsh_strerror(err);
 
+        tsh_queue_flush ();
+
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
         gdk_threads_enter();
         tsh_notify_dialog_add(dialog, _("Failed"), error_str, NULL);
@@ -92,6 +94,8 @@ G_GNUC_END_IGNORE_DEPRECATIONS
     {
       error_str = tsh_strerror(err);
 
+      tsh_queue_flush ();
+
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
       gdk_threads_enter();
       tsh_notify_dialog_add(dialog, _("Failed"), error_str, NULL);
@@ -107,6 +111,8 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 
   svn_pool_destroy (subpool);
 
+	tsh_queue_flush ();
+
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
 	gdk_threads_enter();
 	tsh_notify_dialog_done (dialog);
@@ -45,62 +45,137 @@ struct thread_args {
 	gchar **files;
 };
 
+/* status crawls running at the same time */
+#define TSH_STATUS_MAX_WORKERS 4
+
+struct status_run {
+	TshStatusDialog *dialog;
+	svn_depth_t depth;
+	gboolean get_all;
+	gboolean update;
+	gboolean no_ignore;
+	gboolean ignore_externals;
+	GMutex lock;
+	/* the first error, the other targets keep going */
+	gchar *error_str;
+};
+
+static svn_error_t *status_target (svn_client_ctx_t *ctx, const gchar *path, struct status_run *run, apr_pool_t *pool)
+{
+  svn_opt_revision_t revision;
+
+  revision.kind = svn_opt_revision_head;
+
+#if CHECK_SVN_VERSION_G(1,9)
+  return svn_client_status6(NULL, ctx, path, &revision, run->depth,
+                            run->get_all, run->update, run->no_ignore, TRUE,
+                            run->ignore_externals, TRUE, NULL, tsh_status_func,
+                            run->dialog, pool);
+#elif CHECK_SVN_VERSION_G(1,7)
+  return svn_client_status5(NULL, ctx, path, &revision, run->depth,
+                            run->get_all, run->update, run->no_ignore,
+                            run->ignore_externals, TRUE, NULL, tsh_status_func,
+                            run->dialog, pool);
+#elif CHECK_SVN_VERSION_G(1,6)
+  return svn_client_status4(NULL, path, &revision, tsh_status_func3,
+                            run->dialog, run->depth, run->get_all, run->update,
+                            run->no_ignore, run->ignore_externals, NULL, ctx,
+                            pool);
+#else
+  return svn_client_status3(NULL, path, &revision, tsh_status_func2,
+                            run->dialog, run->depth, run->get_all, run->update,
+                            run->no_ignore, run->ignore_externals, NULL, ctx,
+                            pool);
+#endif
+}
+
+static void status_error (struct status_run *run, svn_error_t *err)
+{
+  g_mutex_lock (&run->lock);
+  if (!run->error_str)
+    run->error_str = tsh_strerror(err);
+  g_mutex_unlock (&run->lock);
+
+  svn_error_clear(err);
+}
+
+static void status_worker (gpointer data, gpointer user_data)
+{
+  const gchar *path = data;
+  struct status_run *run = user_data;
+  svn_client_ctx_t *ctx;
+  svn_error_t *err;
+  apr_pool_t *pool;
+
+  /* apr pools are not thread safe, each crawl gets a pool and context of its own */
+  pool = svn_pool_create (NULL);
+
+  if (!tsh_create_context (&ctx, pool, &err))
+  {
+    if (err)
+      status_error (run, err);
+  }
+  else if ((err = status_target (ctx, path, run, pool)))
+    status_error (run, err);
+
+  svn_pool_destroy (pool);
+}
+
 static gpointer status_thread (gpointer user_data)
 {
   struct thread_args *args = user_data;
-  svn_opt_revision_t revision;
   svn_error_t *err;
   svn_client_ctx_t *ctx = args->ctx;
   apr_pool_t *subpool, *pool = args->pool;
   TshStatusDialog *dialog = args->dialog;
   gchar **files = args->files;
-  svn_depth_t depth;
-  gboolean get_all;
-  gboolean update;
-  gboolean no_ignore;
-  gboolean ignore_externals;
+  struct status_run run;
+  guint n_files;
   GtkWidget *error;
-  gchar *error_str;
+
+  run.dialog = dialog;
+  run.error_str = NULL;
+  g_mutex_init (&run.lock);
 
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
   gdk_threads_enter();
-  depth = tsh_status_dialog_get_depth(dialog);
-  get_all = tsh_status_dialog_get_show_unmodified(dialog);
-  update = tsh_status_dialog_get_check_reposetory(dialog);
-  no_ignore = tsh_status_dialog_get_show_ignore(dialog);
-  ignore_externals = tsh_status_dialog_get_hide_externals(dialog);
+  run.depth = tsh_status_dialog_get_depth(dialog);
+  run.get_all = tsh_status_dialog_get_show_unmodified(dialog);
+  run.update = tsh_status_dialog_get_check_reposetory(dialog);
+  run.no_ignore = tsh_status_dialog_get_show_ignore(dialog);
+  run.ignore_externals = tsh_status_dialog_get_hide_externals(dialog);
   gdk_threads_leave();
 G_GNUC_END_IGNORE_DEPRECATIONS
 
-  subpool = svn_pool_create (pool);
-
-  revision.kind = svn_opt_revision_head;
+  n_files = files ? g_strv_length (files) : 0;
 
-#if CHECK_SVN_VERSION_G(1,9)
-  if ((err = svn_client_status6(NULL, ctx, files?files[0]:"", &revision, depth,
-                                get_all, update, no_ignore, TRUE,
-                                ignore_externals, TRUE, NULL, tsh_status_func,
-                                dialog, subpool)))
-#elif CHECK_SVN_VERSION_G(1,7)
-  if ((err = svn_client_status5(NULL, ctx, files?files[0]:"", &revision, depth,
-                                get_all, update, no_ignore, ignore_externals,
-                                TRUE, NULL, tsh_status_func, dialog, subpool)))
-#elif CHECK_SVN_VERSION_G(1,6)
-  if ((err = svn_client_status4(NULL, files?files[0]:"", &revision,
-                                tsh_status_func3, dialog, depth, get_all,
-                                update, no_ignore, ignore_externals, NULL, ctx,
-                                subpool)))
-#else
-  if ((err = svn_client_status3(NULL, files?files[0]:"", &revision,
-                                tsh_status_func2, dialog, depth, get_all,
-                                update, no_ignore, ignore_externals, NULL, ctx,
-                                subpool)))
-#endif
+  if (n_files <= 1)
   {
+    subpool = svn_pool_create (pool);
+
+    if ((err = status_target (ctx, files?files[0]:"", &run, subpool)))
+      status_error (&run, err);
+
     svn_pool_destroy (subpool);
+  }
+  else
+  {
+    GThreadPool *workers;
+    guint i;
+
+    workers = g_thread_pool_new (status_worker, &run, MIN (n_files, TSH_STATUS_MAX_WORKERS), FALSE, NULL);
+    for (i = 0; i < n_files; i++)
+      g_thread_pool_push (workers, files[i], NULL);
+
+    /* wait for every target to finish */
+    g_thread_pool_free (workers, FALSE, TRUE);
+  }
 
-    error_str = tsh_strerror(err);
+  tsh_queue_flush ();
+  g_mutex_clear (&run.lock);
 
+  if (run.error_str)
+  {
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
     gdk_threads_enter();
 G_GNUC_END_IGNORE_DEPRECATIONS
@@ -108,22 +183,19 @@ G_GNUC_END_IGNORE_DEPRECATIONS
     tsh_status_dialog_done (dialog);
 
     error = gtk_message_dialog_new(GTK_WINDOW(dialog), GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK, _("Status failed"));
-    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(error), "%s", error_str);
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(error), "%s", run.error_str);
     tsh_dialog_start(GTK_DIALOG(error), FALSE);
 
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
     gdk_threads_leave();
 G_GNUC_END_IGNORE_DEPRECATIONS
 
-    g_free(error_str);
+    g_free(run.error_str);
 
-    svn_error_clear(err);
     tsh_reset_cancel();
     return GINT_TO_POINTER (FALSE);
   }
 
-  svn_pool_destroy (subpool);
-
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
   gdk_threads_enter();
   tsh_status_dialog_done (dialog);
@@ -29,224 +29,332 @@
 
 #include "tsh-tree-common.h"
 
-static gint
-path_compare (const gchar *path1, const gchar *path2)
-{
-  const gchar *i1, *i2;
-  gchar c1, c2;
-  gint depth = 0;
-  i1 = path1;
-  i2 = path2;
-  while ((c1 = *i1++))
-  {
-    c2 = *i2++;
+/* above this many children a node looks up its children in a hash table */
+#define TSH_TREE_LOOKUP_MIN 8
 
-    if (c1 != c2)
-    {
-      if (c1 == '/'&& !c2)
-        depth++;
-      else if (!depth)
-        depth = -1;
+typedef struct _TshTreeNode TshTreeNode;
 
-      return depth;
-    }
+struct _TshTreeNode
+{
+  /* interned path component, so components compare by pointer */
+  const gchar *name;
+  TshTreeNode *parent;
+  TshTreeNode *first_child;
+  TshTreeNode *last_child;
+  TshTreeNode *next;
+  GHashTable *lookup;
+  guint n_children;
+  /* the path was passed to tsh_tree_get_iter_for_path */
+  gboolean added;
+  /* the node has a row of its own, a node without a row has one child */
+  gboolean shown;
+  GtkTreeIter iter;
+};
 
-    if (c1 == '/')
-      depth++;
-  }
+typedef struct
+{
+  TshTreeNode root;
+  /* rows were removed behind our back, e.g. by gtk_tree_store_clear */
+  gboolean stale;
+  /* rows are being removed by ourself */
+  gboolean busy;
+} TshTree;
 
-  switch (*i2)
+static void
+tree_node_free_children (TshTreeNode *node)
+{
+  TshTreeNode *child, *next;
+
+  for (child = node->first_child; child; child = next)
   {
-    case '/':
-      depth++;
-      break;
-    case '\0':
-      return 0;
+    next = child->next;
+    tree_node_free_children (child);
+    g_slice_free (TshTreeNode, child);
   }
 
-  if (!depth)
-    depth = -1;
+  if (node->lookup)
+    g_hash_table_destroy (node->lookup);
 
-  return depth;
+  node->first_child = NULL;
+  node->last_child = NULL;
+  node->lookup = NULL;
+  node->n_children = 0;
 }
 
-static gint
-path_depth (const gchar *path)
+static void
+tree_free (TshTree *tree)
 {
-  const gchar *i;
-  gchar c, last_c = '\0';
-  gint depth = 0;
-  i = path;
-  while ((c = *i++))
+  tree_node_free_children (&tree->root);
+  g_free (tree);
+}
+
+static TshTreeNode*
+tree_node_child (TshTreeNode *node, const gchar *name)
+{
+  TshTreeNode *child;
+
+  if (node->lookup)
+    return g_hash_table_lookup (node->lookup, name);
+
+  for (child = node->first_child; child; child = child->next)
+    if (child->name == name)
+      return child;
+
+  return NULL;
+}
+
+static TshTreeNode*
+tree_node_add_child (TshTreeNode *node, const gchar *name)
+{
+  TshTreeNode *child = g_slice_new0 (TshTreeNode);
+
+  child->name = name;
+  child->parent = node;
+
+  if (node->last_child)
+    node->last_child->next = child;
+  else
+    node->first_child = child;
+  node->last_child = child;
+  node->n_children++;
+
+  if (node->lookup)
+    g_hash_table_insert (node->lookup, (gpointer) name, child);
+  else if (node->n_children >= TSH_TREE_LOOKUP_MIN)
   {
-    if (c == '/')
-      depth++;
-    last_c = c;
+    TshTreeNode *iter;
+
+    node->lookup = g_hash_table_new (g_direct_hash, g_direct_equal);
+    for (iter = node->first_child; iter; iter = iter->next)
+      g_hash_table_insert (node->lookup, (gpointer) iter->name, iter);
   }
-  if (last_c != '/')
-    depth++;
-  return depth;
+
+  return child;
+}
+
+/* Find or create the node for path, without giving any node a row */
+static TshTreeNode*
+tree_node_add_path (TshTreeNode *node, const gchar *path)
+{
+  gchar **names, **name;
+  TshTreeNode *child;
+
+  names = g_strsplit (path, "/", -1);
+  for (name = names; *name; name++)
+  {
+    const gchar *component;
+
+    /* keep the leading empty component of an absolute path only */
+    if (!**name && name != names)
+      continue;
+
+    component = g_intern_string (*name);
+    child = tree_node_child (node, component);
+    if (!child)
+      child = tree_node_add_child (node, component);
+    node = child;
+  }
+  g_strfreev (names);
+
+  return node;
+}
+
+static TshTreeNode*
+tree_node_visible_parent (TshTreeNode *node)
+{
+  for (node = node->parent; node->parent && !node->shown; node = node->parent);
+
+  return node;
+}
+
+static GtkTreeIter*
+tree_node_row (TshTreeNode *node)
+{
+  return node->parent ? &node->iter : NULL;
+}
+
+/* The first node with a row along the chain of single children */
+static TshTreeNode*
+tree_node_shown_below (TshTreeNode *node)
+{
+  while (!node->shown)
+    node = node->first_child;
+
+  return node;
 }
 
+/* The path of node relative to the row it is shown under */
 static gchar*
-path_get_prefix (const gchar *path, gint depth)
+tree_node_label (TshTreeNode *node, TshTreeNode *ancestor)
 {
-  const gchar *i;
-  gchar c;
-  gint lng = 0;
-  i = path;
-  while ((c = *i++))
+  GPtrArray *names = g_ptr_array_new ();
+  GString *label = g_string_new (NULL);
+  TshTreeNode *iter;
+  guint i;
+
+  for (iter = node; iter != ancestor; iter = iter->parent)
+    g_ptr_array_add (names, (gpointer) iter->name);
+
+  for (i = names->len; i--;)
   {
-    if (c == '/')
-      if (!--depth)
-        break;
-    lng++;
+    g_string_append (label, g_ptr_array_index (names, i));
+    if (i)
+      g_string_append_c (label, '/');
   }
-  if (lng == 0)
-    return g_strdup("/");
-  return g_strndup (path, lng);
+  g_ptr_array_free (names, TRUE);
+
+  /* the common prefix of absolute paths */
+  if (!label->len && !node->added)
+    g_string_assign (label, "/");
+
+  return g_string_free (label, FALSE);
+}
+
+/* Recreate the rows of node and the nodes shown below it under parent */
+static void
+tree_copy_rows (GtkTreeStore *model, TshTreeNode *node, TshTreeNode *parent, gint path_column, TshTreeMoveInfoFunc move_info)
+{
+  GtkTreeIter iter;
+  TshTreeNode *child;
+  gchar *label;
+
+  gtk_tree_store_append (model, &iter, &parent->iter);
+  move_info (model, &iter, &node->iter);
+  label = tree_node_label (node, parent);
+  gtk_tree_store_set (model, &iter, path_column, label, -1);
+  g_free (label);
+
+  /* the old rows are removed as a whole once the copy is done */
+  node->iter = iter;
+
+  for (child = node->first_child; child; child = child->next)
+    tree_copy_rows (model, tree_node_shown_below (child), node, path_column, move_info);
 }
 
-static const gchar*
-path_remove_prefix (const gchar *path, gint depth)
+/* Give node a row, moving the row shown below it underneath */
+static void
+tree_node_show (TshTree *tree, GtkTreeStore *model, TshTreeNode *node, gint path_column, TshTreeMoveInfoFunc move_info)
 {
-  const gchar *i;
-  gchar c;
-  i = path;
-  while ((c = *i++))
+  TshTreeNode *parent = tree_node_visible_parent (node);
+  TshTreeNode *below = NULL;
+  gchar *label;
+
+  if (node->first_child)
+    below = tree_node_shown_below (node->first_child);
+
+  if (below)
+    gtk_tree_store_insert_before (model, &node->iter, tree_node_row (parent), &below->iter);
+  else
+    gtk_tree_store_append (model, &node->iter, tree_node_row (parent));
+  node->shown = TRUE;
+
+  label = tree_node_label (node, parent);
+  gtk_tree_store_set (model, &node->iter, path_column, label, -1);
+  g_free (label);
+
+  if (below)
   {
-    if (c == '/')
-      if (!--depth)
-        return i;
+    GtkTreeIter old = below->iter;
+
+    tree_copy_rows (model, below, node, path_column, move_info);
+
+    tree->busy = TRUE;
+    gtk_tree_store_remove (model, &old);
+    tree->busy = FALSE;
   }
-  return NULL;
 }
 
+/* Recreate the nodes for the rows already in the model */
 static void
-move_children (GtkTreeStore *model, GtkTreeIter *dest, GtkTreeIter *src, gint path_column, TshTreeMoveInfoFunc move_info)
+tree_rebuild (GtkTreeModel *model, GtkTreeIter *parent, TshTreeNode *node, gint path_column)
 {
-  gchar *path;
-  GtkTreeIter iter_src;
-  GtkTreeIter iter_dst;
+  GtkTreeIter iter;
 
-  if (gtk_tree_model_iter_children (GTK_TREE_MODEL (model), &iter_src, src))
+  if (gtk_tree_model_iter_children (model, &iter, parent))
   {
     do
     {
-      gtk_tree_store_append (model, &iter_dst, dest);
-      gtk_tree_model_get (GTK_TREE_MODEL (model), &iter_src, path_column, &path, -1);
-      move_info (model, &iter_dst, &iter_src);
-      gtk_tree_store_set (model, &iter_dst, path_column, path, -1);
+      TshTreeNode *child;
+      gchar *path;
+
+      gtk_tree_model_get (model, &iter, path_column, &path, -1);
+      child = tree_node_add_path (node, path);
       g_free (path);
 
-      move_children (model, &iter_dst, &iter_src, path_column, move_info);
+      child->added = TRUE;
+      child->shown = TRUE;
+      child->iter = iter;
+
+      tree_rebuild (model, &iter, child, path_column);
     }
-    while (gtk_tree_store_remove (model, &iter_src));
+    while (gtk_tree_model_iter_next (model, &iter));
   }
 }
 
+static void
+tree_row_deleted (GtkTreeModel *model, GtkTreePath *path, TshTree *tree)
+{
+  if (!tree->busy)
+    tree->stale = TRUE;
+}
+
+static TshTree*
+tree_get (GtkTreeStore *model, gint path_column)
+{
+  TshTree *tree = g_object_get_data (G_OBJECT (model), "tsh-tree");
+
+  if (!tree)
+  {
+    tree = g_new0 (TshTree, 1);
+    g_object_set_data_full (G_OBJECT (model), "tsh-tree", tree, (GDestroyNotify) tree_free);
+    g_signal_connect (model, "row-deleted", G_CALLBACK (tree_row_deleted), tree);
+    tree->stale = TRUE;
+  }
+
+  if (tree->stale)
+  {
+    tree_node_free_children (&tree->root);
+    tree_rebuild (GTK_TREE_MODEL (model), NULL, &tree->root, path_column);
+    tree->stale = FALSE;
+  }
+
+  return tree;
+}
+
 void
 tsh_tree_get_iter_for_path (GtkTreeStore *model, const gchar *file, GtkTreeIter *iter, gint path_column, TshTreeMoveInfoFunc move_info)
 {
-  const gchar *relative_file = file;
-  GtkTreeIter real_parent, *parent = NULL;
+  TshTree *tree = tree_get (model, path_column);
+  TshTreeNode *node = &tree->root;
+  gchar **names, **name;
 
-  if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (model), iter))
+  names = g_strsplit (file, "/", -1);
+  for (name = names; *name; name++)
   {
-    gint file_depth = path_depth (relative_file);
-    for (;;)
-    {
-      gchar *path;
-      gint depth;
-      gtk_tree_model_get (GTK_TREE_MODEL (model), iter, path_column, &path, -1);
-
-      depth = path_compare (path, relative_file);
-      if(!depth)
-      {
-        g_free (path);
-        return;
-      }
-      if (depth > 0)
-      {
-        gint depth_p = path_depth (path);
-
-        if (depth_p == depth)
-        {
-          /* path is the parent */
-          real_parent = *iter;
-          parent = &real_parent;
-
-          relative_file = path_remove_prefix (relative_file, depth);
-
-          if (!gtk_tree_model_iter_children (GTK_TREE_MODEL (model), iter, parent))
-          {
-            g_free (path);
-            break;
-          }
-
-          g_free(path);
-          continue;
-        }
-        else if (depth == file_depth)
-        {
-          /* file is the parent */
-          GtkTreeIter new;
-          /* Add a new parent to the model, on iter removal iter will become this new iter */
-          gtk_tree_store_insert_after (model, &real_parent, parent, iter);
-          /* Add a child to copy the old iter's data to */
-          gtk_tree_store_append (model, &new, &real_parent);
-          /* Copy the data */
-          move_info (model, &new, iter);
-          /* Set the path names */
-          gtk_tree_store_set (model, &real_parent, path_column, relative_file, -1);
-          gtk_tree_store_set (model, &new, path_column, path_remove_prefix(path, depth), -1);
-          /* Move the children */
-          move_children (model, &new, iter, path_column, move_info);
-          /* Iter becomes the next child, which is our new iter */
-          gtk_tree_store_remove (model, iter);
-
-          g_free (path);
-          return;
-        }
-        else
-        {
-          /* common prefix */
-          GtkTreeIter new;
-          gchar *prefix = path_get_prefix (relative_file, depth);
-
-          /* Add a new parent to the model */
-          gtk_tree_store_insert_after (model, &real_parent, parent, iter);
-          parent = &real_parent;
-          /* Add a child to copy the old iter's data to */
-          gtk_tree_store_append(model, &new, parent);
-          /* Copy the data */
-          move_info (model, &new, iter);
-          /* Set the path names */
-          gtk_tree_store_set (model, parent, path_column, prefix, -1);
-          gtk_tree_store_set (model, &new, path_column, path_remove_prefix(path, depth), -1);
-          /* Move the children */
-          move_children (model, &new, iter, path_column, move_info);
-          /* Remove the old iter */
-          gtk_tree_store_remove (model, iter);
-
-          relative_file = path_remove_prefix (relative_file, depth);
-
-          g_free (prefix);
-          g_free (path);
-          break;
-        }
-      }
+    const gchar *component;
+    TshTreeNode *child;
 
-      g_free (path);
-      if (!gtk_tree_model_iter_next (GTK_TREE_MODEL (model), iter))
-        break;
+    /* keep the leading empty component of an absolute path only */
+    if (!**name && name != names)
+      continue;
+
+    component = g_intern_string (*name);
+    child = tree_node_child (node, component);
+    if (!child)
+    {
+      /* a second branch below a node without a row gives it one */
+      if (node->parent && !node->shown && node->n_children == 1)
+        tree_node_show (tree, model, node, path_column, move_info);
+      child = tree_node_add_child (node, component);
     }
+    node = child;
   }
+  g_strfreev (names);
 
-  if (relative_file)
-  {
-    gtk_tree_store_append (model, iter, parent);
-    gtk_tree_store_set (model, iter, path_column, relative_file, -1);
-  }
+  node->added = TRUE;
+  if (!node->shown)
+    tree_node_show (tree, model, node, path_column, move_info);
+
+  *iter = node->iter;
 }
 
@@ -24,12 +24,16 @@
 #include <stdlib.h>
 #endif
 
+#include <string.h>
+
 #include <glib.h>
 #include <gtk/gtk.h>
 
 #include <libxfce4util/libxfce4util.h>
 
 #include <subversion-1/svn_client.h>
+#include <subversion-1/svn_config.h>
+#include <subversion-1/svn_dirent_uri.h>
 #include <subversion-1/svn_pools.h>
 
 #include "tsh-common.h"
@@ -38,75 +42,237 @@
 
 #include "tsh-update.h"
 
+/* working copies updated at once, unless the svn config says otherwise */
+#define TSH_UPDATE_PARALLEL 4
+#define TSH_UPDATE_PARALLEL_MAX 16
+
 struct thread_args {
 	svn_client_ctx_t *ctx;
 	apr_pool_t *pool;
 	TshNotifyDialog *dialog;
 	gchar **files;
+	gint parallel;
+};
+
+struct update_run {
+	TshNotifyDialog *dialog;
+	GMutex lock;
+	/* the first error, the other working copies keep going */
+	gchar *error_str;
 };
 
+static svn_error_t *update_paths (svn_client_ctx_t *ctx, apr_array_header_t *paths, apr_pool_t *pool)
+{
+  svn_opt_revision_t revision;
+
+  revision.kind = svn_opt_revision_head;
+#if CHECK_SVN_VERSION_S(1,6)
+  return svn_client_update3(NULL, paths, &revision, svn_depth_unknown, FALSE, FALSE, FALSE, ctx, pool);
+#else /* CHECK_SVN_VERSION(1,7) */
+  return svn_client_update4(NULL, paths, &revision, svn_depth_unknown, TRUE, FALSE, FALSE, FALSE, FALSE, ctx, pool);
+#endif
+}
+
+#if CHECK_SVN_VERSION_G(1,7)
+/* Split files by the working copy they belong to, a working copy nested in
+ * another selected one stays with the outer one so they never run at the same
+ * time. Returns NULL when there is nothing to run side by side. */
+static GPtrArray *update_groups (gchar **files, svn_client_ctx_t *ctx, apr_pool_t *pool)
+{
+  GPtrArray *groups, *group;
+  GHashTable *lookup;
+  const char **roots;
+  const char *abspath, *top;
+  svn_error_t *err;
+  gint size, i, j;
+
+  size = files?g_strv_length(files):0;
+  if (size <= 1)
+    return NULL;
+
+  roots = apr_palloc (pool, size * sizeof (const char *));
+
+  for (i = 0; i < size; i++)
+  {
+    if ((err = svn_dirent_get_absolute (&abspath, files[i], pool)) ||
+        (err = svn_client_get_wc_root (&roots[i], abspath, ctx, pool, pool)))
+    {
+      /* leave reporting it to the update itself */
+      svn_error_clear (err);
+      return NULL;
+    }
+  }
+
+  groups = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+  lookup = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (i = 0; i < size; i++)
+  {
+    top = roots[i];
+    for (j = 0; j < size; j++)
+    {
+      if (strlen (roots[j]) < strlen (top) && svn_dirent_is_ancestor (roots[j], top))
+        top = roots[j];
+    }
+
+    group = g_hash_table_lookup (lookup, top);
+    if (!group)
+    {
+      group = g_ptr_array_new ();
+      g_ptr_array_add (groups, group);
+      g_hash_table_insert (lookup, (gpointer) top, group);
+    }
+    g_ptr_array_add (group, files[i]);
+  }
+
+  g_hash_table_destroy (lookup);
+
+  if (groups->len <= 1)
+  {
+    g_ptr_array_unref (groups);
+    return NULL;
+  }
+
+  return groups;
+}
+
+static void update_error (struct update_run *run, svn_error_t *err)
+{
+  g_mutex_lock (&run->lock);
+  if (!run->error_str)
+    run->error_str = tsh_strerror(err);
+  g_mutex_unlock (&run->lock);
+
+  svn_error_clear(err);
+}
+
+static void update_worker (gpointer data, gpointer user_data)
+{
+  GPtrArray *group = data;
+  struct update_run *run = user_data;
+  apr_array_header_t *paths;
+  svn_client_ctx_t *ctx;
+  svn_error_t *err;
+  apr_pool_t *pool;
+  guint i;
+
+  /* apr pools are not thread safe, each working copy gets a pool and context of its own */
+  pool = svn_pool_create (NULL);
+
+  if (!tsh_create_context (&ctx, pool, &err))
+  {
+    if (err)
+      update_error (run, err);
+    svn_pool_destroy (pool);
+    return;
+  }
+
+  /* all end up in the one dialog */
+  ctx->notify_func2 = tsh_notify_func2;
+  ctx->notify_baton2 = run->dialog;
+  tsh_progress_attach (ctx, pool);
+
+  paths = apr_array_make (pool, group->len, sizeof (const char *));
+  for (i = 0; i < group->len; i++)
+  {
+    APR_ARRAY_PUSH (paths, const char *) = g_ptr_array_index (group, i);
+  }
+
+  if ((err = update_paths (ctx, paths, pool)))
+    update_error (run, err);
+
+  svn_pool_destroy (pool);
+}
+#endif
+
 static gpointer update_thread (gpointer user_data)
 {
   struct thread_args *args = user_data;
-  svn_opt_revision_t revision;
   svn_error_t *err;
   apr_array_header_t *paths;
   svn_client_ctx_t *ctx = args->ctx;
   apr_pool_t *subpool, *pool = args->pool;
   TshNotifyDialog *dialog = args->dialog;
   gchar **files = args->files;
+  gint parallel = args->parallel;
+  struct update_run run;
+  GPtrArray *groups = NULL;
   gint size, i;
-  gchar *error_str;
 
   g_free (args);
 
+  run.dialog = dialog;
+  run.error_str = NULL;
+  g_mutex_init (&run.lock);
+
   size = files?g_strv_length(files):0;
 
   subpool = svn_pool_create (pool);
 
-  if(size)
+#if CHECK_SVN_VERSION_G(1,7)
+  if (parallel > 1)
+    groups = update_groups (files, ctx, subpool);
+
+  if (groups)
   {
-    paths = apr_array_make (subpool, size, sizeof (const char *));
+    GThreadPool *workers;
+    guint n;
 
-    for (i = 0; i < size; i++)
-    {
-      APR_ARRAY_PUSH (paths, const char *) = files[i];
-    }
+    workers = g_thread_pool_new (update_worker, &run, MIN ((gint) groups->len, parallel), FALSE, NULL);
+    for (n = 0; n < groups->len; n++)
+      g_thread_pool_push (workers, g_ptr_array_index (groups, n), NULL);
+
+    /* wait for every working copy to finish */
+    g_thread_pool_free (workers, FALSE, TRUE);
+
+    g_ptr_array_unref (groups);
   }
   else
+#endif
   {
-    paths = apr_array_make (subpool, 1, sizeof (const char *));
+    if(size)
+    {
+      paths = apr_array_make (subpool, size, sizeof (const char *));
 
-    APR_ARRAY_PUSH (paths, const char *) = ""; // current directory
+      for (i = 0; i < size; i++)
+      {
+        APR_ARRAY_PUSH (paths, const char *) = files[i];
+      }
+    }
+    else
+    {
+      paths = apr_array_make (subpool, 1, sizeof (const char *));
+
+      APR_ARRAY_PUSH (paths, const char *) = ""; // current directory
+    }
+
+    if ((err = update_paths (ctx, paths, subpool)))
+    {
+      run.error_str = tsh_strerror(err);
+      svn_error_clear(err);
+    }
   }
 
-  revision.kind = svn_opt_revision_head;
-#if CHECK_SVN_VERSION_S(1,6)
-  if ((err = svn_client_update3(NULL, paths, &revision, svn_depth_unknown, FALSE, FALSE, FALSE, ctx, subpool)))
-#else /* CHECK_SVN_VERSION(1,7) */
-  if ((err = svn_client_update4(NULL, paths, &revision, svn_depth_unknown, TRUE, FALSE, FALSE, FALSE, FALSE, ctx, subpool)))
-#endif
-  {
-    svn_pool_destroy (subpool);
+  svn_pool_destroy (subpool);
 
-    error_str = tsh_strerror(err);
+  tsh_queue_flush ();
+  g_mutex_clear (&run.lock);
 
+  if (run.error_str)
+  {
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
     gdk_threads_enter();
-    tsh_notify_dialog_add(dialog, _("Failed"), error_str, NULL);
+    tsh_notify_dialog_add(dialog, _("Failed"), run.error_str, NULL);
     tsh_notify_dialog_done (dialog);
     gdk_threads_leave();
 G_GNUC_END_IGNORE_DEPRECATIONS
 
-    g_free(error_str);
+    g_free(run.error_str);
 
-    svn_error_clear(err);
     tsh_reset_cancel();
     return GINT_TO_POINTER (FALSE);
   }
 
-  svn_pool_destroy (subpool);
-
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
   gdk_threads_enter();
   tsh_notify_dialog_done (dialog);
@@ -117,23 +283,49 @@ G_GNUC_END_IGNORE_DEPRECATIONS
   return GINT_TO_POINTER (TRUE);
 }
 
-GThread *tsh_update (gchar **files, svn_client_ctx_t *ctx, apr_pool_t *pool)
+/* The plugin passes no --parallel, so it is read from the
+ * update-parallel option in the [thunar-vcs-plugin] section of
+ * ~/.subversion/config */
+static gint update_config_parallel (svn_client_ctx_t *ctx)
+{
+  svn_config_t *cfg = NULL;
+  const char *value = NULL;
+  gint64 parallel;
+
+  if (ctx->config)
+    cfg = apr_hash_get (ctx->config, SVN_CONFIG_CATEGORY_CONFIG, APR_HASH_KEY_STRING);
+  if (cfg)
+    svn_config_get (cfg, &value, "thunar-vcs-plugin", "update-parallel", NULL);
+
+  parallel = value ? g_ascii_strtoll (value, NULL, 10) : 0;
+  if (parallel <= 0)
+    return TSH_UPDATE_PARALLEL;
+
+  return (gint) MIN (parallel, TSH_UPDATE_PARALLEL_MAX);
+}
+
+GThread *tsh_update (gchar **files, gint parallel, svn_client_ctx_t *ctx, apr_pool_t *pool)
 {
 	GtkWidget *dialog;
 	struct thread_args *args;
 
+	if (parallel <= 0)
+		parallel = update_config_parallel (ctx);
+
 	dialog = tsh_notify_dialog_new (_("Update"), NULL, 0);
   g_signal_connect(dialog, "cancel-clicked", tsh_cancel, NULL);
 	tsh_dialog_start (GTK_DIALOG (dialog), TRUE);
 
 	ctx->notify_func2 = tsh_notify_func2;
 	ctx->notify_baton2 = dialog;
+	tsh_progress_start (ctx, dialog);
 
 	args = g_malloc (sizeof (struct thread_args));
 	args->ctx = ctx;
 	args->pool = pool;
 	args->dialog = TSH_NOTIFY_DIALOG (dialog);
 	args->files = files;
+	args->parallel = parallel;
 
 	return g_thread_new (NULL, update_thread, args);
 }
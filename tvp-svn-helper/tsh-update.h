@@ -21,7 +21,7 @@
 
 G_BEGIN_DECLS
 
-GThread *tsh_update (gchar**, svn_client_ctx_t*, apr_pool_t*);
+GThread *tsh_update (gchar**, gint, svn_client_ctx_t*, apr_pool_t*);
 
 G_END_DECLS
 